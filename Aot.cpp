@@ -0,0 +1,88 @@
+#include "Aot.hpp"
+#include <algorithm>
+#include <cstring>
+
+
+namespace
+{
+    const unsigned int START_ADDRESS = 0x200;
+}
+
+
+Aot::Aot(AotProgram const& value)
+    : program(value)
+{
+    for (size_t i = 0; i < program.blockCount; ++i)
+    {
+        AotBlock const& block = program.blocks[i];
+        entries[block.start] = Entry{ block.code, block.length, false };
+
+        for (unsigned int j = block.start; j < block.end; ++j)
+        {
+            ++coverage[j];
+        }
+    }
+}
+
+// same work as calling Cycle() once per instruction, as long as every block that runs still matches memory
+void Aot::Run(Chip8& chip8, unsigned int cycles)
+{
+    // the blocks have the quirks they were compiled for built in
+    if (chip8.quirks.Bits() != program.quirks)
+    {
+        chip8.Interpret(cycles);
+        return;
+    }
+
+    while (cycles > 0)
+    {
+        uint16_t pc = chip8.pc;
+
+        // a block has to run to the end once entered, so near the end of the budget we finish one instruction at a time
+        if (pc < MEMORY_SIZE && entries[pc].valid && entries[pc].length <= cycles)
+        {
+            Entry const& entry = entries[pc];
+            entry.code(chip8);
+            chip8.cycleCount += entry.length; // like the jit, no per instruction trace records from compiled code
+            cycles -= entry.length;
+            continue;
+        }
+
+        chip8.Cycle();
+        --cycles;
+    }
+}
+
+void Aot::Invalidate(uint8_t const* memory, uint16_t address, uint16_t length)
+{
+    unsigned int first = address;
+    unsigned int last = std::min<unsigned int>(address + length, MEMORY_SIZE);
+
+    bool hitsCode = false;
+    for (unsigned int i = first; i < last && !hitsCode; ++i)
+    {
+        hitsCode = coverage[i] != 0;
+    }
+
+    if (!hitsCode)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < program.blockCount; ++i)
+    {
+        AotBlock const& block = program.blocks[i];
+        if (block.end <= first || block.start >= last)
+        {
+            continue;
+        }
+
+        entries[block.start].valid = std::memcmp(memory + block.start, program.rom + (block.start - START_ADDRESS), block.end - block.start) == 0;
+    }
+}
+
+void Aot::Execute(Chip8& chip8, uint16_t opcode)
+{
+    chip8.instruction = Chip8::Split(opcode);
+    (chip8.*chip8.Decode(opcode))();
+}
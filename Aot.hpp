@@ -0,0 +1,75 @@
+#ifndef AOT_HPP
+#define AOT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include "Chip8.hpp"
+
+
+// one basic block of a rom that chip8_aot compiled to C++, it runs as a whole or not at all
+struct AotBlock
+{
+	uint16_t start;  // address of the first instruction
+	uint16_t length; // instructions one call runs
+	uint16_t end;    // first address past the block
+	void (*code)(Chip8& chip8); // runs the block and leaves pc wherever the last instruction sent it
+};
+
+// everything chip8_aot writes for one rom
+struct AotProgram
+{
+	char const* name;
+	uint64_t hash;       // RomLibrary::Hash of the rom
+	uint8_t quirks;      // Quirks::Bits the blocks were compiled for
+	uint8_t const* rom;  // the rom itself, the blocks are only valid while memory still holds these bytes under them
+	size_t romSize;
+	AotBlock const* blocks;
+	size_t blockCount;
+};
+
+// the program in a file chip8_aot wrote, a native build links exactly one of them
+extern AotProgram const aotProgram;
+
+// runs an AotProgram's blocks in place of the interpreter, for ExecMode::Native
+// anything without a valid block goes through Cycle instead: code chip8_aot never reached (a computed Bnnn jump can land anywhere),
+// code it saw the rom write over, and any block whose bytes in memory no longer match the rom. that is checked again on every
+// write that lands on a block, so a block comes back once the rom writes the original bytes back
+class Aot
+{
+public:
+	explicit Aot(AotProgram const& program);
+
+	void Run(Chip8& chip8, unsigned int cycles);
+	void Invalidate(uint8_t const* memory, uint16_t address, uint16_t length); // recheck every block that covers any of these bytes
+
+	// what the compiled blocks reach the machine through, each one inlines to a plain member access
+	static const uint16_t FONTSET_START_ADDRESS = 0x50; // has to match Chip8.cpp
+
+	static uint8_t* Registers(Chip8& chip8) { return chip8.registers; }
+	static uint8_t const* Memory(Chip8& chip8) { return chip8.memory; } // read only, writes have to go through an OP_ handler for CodeWritten
+	static uint16_t& Index(Chip8& chip8) { return chip8.index; }
+	static uint16_t& Pc(Chip8& chip8) { return chip8.pc; }
+	static uint16_t* Stack(Chip8& chip8) { return chip8.stack; }
+	static uint8_t& StackPointer(Chip8& chip8) { return chip8.sp; }
+	static uint8_t& DelayTimer(Chip8& chip8) { return chip8.delayTimer; }
+	static uint8_t& SoundTimer(Chip8& chip8) { return chip8.soundTimer; }
+	static uint8_t* Keypad(Chip8& chip8) { return chip8.keypad; }
+	static uint32_t& RandomState(Chip8& chip8) { return chip8.rngState; }
+
+	static void Execute(Chip8& chip8, uint16_t opcode); // an instruction left to its OP_ handler, with pc already past it
+
+private:
+	struct Entry
+	{
+		void (*code)(Chip8& chip8);
+		uint16_t length;
+		bool valid; // its bytes in memory are the ones it was compiled from
+	};
+
+	AotProgram const& program;
+	Entry entries[MEMORY_SIZE]{};     // by start address
+	uint16_t coverage[MEMORY_SIZE]{}; // how many blocks contain each byte, lets Invalidate skip writes to plain data quickly
+};
+
+
+#endif
@@ -0,0 +1,621 @@
+#include "AotCompiler.hpp"
+#include <algorithm>
+#include <cstdio>
+
+
+namespace
+{
+    const unsigned int START_ADDRESS = 0x200;
+
+    std::string Hex(unsigned int value, int digits)
+    {
+        char text[16];
+        std::snprintf(text, sizeof(text), "0x%0*X", digits, value);
+        return text;
+    }
+
+    std::string Local(unsigned int reg)
+    {
+        char text[4];
+        std::snprintf(text, sizeof(text), "v%X", reg);
+        return text;
+    }
+
+    uint16_t Bit(unsigned int reg)
+    {
+        return static_cast<uint16_t>(1u << reg);
+    }
+}
+
+
+AotCompiler::AotCompiler(uint8_t const* data, size_t size, Quirks value)
+    : rom(data, data + std::min<size_t>(size, MAX_ROM_SIZE))
+    , quirks(value)
+{
+    Walk();
+    Cut();
+    FindWrites();
+}
+
+size_t AotCompiler::BlockCount() const
+{
+    return blocks.size();
+}
+
+unsigned int AotCompiler::CodeBytes() const
+{
+    return static_cast<unsigned int>(std::count(std::begin(code), std::end(code), true));
+}
+
+unsigned int AotCompiler::DataBytes() const
+{
+    return static_cast<unsigned int>(rom.size()) - CodeBytes();
+}
+
+unsigned int AotCompiler::ComputedJumps() const
+{
+    return computedJumps;
+}
+
+unsigned int AotCompiler::SelfModified() const
+{
+    return selfModified;
+}
+
+uint16_t AotCompiler::Opcode(unsigned int address) const
+{
+    return static_cast<uint16_t>((rom[address - START_ADDRESS] << 8u) | rom[address - START_ADDRESS + 1]);
+}
+
+bool AotCompiler::InRom(unsigned int address) const
+{
+    return address >= START_ADDRESS && address + 1 < START_ADDRESS + rom.size();
+}
+
+void AotCompiler::Target(unsigned int address, std::vector<uint16_t>& work)
+{
+    if (address < MEMORY_SIZE)
+    {
+        leader[address] = true;
+        work.push_back(static_cast<uint16_t>(address));
+    }
+}
+
+// the instructions after which the next one to run isnt simply the next one in memory, or that write memory and so might change it
+bool AotCompiler::EndsBlock(Chip8::Handler handler)
+{
+    switch (handler)
+    {
+        case Chip8::HANDLER_00EE:
+        case Chip8::HANDLER_1nnn:
+        case Chip8::HANDLER_2nnn:
+        case Chip8::HANDLER_3xkk:
+        case Chip8::HANDLER_4xkk:
+        case Chip8::HANDLER_5xy0:
+        case Chip8::HANDLER_9xy0:
+        case Chip8::HANDLER_Bnnn:
+        case Chip8::HANDLER_Ex9E:
+        case Chip8::HANDLER_ExA1:
+        case Chip8::HANDLER_Fx0A:
+        case Chip8::HANDLER_Fx33:
+        case Chip8::HANDLER_Fx55:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool AotCompiler::Interpreted(Chip8::Handler handler)
+{
+    switch (handler)
+    {
+        case Chip8::HANDLER_00E0:
+        case Chip8::HANDLER_Bnnn:
+        case Chip8::HANDLER_Dxyn:
+        case Chip8::HANDLER_Fx0A:
+        case Chip8::HANDLER_Fx33:
+        case Chip8::HANDLER_Fx55:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// everything reachable from 0x200 without knowing any register values
+void AotCompiler::Walk()
+{
+    std::vector<uint16_t> work;
+    Target(START_ADDRESS, work);
+
+    while (!work.empty())
+    {
+        unsigned int address = work.back();
+        work.pop_back();
+
+        if (!InRom(address) || instruction[address])
+        {
+            continue;
+        }
+
+        uint16_t opcode = Opcode(address);
+        Chip8::Handler handler = Chip8::Classify(opcode);
+
+        // not an instruction, most likely the walk ran into data. if the rom really does run it, the interpreter does
+        if (handler == Chip8::HANDLER_NULL)
+        {
+            continue;
+        }
+
+        instruction[address] = true;
+        code[address] = code[address + 1] = true;
+
+        unsigned int nnn = opcode & 0x0FFFu;
+        switch (handler)
+        {
+            case Chip8::HANDLER_1nnn:
+                Target(nnn, work);
+                break;
+            case Chip8::HANDLER_2nnn:
+                Target(nnn, work);
+                Target(address + 2, work);
+                break;
+            case Chip8::HANDLER_00EE:
+                break;
+            case Chip8::HANDLER_3xkk:
+            case Chip8::HANDLER_4xkk:
+            case Chip8::HANDLER_5xy0:
+            case Chip8::HANDLER_9xy0:
+            case Chip8::HANDLER_Ex9E:
+            case Chip8::HANDLER_ExA1:
+                Target(address + 2, work);
+                Target(address + 4, work);
+                break;
+            case Chip8::HANDLER_Bnnn:
+                ++computedJumps;
+                break;
+            case Chip8::HANDLER_Fx0A:
+                leader[address] = true; // waiting for a key runs it again
+                Target(address + 2, work);
+                break;
+            default:
+                if (EndsBlock(handler))
+                {
+                    Target(address + 2, work);
+                }
+                else
+                {
+                    work.push_back(static_cast<uint16_t>(address + 2));
+                }
+                break;
+        }
+    }
+}
+
+// a block from every leader the walk reached, up to the first instruction that ends one, the next leader, or the end of the code
+void AotCompiler::Cut()
+{
+    for (unsigned int start = START_ADDRESS; start < MEMORY_SIZE; ++start)
+    {
+        if (!leader[start] || !instruction[start])
+        {
+            continue;
+        }
+
+        Block block{ static_cast<uint16_t>(start), static_cast<uint16_t>(start), 0 };
+        unsigned int address = start;
+        while (instruction[address] && block.length < MAX_BLOCK_LENGTH)
+        {
+            Chip8::Handler handler = Chip8::Classify(Opcode(address));
+            ++block.length;
+            address += 2;
+
+            if (EndsBlock(handler) || leader[address])
+            {
+                break;
+            }
+        }
+
+        block.end = static_cast<uint16_t>(address);
+        blocks.push_back(block);
+    }
+}
+
+// Fx33 and Fx55 with an I the block sets itself, and the blocks they write over. those blocks are dropped, they would only ever be
+// checked against memory and thrown out again by Aot
+void AotCompiler::FindWrites()
+{
+    for (Block const& block : blocks)
+    {
+        bool known = false;
+        unsigned int index = 0;
+
+        for (unsigned int address = block.start; address < block.end; address += 2)
+        {
+            uint16_t opcode = Opcode(address);
+            unsigned int x = (opcode >> 8u) & 0xFu;
+
+            switch (Chip8::Classify(opcode))
+            {
+                case Chip8::HANDLER_Annn:
+                    known = true;
+                    index = opcode & 0x0FFFu;
+                    break;
+                case Chip8::HANDLER_Fx1E:
+                case Chip8::HANDLER_Fx29:
+                    known = false;
+                    break;
+                case Chip8::HANDLER_Fx33:
+                    for (unsigned int i = 0; known && i < 3 && index + i < MEMORY_SIZE; ++i)
+                    {
+                        written[index + i] = true;
+                    }
+                    break;
+                case Chip8::HANDLER_Fx55:
+                    for (unsigned int i = 0; known && i <= x && index + i < MEMORY_SIZE; ++i)
+                    {
+                        written[index + i] = true;
+                    }
+                    break;
+                case Chip8::HANDLER_Fx65:
+                    if (quirks.indexAdvances)
+                    {
+                        index += x + 1;
+                    }
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+
+    auto overwritten = [this](Block const& block)
+    {
+        return std::any_of(written + block.start, written + block.end, [](bool w) { return w; });
+    };
+
+    size_t before = blocks.size();
+    blocks.erase(std::remove_if(blocks.begin(), blocks.end(), overwritten), blocks.end());
+    selfModified = static_cast<unsigned int>(before - blocks.size());
+}
+
+void AotCompiler::WriteBlock(std::ostream& out, Block const& block) const
+{
+    // every register the block touches is read into a local once, and written back when the block ends or an OP_ handler needs it
+    uint16_t used = 0;
+    for (unsigned int address = block.start; address < block.end; address += 2)
+    {
+        uint16_t opcode = Opcode(address);
+        unsigned int x = (opcode >> 8u) & 0xFu;
+        unsigned int y = (opcode >> 4u) & 0xFu;
+
+        switch (Chip8::Classify(opcode))
+        {
+            case Chip8::HANDLER_3xkk: case Chip8::HANDLER_4xkk: case Chip8::HANDLER_6xkk: case Chip8::HANDLER_7xkk:
+            case Chip8::HANDLER_Cxkk: case Chip8::HANDLER_Ex9E: case Chip8::HANDLER_ExA1:
+            case Chip8::HANDLER_Fx07: case Chip8::HANDLER_Fx15: case Chip8::HANDLER_Fx18: case Chip8::HANDLER_Fx1E: case Chip8::HANDLER_Fx29:
+                used |= Bit(x);
+                break;
+            case Chip8::HANDLER_5xy0: case Chip8::HANDLER_9xy0:
+                if (x != y) // a register compared with itself is written out as a constant, see below
+                {
+                    used |= Bit(x) | Bit(y);
+                }
+                break;
+            case Chip8::HANDLER_8xy0: case Chip8::HANDLER_8xy1: case Chip8::HANDLER_8xy2: case Chip8::HANDLER_8xy3:
+                used |= Bit(x) | Bit(y);
+                break;
+            case Chip8::HANDLER_8xy4: case Chip8::HANDLER_8xy5: case Chip8::HANDLER_8xy7:
+                used |= Bit(x) | Bit(y) | Bit(0xF);
+                break;
+            case Chip8::HANDLER_8xy6: case Chip8::HANDLER_8xyE:
+                used |= Bit(x) | Bit(0xF) | (quirks.shiftVy ? Bit(y) : 0); // Vy is only read when the shift quirk is on
+                break;
+            default:
+                break;
+        }
+    }
+
+    bool usesIndex = false;
+    bool loads = false; // an Fx65, which writes registers the block has no locals for straight to memory
+    for (unsigned int address = block.start; address < block.end; address += 2)
+    {
+        Chip8::Handler handler = Chip8::Classify(Opcode(address));
+        usesIndex |= handler == Chip8::HANDLER_Annn || handler == Chip8::HANDLER_Fx1E || handler == Chip8::HANDLER_Fx29 || handler == Chip8::HANDLER_Fx65;
+        loads |= handler == Chip8::HANDLER_Fx65;
+    }
+
+    out << "// " << Hex(block.start, 4) << "-" << Hex(block.end - 1u, 4) << ", " << block.length << " instructions\n";
+    out << "void Block_" << Hex(block.start, 4).substr(2) << "(Chip8& chip8)\n{\n";
+    out << "    uint16_t& pc = Aot::Pc(chip8);\n";
+    if (used != 0 || loads)
+    {
+        out << "    uint8_t* V = Aot::Registers(chip8);\n";
+    }
+    if (usesIndex)
+    {
+        out << "    uint16_t& I = Aot::Index(chip8);\n";
+    }
+
+    uint16_t dirty = 0;
+    auto store = [&out, &dirty]()
+    {
+        for (unsigned int r = 0; r < REGISTER_COUNT; ++r)
+        {
+            if (dirty & Bit(r))
+            {
+                out << "    V[" << Hex(r, 1) << "] = " << Local(r) << ";\n";
+            }
+        }
+        dirty = 0;
+    };
+
+    for (unsigned int r = 0; r < REGISTER_COUNT; ++r)
+    {
+        if (used & Bit(r))
+        {
+            out << "    uint8_t " << Local(r) << " = V[" << Hex(r, 1) << "];\n";
+        }
+    }
+    out << "\n";
+
+    for (unsigned int address = block.start; address < block.end; address += 2)
+    {
+        uint16_t opcode = Opcode(address);
+        Chip8::Handler handler = Chip8::Classify(opcode);
+        std::string vx = Local((opcode >> 8u) & 0xFu);
+        std::string vy = Local((opcode >> 4u) & 0xFu);
+        std::string vf = Local(0xF);
+        std::string kk = Hex(opcode & 0xFFu, 2);
+        std::string nnn = Hex(opcode & 0x0FFFu, 3);
+        std::string next = Hex(address + 2, 4);
+        std::string skip = Hex(address + 4, 4);
+        bool last = address + 2 >= block.end;
+
+        out << "    // " << Hex(address, 4) << ": " << Hex(opcode, 4).substr(2) << "\n";
+
+        // the OP_ handler, with pc where the interpreter would have it and the registers it might read in memory
+        if (Interpreted(handler))
+        {
+            if (handler != Chip8::HANDLER_00E0)
+            {
+                store();
+            }
+            out << "    pc = " << next << ";\n";
+            out << "    Aot::Execute(chip8, " << Hex(opcode, 4) << ");\n";
+
+            // a draw sets VF, read it back if anything after it needs it
+            if (handler == Chip8::HANDLER_Dxyn && !last && (used & Bit(0xF)))
+            {
+                out << "    " << vf << " = V[0xF];\n";
+            }
+            continue;
+        }
+
+        switch (handler)
+        {
+            case Chip8::HANDLER_00EE:
+                out << "    uint8_t& sp = Aot::StackPointer(chip8);\n";
+                out << "    --sp;\n";
+                out << "    pc = Aot::Stack(chip8)[sp];\n";
+                break;
+            case Chip8::HANDLER_1nnn:
+                out << "    pc = " << nnn << ";\n";
+                break;
+            case Chip8::HANDLER_2nnn:
+                out << "    uint8_t& sp = Aot::StackPointer(chip8);\n";
+                out << "    Aot::Stack(chip8)[sp] = " << next << ";\n";
+                out << "    ++sp;\n";
+                out << "    pc = " << nnn << ";\n";
+                break;
+            case Chip8::HANDLER_3xkk:
+                out << "    pc = (" << vx << " == " << kk << ") ? " << skip << " : " << next << ";\n";
+                break;
+            case Chip8::HANDLER_4xkk:
+                out << "    pc = (" << vx << " != " << kk << ") ? " << skip << " : " << next << ";\n";
+                break;
+            case Chip8::HANDLER_5xy0:
+                out << "    pc = " << ((vx == vy) ? skip : "(" + vx + " == " + vy + ") ? " + skip + " : " + next) << ";\n";
+                break;
+            case Chip8::HANDLER_9xy0:
+                out << "    pc = " << ((vx == vy) ? next : "(" + vx + " != " + vy + ") ? " + skip + " : " + next) << ";\n";
+                break;
+            case Chip8::HANDLER_Ex9E:
+                out << "    pc = Aot::Keypad(chip8)[" << vx << "] ? " << skip << " : " << next << ";\n";
+                break;
+            case Chip8::HANDLER_ExA1:
+                out << "    pc = !Aot::Keypad(chip8)[" << vx << "] ? " << skip << " : " << next << ";\n";
+                break;
+            case Chip8::HANDLER_6xkk:
+                out << "    " << vx << " = " << kk << ";\n";
+                break;
+            case Chip8::HANDLER_7xkk:
+                out << "    " << vx << " = static_cast<uint8_t>(" << vx << " + " << kk << ");\n";
+                break;
+            case Chip8::HANDLER_8xy0:
+                out << "    " << vx << " = " << vy << ";\n";
+                break;
+            case Chip8::HANDLER_8xy1:
+                out << "    " << vx << " |= " << vy << ";\n";
+                break;
+            case Chip8::HANDLER_8xy2:
+                out << "    " << vx << " &= " << vy << ";\n";
+                break;
+            case Chip8::HANDLER_8xy3:
+                out << "    " << vx << " ^= " << vy << ";\n";
+                break;
+
+            // the flag goes in before the result exactly as the OP_ handlers do it, which decides what x or y of F end up as. a register
+            // compared with itself is written out as the constant it is, the generated file builds without warnings
+            case Chip8::HANDLER_8xy4:
+                out << "    {\n";
+                out << "        unsigned int sum = " << vx << " + " << vy << ";\n";
+                out << "        " << vf << " = (sum > 255u) ? 1 : 0;\n";
+                out << "        " << vx << " = static_cast<uint8_t>(sum);\n";
+                out << "    }\n";
+                break;
+            case Chip8::HANDLER_8xy5:
+                out << "    " << vf << " = " << ((vx == vy) ? "0" : "(" + vx + " > " + vy + ") ? 1 : 0") << ";\n";
+                out << "    " << vx << " = static_cast<uint8_t>(" << vx << " - " << vy << ");\n";
+                break;
+            case Chip8::HANDLER_8xy7:
+                out << "    " << vf << " = " << ((vx == vy) ? "0" : "(" + vy + " > " + vx + ") ? 1 : 0") << ";\n";
+                out << "    " << vx << " = static_cast<uint8_t>(" << vy << " - " << vx << ");\n";
+                break;
+            case Chip8::HANDLER_8xy6:
+                if (quirks.shiftVy)
+                {
+                    out << "    " << vx << " = " << vy << ";\n";
+                }
+                out << "    " << vf << " = " << vx << " & 0x1u;\n";
+                out << "    " << vx << " >>= 1;\n";
+                break;
+            case Chip8::HANDLER_8xyE:
+                if (quirks.shiftVy)
+                {
+                    out << "    " << vx << " = " << vy << ";\n";
+                }
+                out << "    " << vf << " = (" << vx << " & 0x80u) >> 7u;\n";
+                out << "    " << vx << " = static_cast<uint8_t>(" << vx << " << 1);\n";
+                break;
+
+            case Chip8::HANDLER_Annn:
+                out << "    I = " << nnn << ";\n";
+                break;
+            case Chip8::HANDLER_Cxkk:
+                out << "    " << vx << " = Chip8::RandomByte(Aot::RandomState(chip8)) & " << kk << ";\n";
+                break;
+            case Chip8::HANDLER_Fx07:
+                out << "    " << vx << " = Aot::DelayTimer(chip8);\n";
+                break;
+            case Chip8::HANDLER_Fx15:
+                out << "    Aot::DelayTimer(chip8) = " << vx << ";\n";
+                break;
+            case Chip8::HANDLER_Fx18:
+                out << "    Aot::SoundTimer(chip8) = " << vx << ";\n";
+                break;
+            case Chip8::HANDLER_Fx1E:
+                out << "    I = static_cast<uint16_t>(I + " << vx << ");\n";
+                break;
+            case Chip8::HANDLER_Fx29:
+                out << "    I = static_cast<uint16_t>(Aot::FONTSET_START_ADDRESS + 5 * " << vx << ");\n";
+                break;
+            case Chip8::HANDLER_Fx65:
+            {
+                // straight into the locals the block has, the rest of the registers in memory
+                unsigned int x = (opcode >> 8u) & 0xFu;
+                out << "    {\n";
+                out << "        uint8_t const* M = Aot::Memory(chip8) + I;\n";
+                for (unsigned int r = 0; r <= x; ++r)
+                {
+                    if (used & Bit(r))
+                    {
+                        out << "        " << Local(r) << " = M[" << r << "];\n";
+                        dirty |= Bit(r);
+                    }
+                    else
+                    {
+                        out << "        V[" << Hex(r, 1) << "] = M[" << r << "];\n";
+                    }
+                }
+                out << "    }\n";
+                if (quirks.indexAdvances)
+                {
+                    out << "    I = static_cast<uint16_t>(I + " << x + 1 << ");\n";
+                }
+                break;
+            }
+            default:
+                break;
+        }
+
+        switch (handler)
+        {
+            case Chip8::HANDLER_6xkk: case Chip8::HANDLER_7xkk: case Chip8::HANDLER_Cxkk: case Chip8::HANDLER_Fx07:
+            case Chip8::HANDLER_8xy0: case Chip8::HANDLER_8xy1: case Chip8::HANDLER_8xy2: case Chip8::HANDLER_8xy3:
+                dirty |= Bit((opcode >> 8u) & 0xFu);
+                break;
+            case Chip8::HANDLER_8xy4: case Chip8::HANDLER_8xy5: case Chip8::HANDLER_8xy6: case Chip8::HANDLER_8xy7: case Chip8::HANDLER_8xyE:
+                dirty |= Bit((opcode >> 8u) & 0xFu) | Bit(0xF);
+                break;
+            default:
+                break;
+        }
+    }
+
+    store();
+
+    // a block cut off by a leader or the end of the code falls through
+    if (!EndsBlock(Chip8::Classify(Opcode(block.end - 2u))))
+    {
+        out << "    pc = " << Hex(block.end, 4) << ";\n";
+    }
+    out << "}\n\n";
+}
+
+void AotCompiler::Write(std::ostream& out, std::string const& name, uint64_t hash) const
+{
+    out << "// generated by chip8_aot from " << name << ", any change is lost when it is generated again\n";
+    out << "//\n";
+    out << "// " << CodeBytes() << " bytes of code in " << blocks.size() << " blocks, " << DataBytes() << " bytes of data\n";
+
+    // the code and data ranges, so a reader can see what the walk decided
+    unsigned int end = START_ADDRESS + static_cast<unsigned int>(rom.size());
+    for (unsigned int address = START_ADDRESS; address < end;)
+    {
+        bool isCode = code[address];
+        unsigned int runEnd = address;
+        while (runEnd < end && code[runEnd] == isCode)
+        {
+            ++runEnd;
+        }
+        out << "//     " << Hex(address, 4) << "-" << Hex(runEnd - 1, 4) << (isCode ? " code\n" : " data\n");
+        address = runEnd;
+    }
+
+    out << "\n#include \"Aot.hpp\"\n\n\nnamespace\n{\n\n";
+
+    for (Block const& block : blocks)
+    {
+        WriteBlock(out, block);
+    }
+
+    out << "const AotBlock blocks[] =\n{\n";
+    for (Block const& block : blocks)
+    {
+        out << "    { " << Hex(block.start, 4) << ", " << block.length << ", " << Hex(block.end, 4) << ", Block_" << Hex(block.start, 4).substr(2) << " },\n";
+    }
+    if (blocks.empty())
+    {
+        out << "    { 0, 0, 0, nullptr },\n"; // an array cant be empty, a block of no bytes is never valid
+    }
+    out << "};\n\n";
+
+    out << "const uint8_t rom[] =\n{\n";
+    for (size_t i = 0; i < rom.size(); i += 16)
+    {
+        out << "   ";
+        for (size_t j = i; j < std::min(i + 16, rom.size()); ++j)
+        {
+            out << " " << Hex(rom[j], 2) << ",";
+        }
+        out << "\n";
+    }
+    if (rom.empty())
+    {
+        out << "    0,\n";
+    }
+    out << "};\n\n}\n\n";
+
+    char hashText[32];
+    std::snprintf(hashText, sizeof(hashText), "0x%016llXull", static_cast<unsigned long long>(hash));
+
+    out << "extern AotProgram const aotProgram =\n{\n";
+    out << "    \"" << name << "\",\n";
+    out << "    " << hashText << ",\n";
+    out << "    " << static_cast<unsigned int>(quirks.Bits()) << ",\n";
+    out << "    rom,\n";
+    out << "    " << rom.size() << ",\n";
+    out << "    blocks,\n";
+    out << "    " << blocks.size() << ",\n";
+    out << "};\n";
+}
@@ -0,0 +1,67 @@
+#ifndef AOT_COMPILER_HPP
+#define AOT_COMPILER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "Chip8.hpp"
+
+
+// the ahead of time recompiler chip8_aot runs, a rom in and C++ source for Aot out
+// the rom's control flow is walked from 0x200 the way the interpreter would run it: jumps and calls are followed, skips follow both
+// ways, calls are assumed to return. whatever the walk reaches is code and the rest of the rom is data. the code is cut into basic
+// blocks and each becomes one C++ function that works on the Chip8 through Aot. the chip8 registers a block uses live in locals
+// while it runs, and the instructions that are more than a few lines (draws, clears, memory and key waits) go to their OP_ handler
+//
+// left to the interpreter: wherever a computed Bnnn jump lands, which the walk cant know, and blocks the rom itself writes over.
+// writes with an I set by an Annn in the same block are found here, the rest are caught by Aot when they happen
+class AotCompiler
+{
+public:
+	AotCompiler(uint8_t const* rom, size_t size, Quirks quirks);
+
+	void Write(std::ostream& out, std::string const& name, uint64_t hash) const; // the whole generated file
+
+	size_t BlockCount() const;
+	unsigned int CodeBytes() const;     // rom bytes that are instructions the walk reached
+	unsigned int DataBytes() const;     // the rest of the rom
+	unsigned int ComputedJumps() const; // Bnnn instructions, the walk stops at each one
+	unsigned int SelfModified() const;  // blocks left out because the rom writes over them
+
+private:
+	struct Block
+	{
+		uint16_t start;
+		uint16_t end;    // first address past the block
+		uint16_t length; // instructions
+	};
+
+	void Walk();
+	void Cut();
+	void FindWrites();
+	void WriteBlock(std::ostream& out, Block const& block) const;
+
+	uint16_t Opcode(unsigned int address) const;
+	bool InRom(unsigned int address) const; // a whole instruction fits in the rom there
+	void Target(unsigned int address, std::vector<uint16_t>& work); // a block starts there
+	static bool EndsBlock(Chip8::Handler handler);
+	static bool Interpreted(Chip8::Handler handler); // goes to Aot::Execute instead of being written out
+
+	static const unsigned int MAX_BLOCK_LENGTH = 64; // the same as the block cache and the jit
+
+	std::vector<uint8_t> rom;
+	Quirks quirks;
+
+	bool instruction[MEMORY_SIZE]{}; // the walk reached an instruction starting here
+	bool code[MEMORY_SIZE]{};        // a reached instruction covers this byte
+	bool leader[MEMORY_SIZE]{};      // a block starts here
+	bool written[MEMORY_SIZE]{};     // an Fx33 or Fx55 writes here
+	std::vector<Block> blocks;
+	unsigned int computedJumps = 0;
+	unsigned int selfModified = 0;
+};
+
+
+#endif
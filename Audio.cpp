@@ -0,0 +1,119 @@
+#include "Audio.hpp"
+#include <iostream>
+
+
+Audio::Audio(unsigned int requestedBuffer, unsigned int toneHz, unsigned int requestedRate)
+{
+    unsigned int frames = 32;
+    while (frames < requestedBuffer && frames < 4096)
+    {
+        frames *= 2;
+    }
+
+    // a quarter of full scale, a raw square wave is loud
+    const int16_t AMPLITUDE = 8000;
+    for (unsigned int i = 0; i < TABLE_SIZE; ++i)
+    {
+        table[i] = (i < TABLE_SIZE / 2) ? AMPLITUDE : -AMPLITUDE;
+    }
+
+    if (SDL_InitSubSystem(SDL_INIT_AUDIO) != 0)
+    {
+        std::cerr << "No audio: " << SDL_GetError() << "\n";
+        return;
+    }
+
+    SDL_AudioSpec want{};
+    want.freq = static_cast<int>(requestedRate);
+    want.format = AUDIO_S16SYS;
+    want.channels = 1;
+    want.samples = static_cast<Uint16>(frames);
+    want.callback = Callback;
+    want.userdata = this;
+
+    // only the rate may change, SDL converts anything else itself so Fill always writes mono 16 bit at exactly this buffer size
+    SDL_AudioSpec have{};
+    device = SDL_OpenAudioDevice(nullptr, 0, &want, &have, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE);
+    if (device == 0)
+    {
+        std::cerr << "No audio: " << SDL_GetError() << "\n";
+        SDL_QuitSubSystem(SDL_INIT_AUDIO);
+        return;
+    }
+
+    sampleRate = static_cast<unsigned int>(have.freq);
+    bufferFrames = have.samples;
+    phaseStep = static_cast<uint32_t>((uint64_t(toneHz) << 32) / sampleRate);
+
+    SDL_PauseAudioDevice(device, 0); // starts the callbacks, silence until the first SetTone(true)
+}
+
+Audio::~Audio()
+{
+    if (device != 0)
+    {
+        SDL_CloseAudioDevice(device); // waits for a callback that is running to finish
+        SDL_QuitSubSystem(SDL_INIT_AUDIO);
+    }
+}
+
+void Audio::SetTone(bool on)
+{
+    tone.store(on, std::memory_order_relaxed); // no other data rides along with it, so nothing to order
+}
+
+bool Audio::IsOpen() const
+{
+    return device != 0;
+}
+
+unsigned int Audio::SampleRate() const
+{
+    return sampleRate;
+}
+
+unsigned int Audio::BufferFrames() const
+{
+    return bufferFrames;
+}
+
+double Audio::LatencyMs() const
+{
+    return (sampleRate > 0) ? 1000.0 * bufferFrames / sampleRate : 0.0;
+}
+
+void SDLCALL Audio::Callback(void* userdata, Uint8* stream, int length)
+{
+    static_cast<Audio*>(userdata)->Fill(reinterpret_cast<int16_t*>(stream), static_cast<unsigned int>(length) / sizeof(int16_t));
+}
+
+void Audio::Fill(int16_t* samples, unsigned int count)
+{
+    const unsigned int FULL = 1u << RAMP_SHIFT;
+    unsigned int target = tone.load(std::memory_order_relaxed) ? FULL : 0; // once per buffer, a buffer is shorter than a frame
+
+    // silent and staying silent, the usual case
+    if (target == 0 && level == 0)
+    {
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            samples[i] = 0;
+        }
+        return;
+    }
+
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        if (level < target)
+        {
+            ++level;
+        }
+        else if (level > target)
+        {
+            --level;
+        }
+
+        samples[i] = static_cast<int16_t>((table[phase >> 24] * static_cast<int>(level)) >> RAMP_SHIFT);
+        phase += phaseStep;
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef AUDIO_HPP
+#define AUDIO_HPP
+
+#include <SDL.h>
+#include <atomic>
+#include <cstdint>
+
+
+// the chip8 buzzer, a square wave for as long as the sound timer runs
+// SDL pulls samples from its own audio thread through Fill. everything Fill needs is made up front: one period of the wave in a table,
+// read at the tone's pitch by a phase accumulator, and the on/off state in one atomic the emulation thread sets once a frame. Fill
+// never allocates, locks or makes a system call, so it cant stall the audio thread and cause a dropout
+class Audio
+{
+public:
+	static const unsigned int TABLE_SIZE = 256;       // one period of the wave, indexed by the top 8 bits of the phase
+	static const unsigned int DEFAULT_BUFFER = 256;   // sample frames per callback, 5.3 ms at 48khz
+	static const unsigned int DEFAULT_TONE = 440;     // hz
+
+	// bufferFrames is rounded up to a power of two (SDL wants one) and kept to 32..4096, smaller is less latency and more callbacks.
+	// when no audio device opens the Audio stays silent and IsOpen is false, the emulator runs the same either way
+	explicit Audio(unsigned int bufferFrames = DEFAULT_BUFFER, unsigned int toneHz = DEFAULT_TONE, unsigned int sampleRate = 48000);
+	~Audio();
+
+	Audio(Audio const&) = delete;
+	Audio& operator=(Audio const&) = delete;
+
+	void SetTone(bool on); // from the emulation thread, takes effect at the next sample the audio thread makes
+
+	bool IsOpen() const;
+	unsigned int SampleRate() const;   // what the device gave us, which can differ from what was asked for
+	unsigned int BufferFrames() const;
+	double LatencyMs() const;          // one buffer, what SDL adds on top of that depends on the driver
+
+private:
+	static void SDLCALL Callback(void* userdata, Uint8* stream, int length);
+	void Fill(int16_t* samples, unsigned int count); // audio thread only
+
+	// the gain slides to the new level over 2^RAMP_SHIFT samples instead of jumping, a square wave cut off mid period clicks
+	static const unsigned int RAMP_SHIFT = 6;
+
+	SDL_AudioDeviceID device = 0;
+	unsigned int sampleRate = 0;
+	unsigned int bufferFrames = 0;
+
+	int16_t table[TABLE_SIZE]{};
+	uint32_t phaseStep = 0; // 2^32 is one period
+
+	alignas(64) std::atomic<bool> tone{false}; // the only thing both threads touch
+
+	// audio thread only
+	alignas(64) uint32_t phase = 0;
+	unsigned int level = 0; // 0 silent to 1 << RAMP_SHIFT full volume
+};
+
+
+#endif
@@ -0,0 +1,214 @@
+#include "BlockCache.hpp"
+#include <algorithm>
+
+
+BlockCache::BlockCache()
+{
+    Clear();
+}
+
+void BlockCache::Clear()
+{
+    FlushProfile();
+    ops.clear();
+    blocks.clear();
+    std::fill(std::begin(blockAt), std::end(blockAt), -1);
+    std::fill(std::begin(coverage), std::end(coverage), 0);
+}
+
+// same work as calling Cycle() once per instruction, the fetch and decode just already happened when the block was built
+void BlockCache::Run(Chip8& chip8, unsigned int cycles)
+{
+    while (cycles > 0)
+    {
+        uint16_t pc = chip8.pc;
+
+        // an instruction at the very last byte of memory cant be cached, let Cycle deal with it
+        if (pc >= MEMORY_SIZE - 1)
+        {
+            chip8.Cycle();
+            --cycles;
+            continue;
+        }
+
+        int32_t id = blockAt[pc];
+        if (id < 0)
+        {
+            id = Build(chip8, pc);
+        }
+
+        Block& block = blocks[id];
+        Op const* op = &ops[block.firstOp];
+        unsigned int count = std::min<unsigned int>(block.length, cycles);
+
+        // a block cut short by the end of the run is counted instruction by instruction, before any of it runs and can move pc
+        if (profiler)
+        {
+            if (count == block.length)
+            {
+                ++block.runs;
+            }
+            else
+            {
+                for (unsigned int i = 0; i < count; ++i)
+                {
+                    profiler->Execute(static_cast<uint16_t>(block.start + i * 2u));
+                }
+            }
+        }
+
+        // the tight loop, only the last instruction of a block can jump or write memory so pc just walks forward until then
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            chip8.instruction = op[i].instruction;
+            CHIP8_TRACE_RECORD(chip8.trace.get(), TraceLevel::Verbose, chip8.cycleCount, chip8.pc, chip8.instruction.opcode, TraceEvent::Execute);
+            ++chip8.cycleCount;
+            chip8.pc += 2;
+            (chip8.*(op[i].handler))();
+        }
+
+        cycles -= count;
+    }
+}
+
+// instructions that can move the pc somewhere other than the next instruction, or that write memory and so might rewrite the code after them
+bool BlockCache::EndsBlock(uint16_t opcode)
+{
+    switch ((opcode & 0xF000u) >> 12u)
+    {
+        case 0x0: return opcode == 0x00EE; // RET
+        case 0x1: // JP
+        case 0x2: // CALL
+        case 0x3: // SE Vx, byte
+        case 0x4: // SNE Vx, byte
+        case 0x5: // SE Vx, Vy
+        case 0x9: // SNE Vx, Vy
+        case 0xB: // JP V0
+        case 0xE: // SKP, SKNP
+            return true;
+        case 0xF: return (opcode & 0x00FFu) == 0x33 || (opcode & 0x00FFu) == 0x55; // LD B, LD [I]
+        default: return false;
+    }
+}
+
+int32_t BlockCache::Build(Chip8 const& chip8, uint16_t start)
+{
+    if (ops.size() + MAX_BLOCK_LENGTH > MAX_CACHED_OPS)
+    {
+        Clear();
+    }
+
+    Block block{};
+    block.start = start;
+    block.firstOp = static_cast<uint32_t>(ops.size());
+    block.valid = true;
+
+    uint16_t address = start;
+
+    // decode forward until something ends the block, the block runs out of room, or memory runs out
+    while (block.length < MAX_BLOCK_LENGTH && address < MEMORY_SIZE - 1)
+    {
+        uint16_t opcode = (chip8.memory[address] << 8u) | chip8.memory[address + 1];
+
+        ops.push_back({chip8.Decode(opcode), Chip8::Split(opcode)});
+
+        if (profiler)
+        {
+            profiler->CodeChanged(address, Chip8::Classify(opcode));
+        }
+        ++block.length;
+        address += 2;
+
+        if (EndsBlock(opcode))
+        {
+            break;
+        }
+    }
+
+    for (uint16_t i = start; i < address; ++i)
+    {
+        ++coverage[i];
+    }
+
+    int32_t id = static_cast<int32_t>(blocks.size());
+    blocks.push_back(block);
+    blockAt[start] = static_cast<int16_t>(id);
+    return id;
+}
+
+// called after every memory write, most writes land in data and return straight away because nothing covers them
+void BlockCache::Invalidate(uint16_t address, uint16_t length)
+{
+    unsigned int first = address;
+    unsigned int last = std::min<unsigned int>(address + length, MEMORY_SIZE);
+
+    bool hitsCode = false;
+    for (unsigned int i = first; i < last; ++i)
+    {
+        if (coverage[i] != 0)
+        {
+            hitsCode = true;
+            break;
+        }
+    }
+
+    if (!hitsCode)
+    {
+        return;
+    }
+
+    // self modifying code, find every block overlapping the write and forget it
+    for (Block& block : blocks)
+    {
+        unsigned int blockEnd = block.start + block.length * 2u;
+
+        if (!block.valid || blockEnd <= first || block.start >= last)
+        {
+            continue;
+        }
+
+        Flush(block);
+        block.valid = false;
+        blockAt[block.start] = -1;
+
+        for (unsigned int i = block.start; i < blockEnd; ++i)
+        {
+            --coverage[i];
+        }
+    }
+}
+
+void BlockCache::SetProfiler(Profiler* value)
+{
+    FlushProfile();
+    profiler = value;
+
+    for (Block const& block : blocks)
+    {
+        for (unsigned int i = 0; profiler && block.valid && i < block.length; ++i)
+        {
+            profiler->CodeChanged(static_cast<uint16_t>(block.start + i * 2u), Chip8::Classify(ops[block.firstOp + i].instruction.opcode));
+        }
+    }
+}
+
+void BlockCache::FlushProfile()
+{
+    for (Block& block : blocks)
+    {
+        Flush(block);
+    }
+}
+
+void BlockCache::Flush(Block& block)
+{
+    if (profiler && block.runs > 0)
+    {
+        for (unsigned int i = 0; i < block.length; ++i)
+        {
+            profiler->Execute(static_cast<uint16_t>(block.start + i * 2u), block.runs);
+        }
+    }
+
+    block.runs = 0;
+}
@@ -0,0 +1,59 @@
+#ifndef BLOCKCACHE_HPP
+#define BLOCKCACHE_HPP
+
+#include <cstdint>
+#include <vector>
+#include "Chip8.hpp"
+
+
+// cached basic block interpreter
+// a block is a straight line run of instructions that starts at some pc and ends at the first instruction that can change the pc
+// (jumps, calls, returns, skips) or write to memory (Fx33, Fx55). each block is decoded once, after that it is replayed from the
+// cache with one indirect call per instruction instead of a fetch, a table lookup and a second table lookup
+class BlockCache
+{
+public:
+	BlockCache();
+
+	void Run(Chip8& chip8, unsigned int cycles);
+	void Invalidate(uint16_t address, uint16_t length); // drop every block that covers any of these bytes
+	void Clear();
+
+	// while a profiler is set each block counts its complete runs, and the counts are handed to the profiler per address when the block
+	// is dropped or FlushProfile is called. that is one increment per block instead of one per instruction
+	void SetProfiler(Profiler* profiler); // flushes into the old one first, and tells the new one what is already decoded
+	void FlushProfile();
+
+private:
+	struct Op
+	{
+		Chip8::Chip8Func handler;
+		Chip8::Instruction instruction;
+	};
+
+	struct Block
+	{
+		uint16_t start;  // address of the first instruction
+		uint16_t length; // number of instructions
+		uint32_t firstOp; // index of the first instruction in ops
+		bool valid;
+		uint64_t runs;   // complete runs not yet given to the profiler
+	};
+
+	void Flush(Block& block);
+
+	int32_t Build(Chip8 const& chip8, uint16_t start);
+	static bool EndsBlock(uint16_t opcode);
+
+	static const unsigned int MAX_BLOCK_LENGTH = 64;
+	static const unsigned int MAX_CACHED_OPS = 8192; // once this many instructions are cached everything is thrown out and rebuilt
+
+	std::vector<Op> ops;
+	std::vector<Block> blocks;
+	int16_t blockAt[MEMORY_SIZE];      // block starting at each address, -1 if there is none yet
+	uint16_t coverage[MEMORY_SIZE]{}; // how many valid blocks contain each byte, lets Invalidate skip writes to plain data quickly
+	Profiler* profiler = nullptr;
+};
+
+
+#endif
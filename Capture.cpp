@@ -0,0 +1,493 @@
+#include "Capture.hpp"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+
+namespace
+{
+    void PutLE16(std::vector<uint8_t>& out, unsigned int value)
+    {
+        out.push_back(static_cast<uint8_t>(value));
+        out.push_back(static_cast<uint8_t>(value >> 8));
+    }
+
+    // GIF image data for pixels that are all 0 or 1: the LZW minimum code size, the codes packed least significant bit first into
+    // sub blocks of up to 255 bytes, and the empty block that ends them. the dictionary is a tree with two children per code, one per colour,
+    // and a code's children are cleared when the code is made so starting over never has to wipe the whole table
+    void GifLzw(uint8_t const* pixels, size_t count, std::vector<uint8_t>& out)
+    {
+        const unsigned int MIN_CODE_SIZE = 2; // the smallest GIF allows, even for two colours
+        const unsigned int CLEAR = 1u << MIN_CODE_SIZE;
+        const unsigned int END = CLEAR + 1;
+        const unsigned int MAX_CODE = 4095;
+
+        uint16_t tree[MAX_CODE + 1][2];
+        std::memset(tree, 0, sizeof(tree[0]) * 2); // the two single pixel codes, the only ones there are before the first new code
+
+        out.push_back(MIN_CODE_SIZE);
+
+        uint8_t block[255];
+        unsigned int blockLength = 0;
+        uint32_t bits = 0;
+        unsigned int bitCount = 0;
+
+        auto put = [&](unsigned int code, unsigned int size)
+        {
+            bits |= code << bitCount;
+            bitCount += size;
+
+            while (bitCount >= 8)
+            {
+                block[blockLength++] = static_cast<uint8_t>(bits);
+                bits >>= 8;
+                bitCount -= 8;
+
+                if (blockLength == sizeof(block))
+                {
+                    out.push_back(static_cast<uint8_t>(blockLength));
+                    out.insert(out.end(), block, block + blockLength);
+                    blockLength = 0;
+                }
+            }
+        };
+
+        unsigned int codeSize = MIN_CODE_SIZE + 1;
+        unsigned int lastCode = END;
+        put(CLEAR, codeSize);
+
+        unsigned int current = pixels[0] & 1;
+        for (size_t i = 1; i < count; ++i)
+        {
+            unsigned int pixel = pixels[i] & 1;
+
+            if (tree[current][pixel] != 0)
+            {
+                current = tree[current][pixel];
+                continue;
+            }
+
+            put(current, codeSize);
+            tree[current][pixel] = static_cast<uint16_t>(++lastCode);
+            tree[lastCode][0] = 0;
+            tree[lastCode][1] = 0;
+
+            // the decoder adds the same entry one code later and widens its codes at the same moment
+            if (lastCode >= (1u << codeSize))
+            {
+                ++codeSize;
+            }
+
+            if (lastCode == MAX_CODE)
+            {
+                put(CLEAR, codeSize);
+                std::memset(tree, 0, sizeof(tree[0]) * 2);
+                codeSize = MIN_CODE_SIZE + 1;
+                lastCode = END;
+            }
+
+            current = pixel;
+        }
+
+        put(current, codeSize);
+
+        // reading that last code the decoder adds one more entry, and widens its codes if that fills the current size
+        if (lastCode + 1 >= (1u << codeSize) && codeSize < 12)
+        {
+            ++codeSize;
+        }
+        put(CLEAR, codeSize);
+        put(END, MIN_CODE_SIZE + 1); // after a clear the decoder is back to the smallest code size
+        if (bitCount > 0)
+        {
+            put(0, 8 - bitCount);
+        }
+
+        if (blockLength > 0)
+        {
+            out.push_back(static_cast<uint8_t>(blockLength));
+            out.insert(out.end(), block, block + blockLength);
+        }
+        out.push_back(0);
+    }
+
+    // a frame count at 60 fps in GIF time, hundredths of a second
+    uint64_t Centiseconds(uint64_t frames)
+    {
+        return (frames * 100 + 30) / 60;
+    }
+
+    // BT.601 studio range, what Y4M players assume
+    void ToYCbCr(uint32_t rgba, uint8_t* out)
+    {
+        double r = (rgba >> 24) & 0xFF;
+        double g = (rgba >> 16) & 0xFF;
+        double b = (rgba >> 8) & 0xFF;
+
+        out[0] = static_cast<uint8_t>(16.5 + (65.481 * r + 128.553 * g + 24.966 * b) / 255.0);
+        out[1] = static_cast<uint8_t>(128.5 + (-37.797 * r - 74.203 * g + 112.0 * b) / 255.0);
+        out[2] = static_cast<uint8_t>(128.5 + (112.0 * r - 93.786 * g - 18.214 * b) / 255.0);
+    }
+}
+
+Capture::~Capture()
+{
+    Close();
+}
+
+bool Capture::Open(char const* path, CaptureFormat captureFormat, unsigned int captureScale, ScaleFilter captureFilter, Palette capturePalette)
+{
+    Close();
+
+    if (captureScale == 0 || captureScale > MAX_SCALE || (captureFilter == ScaleFilter::Scale2x && captureScale % 2 != 0))
+    {
+        return false;
+    }
+
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file)
+    {
+        return false;
+    }
+
+    format = captureFormat;
+    scale = captureScale;
+    filter = captureFilter;
+    palette = capturePalette;
+    width = VIDEO_WIDTH * scale;
+    height = VIDEO_HEIGHT * scale;
+    ToYCbCr(palette.off, yuv[0]);
+    ToYCbCr(palette.on, yuv[1]);
+
+    pixels.assign(size_t(width) * height, 0);
+    previous.assign(size_t(width) * height, 2); // not a colour, so every row of the first GIF frame counts as changed
+    writtenFrames = 0;
+
+    havePending = false;
+    frames = 0;
+    distinct = 0;
+    closing.store(false, std::memory_order_relaxed);
+    failed.store(false, std::memory_order_relaxed);
+    queue.reset(new SpscQueue<Captured, QUEUE_FRAMES>());
+
+    WriteHeader();
+    writer = std::thread(&Capture::WriterLoop, this);
+    return true;
+}
+
+bool Capture::Close()
+{
+    if (!queue)
+    {
+        return !failed.load(std::memory_order_relaxed);
+    }
+
+    if (havePending)
+    {
+        Push(pending);
+        havePending = false;
+    }
+
+    closing.store(true, std::memory_order_release);
+    writer.join();
+
+    WriteTrailer();
+    file.flush();
+    if (!file)
+    {
+        failed.store(true, std::memory_order_relaxed);
+    }
+    file.close();
+    queue.reset();
+
+    return !failed.load(std::memory_order_relaxed);
+}
+
+// the only work on the emulation thread, a 256 byte compare and now and then a 264 byte copy into the queue
+void Capture::Frame(uint64_t const* video)
+{
+    if (!queue)
+    {
+        return;
+    }
+
+    ++frames;
+
+    if (havePending && std::memcmp(pending.video, video, sizeof(pending.video)) == 0)
+    {
+        ++pending.repeats;
+        return;
+    }
+
+    if (havePending)
+    {
+        Push(pending);
+    }
+
+    std::memcpy(pending.video, video, sizeof(pending.video));
+    pending.repeats = 1;
+    havePending = true;
+    ++distinct;
+}
+
+// the writer only falls QUEUE_FRAMES distinct frames behind when the disk cant keep up, then there is nothing better to do than wait
+void Capture::Push(Captured const& frame)
+{
+    while (!queue->Push(frame))
+    {
+        std::this_thread::yield();
+    }
+}
+
+void Capture::WriterLoop()
+{
+    Captured frame;
+
+    for (;;)
+    {
+        if (queue->Pop(frame))
+        {
+            WriteFrame(frame);
+            continue;
+        }
+
+        // everything pushed before closing was set is visible once it is seen set, so one last drain gets the lot
+        if (closing.load(std::memory_order_acquire))
+        {
+            while (queue->Pop(frame))
+            {
+                WriteFrame(frame);
+            }
+            return;
+        }
+
+        // nothing to do, a game changes the screen at most 60 times a second so a short nap costs no latency that matters
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+void Capture::WriteHeader()
+{
+    encoded.clear();
+
+    if (format == CaptureFormat::Y4M)
+    {
+        std::string header = "YUV4MPEG2 W" + std::to_string(width) + " H" + std::to_string(height) + " F60:1 Ip A1:1 C444\n";
+        encoded.assign(header.begin(), header.end());
+    }
+    else if (format == CaptureFormat::Gif)
+    {
+        static char const signature[] = "GIF89a";
+        encoded.assign(signature, signature + 6);
+        PutLE16(encoded, width);
+        PutLE16(encoded, height);
+        encoded.push_back(0x80); // a global colour table of 2 entries
+        encoded.push_back(0);    // background colour
+        encoded.push_back(0);    // square pixels
+
+        for (uint32_t colour : { palette.off, palette.on })
+        {
+            encoded.push_back(static_cast<uint8_t>(colour >> 24));
+            encoded.push_back(static_cast<uint8_t>(colour >> 16));
+            encoded.push_back(static_cast<uint8_t>(colour >> 8));
+        }
+
+        // loop forever
+        static uint8_t const loop[] = { 0x21, 0xFF, 0x0B, 'N', 'E', 'T', 'S', 'C', 'A', 'P', 'E', '2', '.', '0', 0x03, 0x01, 0x00, 0x00, 0x00 };
+        encoded.insert(encoded.end(), loop, loop + sizeof(loop));
+    }
+
+    file.write(reinterpret_cast<char const*>(encoded.data()), encoded.size());
+}
+
+void Capture::WriteFrame(Captured const& frame)
+{
+    // GIF and Y4M want palette indexes, raw wants the colours themselves
+    Palette indexPalette{ 0, 1 };
+    ScaleVideo(frame.video, pixels.data(), width, scale, filter, (format == CaptureFormat::Raw) ? palette : indexPalette);
+
+    size_t count = pixels.size();
+
+    if (format == CaptureFormat::Gif)
+    {
+        WriteGifFrame(frame.repeats);
+    }
+    else
+    {
+        if (format == CaptureFormat::Raw)
+        {
+            // the palette is 0xRRGGBBAA as a number, the file wants the bytes in R G B A order
+            encoded.resize(count * 4);
+            for (size_t i = 0; i < count; ++i)
+            {
+                uint32_t colour = pixels[i];
+                encoded[i * 4 + 0] = static_cast<uint8_t>(colour >> 24);
+                encoded[i * 4 + 1] = static_cast<uint8_t>(colour >> 16);
+                encoded[i * 4 + 2] = static_cast<uint8_t>(colour >> 8);
+                encoded[i * 4 + 3] = static_cast<uint8_t>(colour);
+            }
+        }
+        else
+        {
+            static char const marker[] = "FRAME\n";
+            encoded.assign(marker, marker + 6);
+            encoded.resize(6 + count * 3);
+
+            for (unsigned int plane = 0; plane < 3; ++plane)
+            {
+                uint8_t* out = &encoded[6 + plane * count];
+                uint8_t off = yuv[0][plane];
+                uint8_t on = yuv[1][plane];
+                for (size_t i = 0; i < count; ++i)
+                {
+                    out[i] = pixels[i] ? on : off;
+                }
+            }
+        }
+
+        for (uint64_t repeat = 0; repeat < frame.repeats; ++repeat)
+        {
+            file.write(reinterpret_cast<char const*>(encoded.data()), encoded.size());
+        }
+    }
+
+    if (!file)
+    {
+        failed.store(true, std::memory_order_relaxed);
+    }
+}
+
+// one GIF frame holding only the band of rows that changed since the frame before, shown for as long as the repeats last
+void Capture::WriteGifFrame(uint64_t repeats)
+{
+    unsigned int top = 0;
+    unsigned int bottom = height;
+
+    auto sameRow = [this](unsigned int row)
+    {
+        return std::equal(&pixels[size_t(row) * width], &pixels[size_t(row + 1) * width], &previous[size_t(row) * width]);
+    };
+    while (top < height && sameRow(top))
+    {
+        ++top;
+    }
+    while (bottom > top && sameRow(bottom - 1))
+    {
+        --bottom;
+    }
+    if (top == bottom)
+    {
+        top = 0; // a scaled frame can come out the same as the last, a frame still has to hold at least one row
+        bottom = 1;
+    }
+
+    uint64_t delay = Centiseconds(writtenFrames + repeats) - Centiseconds(writtenFrames);
+    writtenFrames += repeats;
+
+    // a delay only has 16 bits, longer still screens go out as more frames of the same one row
+    do
+    {
+        unsigned int chunk = static_cast<unsigned int>(std::min<uint64_t>(delay, 0xFFFF));
+        delay -= chunk;
+
+        encoded.clear();
+        static uint8_t const control[] = { 0x21, 0xF9, 0x04, 0x04 }; // graphic control, leave the frame in place for the next one to draw over
+        encoded.insert(encoded.end(), control, control + sizeof(control));
+        PutLE16(encoded, chunk);
+        encoded.push_back(0);
+        encoded.push_back(0);
+
+        encoded.push_back(0x2C); // image descriptor, full width, rows top to bottom, no local colour table
+        PutLE16(encoded, 0);
+        PutLE16(encoded, top);
+        PutLE16(encoded, width);
+        PutLE16(encoded, bottom - top);
+        encoded.push_back(0);
+
+        size_t first = size_t(top) * width;
+        size_t count = size_t(bottom - top) * width;
+        indexes.resize(count);
+        std::copy(&pixels[first], &pixels[first] + count, indexes.begin());
+        GifLzw(indexes.data(), count, encoded);
+
+        file.write(reinterpret_cast<char const*>(encoded.data()), encoded.size());
+        bottom = top + 1;
+    }
+    while (delay > 0);
+
+    previous.swap(pixels);
+}
+
+void Capture::WriteTrailer()
+{
+    if (format == CaptureFormat::Gif)
+    {
+        file.put(0x3B);
+    }
+}
+
+uint64_t Capture::Frames() const
+{
+    return frames;
+}
+
+uint64_t Capture::DistinctFrames() const
+{
+    return distinct;
+}
+
+CaptureFormat Capture::FormatFor(char const* path)
+{
+    std::string name = path;
+    std::string extension = name.substr(name.find_last_of('.') == std::string::npos ? name.size() : name.find_last_of('.'));
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+    if (extension == ".gif")
+    {
+        return CaptureFormat::Gif;
+    }
+    if (extension == ".y4m")
+    {
+        return CaptureFormat::Y4M;
+    }
+    return CaptureFormat::Raw;
+}
+
+std::unique_ptr<Capture> Capture::FromEnvironment()
+{
+    char const* path = std::getenv("CHIP8_CAPTURE");
+    if (!path)
+    {
+        return nullptr;
+    }
+
+    unsigned int captureScale = 1;
+    if (char const* scaleText = std::getenv("CHIP8_CAPTURE_SCALE"))
+    {
+        captureScale = static_cast<unsigned int>(std::strtoul(scaleText, nullptr, 10));
+    }
+
+    ScaleFilter captureFilter = ScaleFilter::Nearest;
+    if (char const* scalerName = std::getenv("CHIP8_SCALER"))
+    {
+        captureFilter = (std::string(scalerName) == "scale2x") ? ScaleFilter::Scale2x : ScaleFilter::Nearest;
+    }
+
+    Palette capturePalette;
+    if (char const* colours = std::getenv("CHIP8_PALETTE"))
+    {
+        capturePalette = ParsePalette(colours);
+    }
+
+    std::unique_ptr<Capture> capture(new Capture());
+    if (!capture->Open(path, FormatFor(path), captureScale, captureFilter, capturePalette))
+    {
+        std::cerr << "Could not capture to " << path << " (the file cant be written, or CHIP8_CAPTURE_SCALE isnt 1 to " << MAX_SCALE << " and even for scale2x)\n";
+        return nullptr;
+    }
+    return capture;
+}
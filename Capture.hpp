@@ -0,0 +1,99 @@
+#ifndef CAPTURE_HPP
+#define CAPTURE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "Chip8.hpp"
+#include "Scaler.hpp"
+#include "SpscQueue.hpp"
+
+
+enum class CaptureFormat
+{
+	Raw, // RGBA8888 frames back to back, ffmpeg -f rawvideo -pix_fmt rgba -s WxH -r 60
+	Y4M, // YUV4MPEG2 4:4:4 at 60 fps, plays in ffmpeg, mpv and vlc as it is
+	Gif, // animated GIF, two colours, only the rows that changed are stored for each frame
+};
+
+// records the display once per 60hz frame into a video file for QA reports, no codec library needed
+// Frame only compares the display with the last one and, when it differs, hands the 256 bytes of it to a writer thread through a lock
+// free queue. a frame the same as the one before just bumps a repeat count, so a game sitting on one screen costs nothing at all and
+// the writer scales, encodes and writes each distinct frame once. Y4M and raw have no way to say "repeat", the writer writes the same
+// bytes again; the GIF gets one frame with a longer delay
+class Capture
+{
+public:
+	static const unsigned int QUEUE_FRAMES = 256; // distinct frames the writer can fall behind by before Frame waits for it
+
+	Capture() = default;
+	~Capture();
+
+	Capture(Capture const&) = delete;
+	Capture& operator=(Capture const&) = delete;
+
+	bool Open(char const* path, CaptureFormat format, unsigned int scale = 1, ScaleFilter filter = ScaleFilter::Nearest, Palette palette = Palette{});
+	bool Close(); // writes the last frame and waits for the writer, false if anything failed to write
+
+	void Frame(uint64_t const* video); // once per emulated frame, always from the same thread
+	void Frame(Chip8 const& chip8)
+	{
+		Frame(chip8.video);
+	}
+
+	uint64_t Frames() const;         // every frame seen, repeats included
+	uint64_t DistinctFrames() const;
+
+	static CaptureFormat FormatFor(char const* path); // from the extension, .gif, .y4m, anything else is raw
+
+	// what the tools use: CHIP8_CAPTURE=path turns capture on, CHIP8_CAPTURE_SCALE=n scales it, CHIP8_SCALER=scale2x and
+	// CHIP8_PALETTE=RRGGBBAA,RRGGBBAA work as they do for the window. null if CHIP8_CAPTURE isnt set or the file cant be opened
+	static std::unique_ptr<Capture> FromEnvironment();
+
+private:
+	struct Captured
+	{
+		uint64_t video[VIDEO_HEIGHT];
+		uint64_t repeats; // how many frames in a row looked like this
+	};
+
+	void Push(Captured const& frame);
+	void WriterLoop();
+	void WriteHeader();
+	void WriteFrame(Captured const& frame);
+	void WriteGifFrame(uint64_t repeats);
+	void WriteTrailer();
+
+	// emulation side
+	Captured pending{};     // the newest distinct frame, held back until it is known how often it repeats
+	bool havePending = false;
+	uint64_t frames = 0;
+	uint64_t distinct = 0;
+
+	// writer side
+	std::ofstream file;
+	CaptureFormat format = CaptureFormat::Raw;
+	unsigned int scale = 1;
+	ScaleFilter filter = ScaleFilter::Nearest;
+	Palette palette;
+	unsigned int width = 0;
+	unsigned int height = 0;
+	uint8_t yuv[2][3] = {};         // Y4M only, the palette colours as Y, Cb, Cr
+	std::vector<uint32_t> pixels;   // the frame scaled, RGBA for raw and palette indexes (0 or 1) otherwise
+	std::vector<uint8_t> indexes;   // GIF only, the changed rows as one byte per pixel for the LZW coder
+	std::vector<uint8_t> encoded;   // the frame as written, reused for every repeat
+	std::vector<uint32_t> previous; // GIF only, the last frame written, to find the rows that changed
+	uint64_t writtenFrames = 0;     // GIF only, frame time so far, delays are rounded from it so they never drift
+
+	std::unique_ptr<SpscQueue<Captured, QUEUE_FRAMES>> queue;
+	std::thread writer;
+	std::atomic<bool> closing{false};
+	std::atomic<bool> failed{false};
+};
+
+
+#endif
@@ -1,8 +1,13 @@
 #include <fstream> // this includes teh fsteam header file which provides functionality for file input/output in c++
 #include "Chip8.hpp"
-#include <random>
+#include "Aot.hpp"
+#include "BlockCache.hpp"
+#include "Jit.hpp"
+#include "SaveState.hpp"
 #include <cstring>
 #include <iostream>
+#include <algorithm>
+#include <string>
 
 //roms will look for memeory starting at 0x200 address as the 0x000-0x1FF was reserved in the original
 const unsigned int START_ADRESS = 0x200; 
@@ -35,7 +40,6 @@ uint8_t fontset[FONTSET_SIZE] =
 
 // initially set PC to 0x200 in the constructor because that will be the first instruction executed
 Chip8::Chip8()
-    :randGen(std::chrono::system_clock::now().time_since_epoch().count()) //member initalizer list, init randGen with seed
 {
     //Initilize PC
     pc = START_ADRESS;
@@ -46,8 +50,11 @@ Chip8::Chip8()
         memory[FONTSET_START_ADRESS + i] = fontset[i];
     }
 
-    // Initialize RNG
-    randByte = std::uniform_int_distribution<uint8_t>(0, 255U); //get a random number between 0 and 255
+    // the blank screen has never been shown yet, so the first present should upload it
+    dirty = true;
+
+    // Initialize RNG, different every run unless someone calls Seed
+    Seed(static_cast<uint32_t>(std::chrono::system_clock::now().time_since_epoch().count()));
 
     // Set up Function pointer table, it stores the memory address of a function. we could theoretically use switch statements or if else but this is faster
     // table is our main lookup table, it looks at the first nibble (first 4 bits, half a byte) of the opcode, in the opcode it will be a single hex
@@ -62,15 +69,15 @@ Chip8::Chip8()
     table[0x8] = &Chip8::Table8; // secondary table that points to opcode that starts with 0x8, in opcode that starts with 0x8 the last bit is nessesary to differentiate which function to call
     table[0x9] = &Chip8::OP_9xy0;
     table[0xA] = &Chip8::OP_Annn;
-    table[0xB] = &Chip8::OP_Bnnn;
+    table[0xB] = &Chip8::OP_Bnnn<false>; // SetQuirks swaps the quirk instantiations in and out of the tables
     table[0xC] = &Chip8::OP_Cxkk;
-    table[0xD] = &Chip8::OP_Dxyn;
+    table[0xD] = &Chip8::OP_Dxyn<false>;
     table[0xE] = &Chip8::TableE; // secondary table that again needs last byte to differentiate 
     table[0xF] = &Chip8::TableF; // secondary table that again needs last byte to differentiate
 
     // this loop will initialize all the secondary table values to a function pointer to NULL, just in case there is an opcode in the rom that is incorrect or something like that there wont be a function that is called that has no defined action
     // we initialize all the values to null, and then we update the ones that have functions after this loop here
-    for (size_t i = 0; i <= 0xE; i++) // i here takes on the value of 0x0 (0000 in binay) up to 0xE (1110), which is basically 0-14 in real digits as these are the only possible values the last byte could take according to the CHIP-8 instructions
+    for (size_t i = 0; i <= 0xF; i++) // i here takes on the value of 0x0 (0000 in binay) up to 0xF (1111), the last nibble can be any of these even though no real instruction ends in 0xF, so a bad opcode still lands on OP_NULL
     {
         table0[i] = &Chip8::OP_NULL;
         table8[i] = &Chip8::OP_NULL;
@@ -87,9 +94,9 @@ Chip8::Chip8()
     table8[0x3] = &Chip8::OP_8xy3;
     table8[0x4] = &Chip8::OP_8xy4;
     table8[0x5] = &Chip8::OP_8xy5;
-    table8[0x6] = &Chip8::OP_8xy6;    
+    table8[0x6] = &Chip8::OP_8xy6<false>;
     table8[0x7] = &Chip8::OP_8xy7;
-    table8[0xE] = &Chip8::OP_8xyE;
+    table8[0xE] = &Chip8::OP_8xyE<false>;
 
     tableE[0x1] = &Chip8::OP_ExA1;
     tableE[0xE] = &Chip8::OP_Ex9E;
@@ -106,44 +113,68 @@ Chip8::Chip8()
     tableF[0x1E] = &Chip8::OP_Fx1E;
     tableF[0x29] = &Chip8::OP_Fx29;
     tableF[0x33] = &Chip8::OP_Fx33;
-    tableF[0x55] = &Chip8::OP_Fx55;
-    tableF[0x65] = &Chip8::OP_Fx65;
+    tableF[0x55] = &Chip8::OP_Fx55<false>;
+    tableF[0x65] = &Chip8::OP_Fx65<false>;
+
+    for (size_t i = 0; i < HANDLER_COUNT; ++i)
+    {
+        specialized[i] = static_cast<Handler>(i); // the default quirks, nothing is swapped
+    }
 }
 
+// defined here rather than in the header because BlockCache and Jit are only forward declared there
+Chip8::~Chip8() = default;
+
 
 
 // LoadROM is a function to load the contents of chip8 tom file into the eulators memory
-void Chip8::LoadROM(char const* filename)
+bool Chip8::LoadROM(char const* filename)
 {
     // open file as a stream of binary and move the file pointer to the end
     std::ifstream file(filename, std::ios::binary | std::ios::ate);
 
-    if (file.is_open())
-    // checks to see if the file was opened, code wont execute if the files was not opened
+    if (!file.is_open())
     {
-        //
-        std::streampos size = file.tellg();
-        std::cout << "Loading ROM, SIZE: " << size << "bytes\n";
-        char* buffer = new char[size];
+        std::cerr << "Failed to open Rom file " << filename << "\n";
+        return false;
+    }
 
-        // go back to the begginning of the file and fill the buffer
-        file.seekg(0, std::ios::beg);
-        file.read(buffer, size);
-        file.close();
+    // anything past 0xFFF would be written off the end of memory
+    std::streamoff size = file.tellg();
+    if (size <= 0 || size > static_cast<std::streamoff>(MAX_ROM_SIZE))
+    {
+        std::cerr << "Rom file " << filename << " is " << size << " bytes, it has to be 1 to " << MAX_ROM_SIZE << "\n";
+        return false;
+    }
 
-        // load the rom contents into the chip8s memory, starting at 0x200
-        for (long i = 0; i < size; i++)
-        {
-            memory[START_ADRESS + i] = buffer[i];
-        }
-        // free the buffer
-        delete [] buffer;
+    // straight into memory at 0x200, no buffer in between
+    file.seekg(0, std::ios::beg);
+    if (!file.read(reinterpret_cast<char*>(&memory[START_ADRESS]), size))
+    {
+        std::cerr << "Failed to read Rom file " << filename << "\n";
+        return false;
     }
-    else
+
+    RomLoaded(static_cast<uint16_t>(size));
+    return true;
+}
+
+bool Chip8::LoadROM(uint8_t const* data, size_t size)
+{
+    if (size == 0 || size > MAX_ROM_SIZE)
     {
-        std::cout <<"Failed to open Rom file \n";
+        return false;
     }
 
+    std::memcpy(&memory[START_ADRESS], data, size);
+    RomLoaded(static_cast<uint16_t>(size));
+    return true;
+}
+
+void Chip8::RomLoaded(uint16_t size)
+{
+    CodeWritten(START_ADRESS, size);
+    CHIP8_TRACE_RECORD(trace.get(), TraceLevel::Info, cycleCount, pc, 0, TraceEvent::RomLoaded, static_cast<uint8_t>(size >> 8), static_cast<uint8_t>(size));
 }
 
 // One cycle of this CPU will do three things
@@ -153,34 +184,678 @@ void Chip8::LoadROM(char const* filename)
 void Chip8::Cycle()
 {
     // Fetch
-    opcode = (memory[pc] << 8u) | memory[pc + 1]; // memory is a member variable representing the chip8s memory, the | is used to combine the shifted bytes to create a single 16 bit value
+    uint16_t opcode = (memory[pc] << 8u) | memory[pc + 1]; // memory is a member variable representing the chip8s memory, the | is used to combine the shifted bytes to create a single 16 bit value
     // remember the opcode first 8 bits is the function and last 8 bits is the numbers
-    
+
+    instruction = Split(opcode); // the handlers read their operands from here
+
+    CHIP8_TRACE_RECORD(trace.get(), TraceLevel::Verbose, cycleCount, pc, opcode, TraceEvent::Execute);
+    CHIP8_PROFILE_RECORD(profiling, CodeChanged(pc, Classify(opcode))); // not from a block, so the profiler hasnt seen this code yet
+    CHIP8_PROFILE_RECORD(profiling, Execute(pc));
+    ++cycleCount;
+
     // increment the pc before we execute anything
     pc += 2;
 
+    Execute();
+
+    // the timers are not touched here, they count down at 60hz no matter how fast instructions run, see TickTimers and Scheduler
+}
+
+// called 60 times per emulated second
+void Chip8::TickTimers()
+{
+    CHIP8_TRACE_RECORD(trace.get(), TraceLevel::Debug, cycleCount, pc, 0, TraceEvent::TimerTick, delayTimer, soundTimer);
+    CHIP8_PROFILE_RECORD(profiling, Frame(cycleCount));
+
+    // decrement the delay timer if its been set
+    if (delayTimer > 0)
+    {
+        --delayTimer;
+    }
+
+    // decrement the sound timer if its been set
+    if (soundTimer > 0)
+    {
+        --soundTimer;
+    }
+}
+
+bool Chip8::SoundActive() const
+{
+    return soundTimer > 0;
+}
+
+uint64_t Chip8::CycleCount() const
+{
+    return cycleCount;
+}
+
+// xorshift32 gets stuck at 0 and is slow to get going from a seed with only a few bits set (1, 2, 3...),
+// so the seed is mixed first (the murmur3 finalizer) and a seed that mixes to 0 gets a fixed state instead
+uint32_t Chip8::SeedState(uint32_t seed)
+{
+    seed ^= seed >> 16;
+    seed *= 0x85EBCA6Bu;
+    seed ^= seed >> 13;
+    seed *= 0xC2B2AE35u;
+    seed ^= seed >> 16;
+
+    return (seed != 0) ? seed : 0x6D2B79F5u;
+}
+
+void Chip8::Seed(uint32_t seed)
+{
+    rngState = SeedState(seed);
+}
+
+// Marsaglias xorshift32, the top byte is used because the high bits are the best mixed
+uint8_t Chip8::RandomByte(uint32_t& state)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return static_cast<uint8_t>(state >> 24);
+}
+
+void Chip8::Save(SaveState& state) const
+{
+    std::memcpy(state.magic, "C8SS", 4);
+    state.version = SaveState::VERSION;
+    state.size = sizeof(SaveState);
+    state.reserved0 = 0;
+    state.cycleCount = cycleCount;
+    std::memcpy(state.video, video, sizeof(video));
+    std::memcpy(state.memory, memory, sizeof(memory));
+    std::memcpy(state.registers, registers, sizeof(registers));
+    std::memcpy(state.stack, stack, sizeof(stack));
+    state.index = index;
+    state.pc = pc;
+    state.sp = sp;
+    state.delayTimer = delayTimer;
+    state.soundTimer = soundTimer;
+    state.reserved1 = 0;
+
+    state.rngState = rngState;
+
+    std::memcpy(state.keypad, keypad, sizeof(keypad));
+    state.reserved2 = 0;
+}
+
+bool Chip8::Restore(SaveState const& state)
+{
+    if (std::memcmp(state.magic, "C8SS", 4) != 0 || state.version != SaveState::VERSION || state.size != sizeof(SaveState) || state.rngState == 0)
+    {
+        return false;
+    }
+
+    // the one field a damaged or hand made file can put out of bounds before a single instruction runs, the first 2nnn writes stack[sp]
+    // pc and I are left alone, 1FFF and Fx1E already take them to the end of memory and past it in a normal run, so Save has to round trip them
+    if (state.sp > STACK_LEVELS)
+    {
+        return false;
+    }
+
+    CHIP8_PROFILE_RECORD(profiling, Jump(cycleCount, state.cycleCount));
+    cycleCount = state.cycleCount;
+    std::memcpy(video, state.video, sizeof(video));
+    std::memcpy(memory, state.memory, sizeof(memory));
+    std::memcpy(registers, state.registers, sizeof(registers));
+    std::memcpy(stack, state.stack, sizeof(stack));
+    index = state.index;
+    pc = state.pc;
+    sp = state.sp;
+    delayTimer = state.delayTimer;
+    soundTimer = state.soundTimer;
+    rngState = state.rngState;
+    std::memcpy(keypad, state.keypad, sizeof(keypad));
+
+    // all of memory just changed under any cached code, and the whole screen needs showing again
+    CodeWritten(0, MEMORY_SIZE);
+    dirty = true;
+    return true;
+}
+
+void Chip8::SetTraceLevel(TraceLevel level)
+{
+#ifdef CHIP8_TRACE
+    if (!trace && level != TraceLevel::Off)
+    {
+        trace = std::make_unique<Trace>(); // the ring buffer is only allocated once someone wants it
+    }
+
+    if (trace)
+    {
+        trace->SetLevel(level);
+    }
+#else
+    (void)level;
+#endif
+}
+
+Trace const* Chip8::GetTrace() const
+{
+    return trace.get();
+}
+
+void Chip8::SetProfiling(bool on)
+{
+#ifdef CHIP8_PROFILE
+    if (!profiler && on)
+    {
+        profiler = std::make_unique<Profiler>();
+    }
+
+    if (on && !profiling)
+    {
+        profiler->Jump(cycleCount, cycleCount); // instructions run while it was off dont belong to any call path
+    }
+
+    if (on && !blockCache)
+    {
+        blockCache = std::make_unique<BlockCache>();
+    }
+
+    profiling = on ? profiler.get() : nullptr;
+
+    if (blockCache)
+    {
+        blockCache->SetProfiler(profiling);
+    }
+#else
+    (void)on;
+#endif
+}
+
+Profiler const* Chip8::GetProfiler() const
+{
+    return profiler.get();
+}
+
+bool Chip8::WriteProfile(char const* pathPrefix)
+{
+    static_assert(HANDLER_COUNT <= Profiler::FAMILY_COUNT, "the profiler needs a counter for every handler");
+
+    if (!profiler)
+    {
+        return false;
+    }
+
+    if (blockCache)
+    {
+        blockCache->FlushProfile();
+    }
+
+    std::ofstream json(std::string(pathPrefix) + ".json");
+    profiler->WriteJson(json, handlerNames, HANDLER_COUNT);
+
+    std::ofstream collapsed(std::string(pathPrefix) + ".folded");
+    profiler->WriteCollapsed(collapsed, cycleCount);
+
+    return json.good() && collapsed.good();
+}
+
+void Chip8::SetExecMode(ExecMode mode)
+{
+    if (mode == ExecMode::Jit && !Jit::Supported())
+    {
+        mode = ExecMode::BlockCache;
+    }
+
+    execMode = mode;
+
+    if (mode == ExecMode::BlockCache && !blockCache)
+    {
+        blockCache = std::make_unique<BlockCache>();
+    }
+
+    if (mode == ExecMode::Jit && !jit)
+    {
+        jit = std::make_unique<Jit>();
+    }
+}
+
+void Chip8::SetAotProgram(AotProgram const* program)
+{
+    aot.reset();
+
+    if (program)
+    {
+        aot = std::make_unique<Aot>(*program);
+        aot->Invalidate(memory, 0, MEMORY_SIZE); // checks every block against what is loaded now
+    }
+}
+
+// the quirks are settled when an instruction is decoded: the tables and specialized[] Cycle goes through get the right instantiations here, and the predecoded
+// entries, blocks and jit translations decoded under the old quirks are all dropped so they get decoded again through Specialize
+void Chip8::SetQuirks(Quirks value)
+{
+    quirks = value;
+
+    table[0xB] = quirks.jumpVx ? &Chip8::OP_Bnnn<true> : &Chip8::OP_Bnnn<false>;
+    table[0xD] = quirks.wrapSprites ? &Chip8::OP_Dxyn<true> : &Chip8::OP_Dxyn<false>;
+    table8[0x6] = quirks.shiftVy ? &Chip8::OP_8xy6<true> : &Chip8::OP_8xy6<false>;
+    table8[0xE] = quirks.shiftVy ? &Chip8::OP_8xyE<true> : &Chip8::OP_8xyE<false>;
+    tableF[0x55] = quirks.indexAdvances ? &Chip8::OP_Fx55<true> : &Chip8::OP_Fx55<false>;
+    tableF[0x65] = quirks.indexAdvances ? &Chip8::OP_Fx65<true> : &Chip8::OP_Fx65<false>;
+
+    for (size_t i = 0; i < HANDLER_COUNT; ++i)
+    {
+        specialized[i] = Specialize(static_cast<Handler>(i));
+    }
+
+    CodeWritten(0, MEMORY_SIZE);
+}
+
+Quirks Chip8::GetQuirks() const
+{
+    return quirks;
+}
+
+// runs a batch of instructions, the block cache gives the exact same results as calling Cycle that many times, just faster
+void Chip8::Run(unsigned int cycles)
+{
+    if (execMode == ExecMode::BlockCache || profiling)
+    {
+        blockCache->Run(*this, cycles);
+        return;
+    }
+
+    if (execMode == ExecMode::Jit)
+    {
+        jit->Run(*this, cycles);
+        return;
+    }
+
+    if (execMode == ExecMode::Native && aot)
+    {
+        aot->Run(*this, cycles);
+        return;
+    }
+
+    Interpret(cycles);
+}
+
+// the three dispatch builds (CHIP8_DISPATCH in cmake) all decode exactly like the tables do and end up in the same OP_ handlers,
+// only the way they get there changes
+//     table   member function pointers, Cycle walks table[] and Table0/Table8/TableE/TableF, Interpret makes one call through handlers[]
+//     switch  switches instead, the compiler turns them into jump tables and can inline the handlers. Cycle classifies the opcode and
+//             runs the instantiation specialized[] holds for it, the same handler Interpret runs, so no handler is chosen by a quirk test
+//     goto    the switches for Cycle, and a threaded Interpret where every handler jumps straight to the next instructions handler
+#if defined(CHIP8_DISPATCH_SWITCH) || defined(CHIP8_DISPATCH_GOTO)
+
+void Chip8::Execute()
+{
+    Dispatch(specialized[Classify(instruction.opcode)]);
+}
+
+void Chip8::Dispatch(Handler handler)
+{
+    switch (handler)
+    {
+        case HANDLER_00E0: OP_00E0(); break;
+        case HANDLER_00EE: OP_00EE(); break;
+        case HANDLER_1nnn: OP_1nnn(); break;
+        case HANDLER_2nnn: OP_2nnn(); break;
+        case HANDLER_3xkk: OP_3xkk(); break;
+        case HANDLER_4xkk: OP_4xkk(); break;
+        case HANDLER_5xy0: OP_5xy0(); break;
+        case HANDLER_6xkk: OP_6xkk(); break;
+        case HANDLER_7xkk: OP_7xkk(); break;
+        case HANDLER_8xy0: OP_8xy0(); break;
+        case HANDLER_8xy1: OP_8xy1(); break;
+        case HANDLER_8xy2: OP_8xy2(); break;
+        case HANDLER_8xy3: OP_8xy3(); break;
+        case HANDLER_8xy4: OP_8xy4(); break;
+        case HANDLER_8xy5: OP_8xy5(); break;
+        case HANDLER_8xy6: OP_8xy6<false>(); break;
+        case HANDLER_8xy7: OP_8xy7(); break;
+        case HANDLER_8xyE: OP_8xyE<false>(); break;
+        case HANDLER_9xy0: OP_9xy0(); break;
+        case HANDLER_Annn: OP_Annn(); break;
+        case HANDLER_Bnnn: OP_Bnnn<false>(); break;
+        case HANDLER_Cxkk: OP_Cxkk(); break;
+        case HANDLER_Dxyn: OP_Dxyn<false>(); break;
+        case HANDLER_Ex9E: OP_Ex9E(); break;
+        case HANDLER_ExA1: OP_ExA1(); break;
+        case HANDLER_Fx07: OP_Fx07(); break;
+        case HANDLER_Fx0A: OP_Fx0A(); break;
+        case HANDLER_Fx15: OP_Fx15(); break;
+        case HANDLER_Fx18: OP_Fx18(); break;
+        case HANDLER_Fx1E: OP_Fx1E(); break;
+        case HANDLER_Fx29: OP_Fx29(); break;
+        case HANDLER_Fx33: OP_Fx33(); break;
+        case HANDLER_Fx55: OP_Fx55<false>(); break;
+        case HANDLER_Fx65: OP_Fx65<false>(); break;
+        case HANDLER_8xy6_VY: OP_8xy6<true>(); break;
+        case HANDLER_8xyE_VY: OP_8xyE<true>(); break;
+        case HANDLER_Fx55_ADVANCE: OP_Fx55<true>(); break;
+        case HANDLER_Fx65_ADVANCE: OP_Fx65<true>(); break;
+        case HANDLER_Bxnn: OP_Bnnn<true>(); break;
+        case HANDLER_Dxyn_WRAP: OP_Dxyn<true>(); break;
+        default: OP_NULL(); break;
+    }
+}
+
+#else
+
+void Chip8::Execute()
+{
     // decodes the first nibble of opcode, finds the corresponding function pointer in the table array, calls that function
-    (this->*(table[(opcode & 0xF000u) >> 12u]))();
+    (this->*(table[instruction.opcode >> 12u]))();
     // opcode...12u extracting and shifting the its to turn it into a number
     // index into the function pointer table with this[op..12u]  
     // ((*this...)) syntax for calling a member function using a pointer to it
         // this is a pointer to the current chip8 object
         // dot operator is used to access a member
         // * is used to dereference the function pointer that was retrieved from the table, dereference to get the actual function not just the mem location
-    
+}
 
-    // decrement the delay timer if its been set
-    if (delayTimer > 0)
+void Chip8::Dispatch(Handler handler)
+{
+    (this->*(handlers[handler]))();
+}
+
+#endif
+
+#ifdef CHIP8_DISPATCH_GOTO
+
+// fetch the next instruction from predecoded and jump straight to its handler, every handler ends in one of these instead of going
+// back round a loop, so each handler has its own indirect jump and the branch predictor gets to learn which handler usually follows which
+#define CHIP8_NEXT()                                                                                            \
+    do                                                                                                          \
+    {                                                                                                           \
+        if (cycles-- == 0)                                                                                      \
+        {                                                                                                       \
+            return;                                                                                             \
+        }                                                                                                       \
+        if (__builtin_expect((pc & 1u) || pc >= MEMORY_SIZE - 1, 0))                                            \
+        {                                                                                                       \
+            goto slow;                                                                                          \
+        }                                                                                                       \
+        entry = &decoded[pc >> 1u];                                                                             \
+        if (__builtin_expect(entry->handler == HANDLER_UNDECODED, 0))                                           \
+        {                                                                                                       \
+            Predecode(*entry, pc);                                                                              \
+        }                                                                                                       \
+        instruction = entry->instruction;                                                                       \
+        CHIP8_TRACE_RECORD(trace.get(), TraceLevel::Verbose, cycleCount, pc, instruction.opcode, TraceEvent::Execute); \
+        ++cycleCount;                                                                                           \
+        pc += 2;                                                                                                \
+        goto *labels[entry->handler];                                                                           \
+    } while (0)
+
+void Chip8::Interpret(unsigned int cycles)
+{
+    static void* const labels[HANDLER_COUNT] =
     {
-        --delayTimer;
+        &&opNull, // HANDLER_UNDECODED, never jumped to because entries are decoded first
+        &&opNull,
+        &&op00E0, &&op00EE, &&op1nnn, &&op2nnn, &&op3xkk, &&op4xkk, &&op5xy0, &&op6xkk, &&op7xkk,
+        &&op8xy0, &&op8xy1, &&op8xy2, &&op8xy3, &&op8xy4, &&op8xy5, &&op8xy6, &&op8xy7, &&op8xyE,
+        &&op9xy0, &&opAnnn, &&opBnnn, &&opCxkk, &&opDxyn, &&opEx9E, &&opExA1,
+        &&opFx07, &&opFx0A, &&opFx15, &&opFx18, &&opFx1E, &&opFx29, &&opFx33, &&opFx55, &&opFx65,
+        &&op8xy6Vy, &&op8xyEVy, &&opFx55Advance, &&opFx65Advance, &&opBxnn, &&opDxynWrap,
+    };
+
+    if (!predecoded)
+    {
+        predecoded = std::make_unique<Predecoded[]>(MEMORY_SIZE / 2); // value initialized, every entry starts out HANDLER_UNDECODED
     }
 
-    // decrement the sound timer if its been set
-    if (soundTimer > 0)
+    Predecoded* decoded = predecoded.get();
+    Predecoded* entry;
+
+    CHIP8_NEXT();
+
+slow:   Cycle(); CHIP8_NEXT(); // odd addresses have no entry, see the table and switch Interpret
+
+opNull: OP_NULL(); CHIP8_NEXT();
+op00E0: OP_00E0(); CHIP8_NEXT();
+op00EE: OP_00EE(); CHIP8_NEXT();
+op1nnn: OP_1nnn(); CHIP8_NEXT();
+op2nnn: OP_2nnn(); CHIP8_NEXT();
+op3xkk: OP_3xkk(); CHIP8_NEXT();
+op4xkk: OP_4xkk(); CHIP8_NEXT();
+op5xy0: OP_5xy0(); CHIP8_NEXT();
+op6xkk: OP_6xkk(); CHIP8_NEXT();
+op7xkk: OP_7xkk(); CHIP8_NEXT();
+op8xy0: OP_8xy0(); CHIP8_NEXT();
+op8xy1: OP_8xy1(); CHIP8_NEXT();
+op8xy2: OP_8xy2(); CHIP8_NEXT();
+op8xy3: OP_8xy3(); CHIP8_NEXT();
+op8xy4: OP_8xy4(); CHIP8_NEXT();
+op8xy5: OP_8xy5(); CHIP8_NEXT();
+op8xy6: OP_8xy6<false>(); CHIP8_NEXT();
+op8xy7: OP_8xy7(); CHIP8_NEXT();
+op8xyE: OP_8xyE<false>(); CHIP8_NEXT();
+op9xy0: OP_9xy0(); CHIP8_NEXT();
+opAnnn: OP_Annn(); CHIP8_NEXT();
+opBnnn: OP_Bnnn<false>(); CHIP8_NEXT();
+opCxkk: OP_Cxkk(); CHIP8_NEXT();
+opDxyn: OP_Dxyn<false>(); CHIP8_NEXT();
+opEx9E: OP_Ex9E(); CHIP8_NEXT();
+opExA1: OP_ExA1(); CHIP8_NEXT();
+opFx07: OP_Fx07(); CHIP8_NEXT();
+opFx0A: OP_Fx0A(); CHIP8_NEXT();
+opFx15: OP_Fx15(); CHIP8_NEXT();
+opFx18: OP_Fx18(); CHIP8_NEXT();
+opFx1E: OP_Fx1E(); CHIP8_NEXT();
+opFx29: OP_Fx29(); CHIP8_NEXT();
+opFx33: OP_Fx33(); CHIP8_NEXT();
+opFx55: OP_Fx55<false>(); CHIP8_NEXT();
+opFx65: OP_Fx65<false>(); CHIP8_NEXT();
+op8xy6Vy: OP_8xy6<true>(); CHIP8_NEXT();
+op8xyEVy: OP_8xyE<true>(); CHIP8_NEXT();
+opFx55Advance: OP_Fx55<true>(); CHIP8_NEXT();
+opFx65Advance: OP_Fx65<true>(); CHIP8_NEXT();
+opBxnn: OP_Bnnn<true>(); CHIP8_NEXT();
+opDxynWrap: OP_Dxyn<true>(); CHIP8_NEXT();
+}
+
+#undef CHIP8_NEXT
+
+#else
+
+// runs from predecoded, so after the first pass over some code there is no fetch, no table walk and no operand masking left,
+// just a copy of the ready made Instruction and one dispatch on its handler number
+void Chip8::Interpret(unsigned int cycles)
+{
+    if (!predecoded)
     {
-        --soundTimer;
+        predecoded = std::make_unique<Predecoded[]>(MEMORY_SIZE / 2); // value initialized, every entry starts out HANDLER_UNDECODED
+    }
+
+    Predecoded* decoded = predecoded.get();
+
+    for (unsigned int i = 0; i < cycles; ++i)
+    {
+        // only even addresses have an entry, a jump to an odd one (or running into the last byte of memory) takes the ordinary path
+        if ((pc & 1u) || pc >= MEMORY_SIZE - 1)
+        {
+            Cycle();
+            continue;
+        }
+
+        Predecoded& entry = decoded[pc >> 1u];
+        if (entry.handler == HANDLER_UNDECODED)
+        {
+            Predecode(entry, pc);
+        }
+
+        instruction = entry.instruction;
+        CHIP8_TRACE_RECORD(trace.get(), TraceLevel::Verbose, cycleCount, pc, instruction.opcode, TraceEvent::Execute);
+        ++cycleCount;
+        pc += 2;
+        Dispatch(entry.handler);
+    }
+}
+
+#endif
+
+Chip8::Instruction Chip8::Split(uint16_t opcode)
+{
+    Instruction split;
+    split.opcode = opcode;
+    split.nnn = opcode & 0x0FFFu;
+    split.x = (opcode & 0x0F00u) >> 8u;
+    split.y = (opcode & 0x00F0u) >> 4u;
+    split.kk = opcode & 0x00FFu;
+    split.n = opcode & 0x000Fu;
+    return split;
+}
+
+// has to agree with table[] -> Table0/Table8/TableE/TableF, anything the tables send to OP_NULL is HANDLER_NULL here
+Chip8::Handler Chip8::Classify(uint16_t opcode)
+{
+    switch (opcode >> 12u)
+    {
+        case 0x0:
+        {
+            switch (opcode & 0x000Fu)
+            {
+                case 0x0: return HANDLER_00E0;
+                case 0xE: return HANDLER_00EE;
+                default: return HANDLER_NULL;
+            }
+        }
+
+        case 0x1: return HANDLER_1nnn;
+        case 0x2: return HANDLER_2nnn;
+        case 0x3: return HANDLER_3xkk;
+        case 0x4: return HANDLER_4xkk;
+        case 0x5: return HANDLER_5xy0;
+        case 0x6: return HANDLER_6xkk;
+        case 0x7: return HANDLER_7xkk;
+
+        case 0x8:
+        {
+            switch (opcode & 0x000Fu)
+            {
+                case 0x0: return HANDLER_8xy0;
+                case 0x1: return HANDLER_8xy1;
+                case 0x2: return HANDLER_8xy2;
+                case 0x3: return HANDLER_8xy3;
+                case 0x4: return HANDLER_8xy4;
+                case 0x5: return HANDLER_8xy5;
+                case 0x6: return HANDLER_8xy6;
+                case 0x7: return HANDLER_8xy7;
+                case 0xE: return HANDLER_8xyE;
+                default: return HANDLER_NULL;
+            }
+        }
+
+        case 0x9: return HANDLER_9xy0;
+        case 0xA: return HANDLER_Annn;
+        case 0xB: return HANDLER_Bnnn;
+        case 0xC: return HANDLER_Cxkk;
+        case 0xD: return HANDLER_Dxyn;
+
+        case 0xE:
+        {
+            switch (opcode & 0x000Fu)
+            {
+                case 0x1: return HANDLER_ExA1;
+                case 0xE: return HANDLER_Ex9E;
+                default: return HANDLER_NULL;
+            }
+        }
+
+        default:
+        {
+            switch (opcode & 0x00FFu)
+            {
+                case 0x07: return HANDLER_Fx07;
+                case 0x0A: return HANDLER_Fx0A;
+                case 0x15: return HANDLER_Fx15;
+                case 0x18: return HANDLER_Fx18;
+                case 0x1E: return HANDLER_Fx1E;
+                case 0x29: return HANDLER_Fx29;
+                case 0x33: return HANDLER_Fx33;
+                case 0x55: return HANDLER_Fx55;
+                case 0x65: return HANDLER_Fx65;
+                default: return HANDLER_NULL;
+            }
+        }
     }
+}
+
+// in the same order as Handler
+Chip8::Chip8Func const Chip8::handlers[HANDLER_COUNT] =
+{
+    &Chip8::OP_NULL, // HANDLER_UNDECODED, never called because entries are decoded first
+    &Chip8::OP_NULL,
+    &Chip8::OP_00E0, &Chip8::OP_00EE, &Chip8::OP_1nnn, &Chip8::OP_2nnn, &Chip8::OP_3xkk, &Chip8::OP_4xkk, &Chip8::OP_5xy0, &Chip8::OP_6xkk, &Chip8::OP_7xkk,
+    &Chip8::OP_8xy0, &Chip8::OP_8xy1, &Chip8::OP_8xy2, &Chip8::OP_8xy3, &Chip8::OP_8xy4, &Chip8::OP_8xy5, &Chip8::OP_8xy6<false>, &Chip8::OP_8xy7, &Chip8::OP_8xyE<false>,
+    &Chip8::OP_9xy0, &Chip8::OP_Annn, &Chip8::OP_Bnnn<false>, &Chip8::OP_Cxkk, &Chip8::OP_Dxyn<false>, &Chip8::OP_Ex9E, &Chip8::OP_ExA1,
+    &Chip8::OP_Fx07, &Chip8::OP_Fx0A, &Chip8::OP_Fx15, &Chip8::OP_Fx18, &Chip8::OP_Fx1E, &Chip8::OP_Fx29, &Chip8::OP_Fx33, &Chip8::OP_Fx55<false>, &Chip8::OP_Fx65<false>,
+    &Chip8::OP_8xy6<true>, &Chip8::OP_8xyE<true>, &Chip8::OP_Fx55<true>, &Chip8::OP_Fx65<true>, &Chip8::OP_Bnnn<true>, &Chip8::OP_Dxyn<true>,
+};
 
+char const* const Chip8::handlerNames[HANDLER_COUNT] =
+{
+    "undecoded", "NULL",
+    "00E0", "00EE", "1nnn", "2nnn", "3xkk", "4xkk", "5xy0", "6xkk", "7xkk",
+    "8xy0", "8xy1", "8xy2", "8xy3", "8xy4", "8xy5", "8xy6", "8xy7", "8xyE",
+    "9xy0", "Annn", "Bnnn", "Cxkk", "Dxyn", "Ex9E", "ExA1",
+    "Fx07", "Fx0A", "Fx15", "Fx18", "Fx1E", "Fx29", "Fx33", "Fx55", "Fx65",
+    "8xy6", "8xyE", "Fx55", "Fx65", "Bnnn", "Dxyn", // never reported, the profiler counts by Classify which knows no quirks
+};
+
+// the final handler for an opcode, so a decoded instruction can later be called with a single indirect call
+Chip8::Chip8Func Chip8::Decode(uint16_t opcode) const
+{
+    return handlers[specialized[Classify(opcode)]];
+}
+
+Chip8::Handler Chip8::Specialize(Handler handler) const
+{
+    switch (handler)
+    {
+        case HANDLER_8xy6: return quirks.shiftVy ? HANDLER_8xy6_VY : handler;
+        case HANDLER_8xyE: return quirks.shiftVy ? HANDLER_8xyE_VY : handler;
+        case HANDLER_Fx55: return quirks.indexAdvances ? HANDLER_Fx55_ADVANCE : handler;
+        case HANDLER_Fx65: return quirks.indexAdvances ? HANDLER_Fx65_ADVANCE : handler;
+        case HANDLER_Bnnn: return quirks.jumpVx ? HANDLER_Bxnn : handler;
+        case HANDLER_Dxyn: return quirks.wrapSprites ? HANDLER_Dxyn_WRAP : handler;
+        default: return handler;
+    }
+}
+
+void Chip8::Predecode(Predecoded& entry, uint16_t address) const
+{
+    uint16_t opcode = (memory[address] << 8u) | memory[address + 1];
+    entry.instruction = Split(opcode);
+    entry.handler = specialized[Classify(opcode)];
+}
+
+// any write into memory might be overwriting code that has already been decoded, so the cached copy has to go
+void Chip8::CodeWritten(uint16_t address, uint16_t length)
+{
+    if (blockCache)
+    {
+        blockCache->Invalidate(address, length);
+    }
+
+    if (jit)
+    {
+        jit->Invalidate(address, length);
+    }
+
+    if (aot)
+    {
+        aot->Invalidate(memory, address, length);
+    }
+
+    if (predecoded)
+    {
+        // each byte belongs to exactly one entry, the one for its even address, so only the entries under the write are decoded again
+        unsigned int end = std::min<unsigned int>(address + length, MEMORY_SIZE);
+        for (unsigned int i = address >> 1u; i < (end + 1u) >> 1u; ++i)
+        {
+            predecoded[i].handler = HANDLER_UNDECODED;
+        }
+    }
 }
 
 
@@ -188,7 +863,7 @@ void Chip8::Cycle()
 // Table0 through OP_NULL are member functions
 void Chip8::Table0() // function parameter list is empty ()
 {
-(this ->*table0[opcode & 0x000Fu])(); // removed *this
+(this ->*table0[instruction.n])(); // removed *this
 // {this} is a key word in c++, it is a pointer that holds the memory locatoin of the current object on which the function was called
 // {*this} is dereferencing the this pointer to access the object at the {this} memory location
 // {.} is the dot operator used to access the membership of an object, 
@@ -203,22 +878,28 @@ void Chip8::Table0() // function parameter list is empty ()
 
 void Chip8::Table8()
 {
-    (this->*(table8[opcode & 0x000Fu]))();
+    (this->*(table8[instruction.n]))();
     // this->* is the pointer to member function syntax, 
 }
 
 void Chip8::TableE()
 {
-    (this->*(tableE[opcode & 0x00FFu]))();
+    (this->*(tableE[instruction.n]))(); // tableE is filled by the last nibble (0xA1 -> 0x1, 0x9E -> 0xE), indexing it with the whole last byte read past the end of the array
 }
 
 void Chip8::TableF()
 {
-    (this->*(tableF[opcode & 0x00FFu]))();
+    if (instruction.kk <= 0x65) // tableF only goes up to 0x65, anything past that is not an instruction
+    {
+        (this->*(tableF[instruction.kk]))();
+    }
 }
 
+// pc has already moved past the instruction, so the address it came from is pc - 2
 void Chip8::OP_NULL()
-{}
+{
+    CHIP8_TRACE_RECORD(trace.get(), TraceLevel::Error, cycleCount, pc - 2, instruction.opcode, TraceEvent::BadOpcode);
+}
 
 
 
@@ -228,11 +909,16 @@ void Chip8::OP_NULL()
 void Chip8::OP_00E0()
 {
     memset(video, 0, sizeof(video));
+    dirty = true;
+
+    CHIP8_TRACE_RECORD(trace.get(), TraceLevel::Info, cycleCount, pc - 2, instruction.opcode, TraceEvent::Clear);
 }
 
 // RET decrement stack pointer by one, set pc to return adress pushed onto stack before subrutine was called
 void Chip8::OP_00EE()
 {
+    CHIP8_PROFILE_RECORD(profiling, Return(cycleCount));
+
     --sp; // move stack pointer back to last saved spot
     pc = stack[sp]; // resotre the program counter from the stack, return to mem location before a jump to a subroutine
 }
@@ -240,14 +926,16 @@ void Chip8::OP_00EE()
 //jump to location nnn in memory and continue forward without saving original place
 void Chip8::OP_1nnn()
 {
-    uint16_t address = opcode & 0x0FFFu; // & operator is helping us return the last 12 bits by masking the first 4 digits with 0, FFF show the last 12 digits
+    uint16_t address = instruction.nnn; // & operator is helping us return the last 12 bits by masking the first 4 digits with 0, FFF show the last 12 digits
     pc = address;
 }
 
 // call a subroutine, execute it, return to the next instruction after that call by checking the top of the stack 
 void Chip8::OP_2nnn()
 {
-    uint16_t address = opcode & 0x0FFFu; // mask the fist 4 digits 
+    uint16_t address = instruction.nnn; // mask the fist 4 digits 
+
+    CHIP8_PROFILE_RECORD(profiling, Call(cycleCount, address));
 
     stack[sp] = pc; // save current location to stack
     ++sp; // increment stack pointer to prep for next save
@@ -258,8 +946,8 @@ void Chip8::OP_2nnn()
 // its like an if else statement, if the condition is true, skip the next instruction and execute the one after, if it is false, execute the next instruction
 void Chip8::OP_3xkk()
 {
-    uint8_t Vx = (opcode & 0xF00u) >> 8u; // gives us the value of a given register, it shows the second nibble of 16bit instruction, if opcode was 0x3A1F it would return 0x0A00
-    uint8_t byte = opcode & 0x00FFu; // mask gives us the last byte, bits 0-7 which show a number
+    uint8_t Vx = instruction.x; // gives us the value of a given register, it is the second nibble of 16bit instruction, if opcode was 0x3A1F it would be 0xA
+    uint8_t byte = instruction.kk; // mask gives us the last byte, bits 0-7 which show a number
 
     if (registers[Vx] == byte) // compare the number in register[Vx] with the byte number, if its the same increment pc by 2
     {
@@ -270,8 +958,8 @@ void Chip8::OP_3xkk()
 
 void Chip8::OP_4xkk()
 {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-    uint8_t byte = opcode & 0x00FFU;
+    uint8_t Vx = instruction.x;
+    uint8_t byte = instruction.kk;
 
     if (registers[Vx] != byte) // similar to above, but only runs if the numbet in the register is not the same as the nubmer we check
     {
@@ -282,8 +970,8 @@ void Chip8::OP_4xkk()
 // if two registers are equal, then we skip the next task
 void Chip8::OP_5xy0()
 {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-    uint8_t Vy = (opcode & 0x00F0u) >> 4u;
+    uint8_t Vx = instruction.x;
+    uint8_t Vy = instruction.y;
 
     if (registers[Vx] == registers[Vy])
     {
@@ -294,8 +982,8 @@ void Chip8::OP_5xy0()
 // register a register to a specific byte
 void Chip8::OP_6xkk()
 {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-    uint8_t byte = opcode & 0x0FFu;
+    uint8_t Vx = instruction.x;
+    uint8_t byte = instruction.kk;
 
     registers[Vx] = byte;
 }
@@ -303,8 +991,8 @@ void Chip8::OP_6xkk()
 // increase a counter stored in a register by a value
 void Chip8::OP_7xkk()
 {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-    uint8_t byte = opcode & 0x00FFu;
+    uint8_t Vx = instruction.x;
+    uint8_t byte = instruction.kk;
 
     registers[Vx] += byte;
 }
@@ -313,8 +1001,8 @@ void Chip8::OP_7xkk()
 // replace one register value with another
 void Chip8::OP_8xy0()
 {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-    uint8_t Vy = (opcode & 0x00F0u) >> 4u;
+    uint8_t Vx = instruction.x;
+    uint8_t Vy = instruction.y;
 
     registers[Vx] = registers[Vy];
 }
@@ -323,8 +1011,8 @@ void Chip8::OP_8xy0()
 // usecase could be for flags like if a byte represented powerups and each bit was on or off for a specific powerup, like 00101, the 1s are the powerups you have and 0s you could have but dont
 void Chip8::OP_8xy1()
 {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-    uint8_t Vy = (opcode & 0x00F0u) >> 4u;
+    uint8_t Vx = instruction.x;
+    uint8_t Vy = instruction.y;
 
     registers[Vx] |= registers[Vy];
 }
@@ -333,8 +1021,8 @@ void Chip8::OP_8xy1()
 // so an initial flag could be 0b00000111, and lag_A could be 0b00000001, call the flag to get 0b00000110 as the value
 void Chip8::OP_8xy2()
 {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-    uint8_t Vy = (opcode & 0x00F0u) >> 4u;
+    uint8_t Vx = instruction.x;
+    uint8_t Vy = instruction.y;
 
     registers[Vx] &= registers[Vy];
 }
@@ -342,8 +1030,8 @@ void Chip8::OP_8xy2()
 // XOR operator to toggle on and off the bit
 void Chip8::OP_8xy3()
 {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-    uint8_t Vy = (opcode & 0x00F0u) >> 4u;
+    uint8_t Vx = instruction.x;
+    uint8_t Vy = instruction.y;
 
     registers[Vx] ^= registers[Vy];
 }
@@ -351,8 +1039,8 @@ void Chip8::OP_8xy3()
 // ADD with overflow, if the sum is greater than what can fit into a byte (255), register VF will be set to 1 as a flag
 void Chip8:: OP_8xy4()
 {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-    uint8_t Vy = (opcode & 0x00F0u) >> 4u;
+    uint8_t Vx = instruction.x;
+    uint8_t Vy = instruction.y;
 
     uint16_t sum = registers[Vx] + registers[Vy];
 
@@ -371,8 +1059,8 @@ void Chip8:: OP_8xy4()
 // if Vx > Vy, set flag register to 1, otherwise set to 0
 void Chip8::OP_8xy5()
 {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-    uint8_t Vy = (opcode & 0x00F0u) >> 4u;
+    uint8_t Vx = instruction.x;
+    uint8_t Vy = instruction.y;
 
     if (registers[Vx] > registers[Vy])
     {
@@ -387,9 +1075,15 @@ void Chip8::OP_8xy5()
 }
 
 // if the rightmost bit is 1, set VF to 1, otherwise set VF to 0, then Vx is divided by 2
+template <bool ShiftVy>
 void Chip8::OP_8xy6()
 {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+    uint8_t Vx = instruction.x;
+
+    if constexpr (ShiftVy)
+    {
+        registers[Vx] = registers[instruction.y]; // the VIP shifted Vy, from here on it is the same as shifting Vx in place
+    }
     
     // save lsb in Vf
     registers[0xF] = (registers[Vx] & 0x1u); // hexideciaml mask binary 00000001 to isolate the last bit
@@ -401,8 +1095,8 @@ void Chip8::OP_8xy6()
 // Vx = Vy - Vx, if Vy > Vx set VF to 1, else 0
 void Chip8::OP_8xy7()
 {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-    uint8_t Vy = (opcode & 0x00F0u) >> 4u;
+    uint8_t Vx = instruction.x;
+    uint8_t Vy = instruction.y;
 
     if (registers[Vy] > registers[Vx])
     {
@@ -418,9 +1112,15 @@ void Chip8::OP_8xy7()
 }
 
 // if the most significant bit of Vx is 1, set VF to 1, else 0. then Vx is multiplied by 2
+template <bool ShiftVy>
 void Chip8::OP_8xyE()
 {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+    uint8_t Vx = instruction.x;
+
+    if constexpr (ShiftVy)
+    {
+        registers[Vx] = registers[instruction.y];
+    }
 
     // save msb in VF
     registers[0xF] = (registers[Vx] & 0x80u) >> 7u;
@@ -431,8 +1131,8 @@ void Chip8::OP_8xyE()
 // skip next instructions if Vx != Vy
 void Chip8::OP_9xy0()
 {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-    uint8_t Vy = (opcode & 0x00F0u) >> 4u;
+    uint8_t Vx = instruction.x;
+    uint8_t Vy = instruction.y;
 
     if (registers[Vx] != registers[Vy])
     {
@@ -443,38 +1143,40 @@ void Chip8::OP_9xy0()
 // set I = nn
 void Chip8::OP_Annn()
 {
-    uint16_t address = opcode & 0x0FFFu;
+    uint16_t address = instruction.nnn;
 
     index = address; // index is a member of the chip8 class
 }
 
 // jump location nnn + V0
+template <bool JumpVx>
 void Chip8::OP_Bnnn()
 {
-    uint16_t address = opcode & 0x0FFFu;
+    uint16_t address = instruction.nnn;
 
-    pc = registers[0] + address;
+    pc = registers[JumpVx ? instruction.x : 0] + address; // SUPER-CHIP read Bxnn, x is the top nibble of the address as well
 }
 
 // generate a random number, preform a bitewise AND with a given number, store the result in Vx
 // this is controlled randomness
 void Chip8::OP_Cxkk()
 {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-    uint8_t byte = opcode & 0x00FFu;
+    uint8_t Vx = instruction.x;
+    uint8_t byte = instruction.kk;
 
-    registers[Vx] = randByte(randGen) & byte;
+    registers[Vx] = RandomByte(rngState) & byte;
 } 
 
-// iterate over sprite row by row column by column
-// check if screen location i
+// draw an 8 pixel wide sprite, each sprite row is one byte and each screen row is one 64 bit word
+// so a whole sprite row is drawn with one shift and one XOR, and collision is one AND
+template <bool Wrap>
 void Chip8::OP_Dxyn()
 {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u; // val stored in register Vx
-    uint8_t Vy = (opcode & 0x00F0u) >> 4u; // val stored in Vy
-    uint8_t height = opcode & 0x000Fu;
+    uint8_t Vx = instruction.x; // val stored in register Vx
+    uint8_t Vy = instruction.y; // val stored in Vy
+    uint8_t height = instruction.n;
 
-    std::cout << "Drawing sprite at position: (" << (int)registers[Vx] << "," << (int)registers[Vy] << ")\n";
+    CHIP8_TRACE_RECORD(trace.get(), TraceLevel::Info, cycleCount, pc - 2, instruction.opcode, TraceEvent::Draw, registers[Vx], registers[Vy], height);
 
     // these are the corrdiantes of where the sprite will be drawn on the screen, (wrapped around if they go off the screen)
     uint8_t xPos = registers[Vx] % VIDEO_WIDTH; // this is the x coordinate of the top left corner of the sprite
@@ -482,38 +1184,61 @@ void Chip8::OP_Dxyn()
 
     registers[0xF] = 0; // initialize flag register to 0
 
-    for (unsigned int row = 0; row < height; ++row) // iterate over each row of the sprite for the height of the sprite, each row is a string of pixels
+    // the start position wraps but the sprite itself is clipped, rows past the bottom and pixels past the right edge are not drawn.
+    // with Wrap they come back in at the top and on the left instead
+    unsigned int rows = (!Wrap && yPos + height > VIDEO_HEIGHT) ? VIDEO_HEIGHT - yPos : height;
+
+    for (unsigned int row = 0; row < rows; ++row) // iterate over each row of the sprite, each row is a string of pixels
     {
         uint8_t spriteByte = memory[index + row]; // memory address of the current row of sprite data
+        unsigned int y = Wrap ? (yPos + row) % VIDEO_HEIGHT : yPos + row;
 
-        for (unsigned int col = 0; col < 8; ++col) // 
+        // line up the sprite byte with column xPos, bit 63 is column 0 so the byte goes in the top 8 bits and slides right
+        // near the right edge the shift goes the other way and the pixels that would fall off the screen are dropped, or with Wrap it is
+        // a rotate and they land in the first columns
+        uint64_t spriteRow;
+        if constexpr (Wrap)
         {
-            uint8_t spritePixel = spriteByte & (0x80u >> col); // shift hex mask to position of current pixel within byte to isolate single bit which is 0 if off 1 if pixel is on
-            uint32_t* screenPixel = &video[(yPos + row) * VIDEO_WIDTH + (xPos + col)]; // screenPixel is a pointer to the memory location of where the current sprite pixel is, the one in the loop we are in
-            // {video} is a one dimensional member array where each element corresponds to a single pixel on the chip8s display
-            // {(yPos + row) * VIDEO_WIDTH + (xPos + col)} calculates the memory index where the screen pixel is equal to the sprite pixel
-            
-            // checks if the sprite pixel is on
-            if (spritePixel)
-            {
-                // if screen pixel at location we want to draw sprite is on, there is a collision 
-                if (*screenPixel == 0xFFFFFFFF)
-                {
-                    registers[0xF] = 1; // set the flag to one
-                }
-
-                // Effectively XOR with the sprite pixel
-                *screenPixel ^= 0xFFFFFFFF; // toggles the screen pixel if the sprite pixel is on
-            }
+            uint64_t placed = uint64_t(spriteByte) << (VIDEO_WIDTH - 8);
+            spriteRow = (xPos == 0) ? placed : (placed >> xPos) | (placed << (VIDEO_WIDTH - xPos));
+        }
+        else
+        {
+            spriteRow = (xPos <= VIDEO_WIDTH - 8) ? uint64_t(spriteByte) << (VIDEO_WIDTH - 8 - xPos)
+                                                  : uint64_t(spriteByte) >> (xPos - (VIDEO_WIDTH - 8));
+        }
 
+        // any sprite pixel landing on a pixel that is already on is a collision
+        if (video[y] & spriteRow)
+        {
+            registers[0xF] = 1; // set the flag to one
         }
+
+        video[y] ^= spriteRow; // toggles every screen pixel under an on sprite pixel
     }
+
+    CHIP8_PROFILE_RECORD(profiling, Draw(rows));
+
+    if (rows > 0)
+    {
+        dirty = true;
+    }
+}
+
+bool Chip8::IsDirty() const
+{
+    return dirty;
+}
+
+void Chip8::ClearDirty()
+{
+    dirty = false;
 }
 
 // skip the next instructions if the key with the value of Vx is pressed
 void Chip8::OP_Ex9E()
 {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+    uint8_t Vx = instruction.x;
 
     uint8_t key = registers[Vx];
 
@@ -526,7 +1251,7 @@ void Chip8::OP_Ex9E()
 // skip the next instruction if key with the value of Vx is NOT pressed
 void Chip8::OP_ExA1()
 {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+    uint8_t Vx = instruction.x;
 
     uint8_t key = registers[Vx];
 
@@ -539,7 +1264,7 @@ void Chip8::OP_ExA1()
 // set Vx = delay timer value
 void Chip8::OP_Fx07()
 {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+    uint8_t Vx = instruction.x;
 
     registers[Vx] = delayTimer;
 }
@@ -547,7 +1272,7 @@ void Chip8::OP_Fx07()
 // decrement pc by two to run the same instruction repeadedly
 void Chip8::OP_Fx0A()
 {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+    uint8_t Vx = instruction.x;
 
     if (keypad[0])
     {
@@ -618,7 +1343,7 @@ void Chip8::OP_Fx0A()
 // set delay timer = Vx
 void Chip8::OP_Fx15()
 {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+    uint8_t Vx = instruction.x;
 
     delayTimer = registers[Vx];
 }
@@ -626,7 +1351,7 @@ void Chip8::OP_Fx15()
 // set timer sound to Vx
 void Chip8::OP_Fx18()
 {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+    uint8_t Vx = instruction.x;
 
     soundTimer = registers[Vx];
 }
@@ -634,7 +1359,7 @@ void Chip8::OP_Fx18()
 // set I = I + Vx
 void Chip8::OP_Fx1E()
 {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+    uint8_t Vx = instruction.x;
 
     index += registers[Vx];
 }
@@ -642,7 +1367,7 @@ void Chip8::OP_Fx1E()
 // set I = location of sprite for digit Vx
 void Chip8::OP_Fx29()
 {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+    uint8_t Vx = instruction.x;
     uint8_t digit = registers[Vx];
 
     index = FONTSET_START_ADRESS + (5 * digit);
@@ -651,7 +1376,7 @@ void Chip8::OP_Fx29()
 // helps convert hexidecimal to decimal
 void Chip8::OP_Fx33()
 {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+    uint8_t Vx = instruction.x;
     uint8_t value = registers[Vx];
 
     //ones place
@@ -664,28 +1389,46 @@ void Chip8::OP_Fx33()
     // hundreds place
     value /= 10;
     memory[index] = value % 10;
+
+    CodeWritten(index, 3);
+    CHIP8_TRACE_RECORD(trace.get(), TraceLevel::Debug, cycleCount, pc - 2, instruction.opcode, TraceEvent::MemoryWrite, static_cast<uint8_t>(index >> 8), static_cast<uint8_t>(index), 3);
 }
 
 // store register V0 through Vx in memory starting at location I
+template <bool Advance>
 void Chip8::OP_Fx55()
 {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+    uint8_t Vx = instruction.x;
 
     for (uint8_t i = 0; i <= Vx; ++i)
     {
         memory[index + i] = registers[i];
     }
+
+    CodeWritten(index, Vx + 1);
+    CHIP8_TRACE_RECORD(trace.get(), TraceLevel::Debug, cycleCount, pc - 2, instruction.opcode, TraceEvent::MemoryWrite, static_cast<uint8_t>(index >> 8), static_cast<uint8_t>(index), Vx + 1);
+
+    if constexpr (Advance)
+    {
+        index += Vx + 1; // the VIP moved I along as it stored
+    }
 }
 
 // read register V0 through Vx from memory starting at location I
+template <bool Advance>
 void Chip8::OP_Fx65()
 {
-    uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+    uint8_t Vx = instruction.x;
 
     for (uint8_t i = 0; i <= Vx; ++i)
     {
         registers[i] = memory[index + i];
     }
+
+    if constexpr (Advance)
+    {
+        index += Vx + 1;
+    }
 }
 
 // Function Pointer Table
\ No newline at end of file
@@ -3,31 +3,169 @@
 #ifndef CHIP8_HPP
 #define CHIP8_HPP
 
+#include <cstddef>
 #include <cstdint>
-#include <random>
 #include <chrono>
-#include <random>
+#include <memory>
+#include "Trace.hpp"
+#include "Profiler.hpp"
 
 
 const unsigned int KEY_COUNT = 16;
 const unsigned int MEMORY_SIZE = 4096;
+const unsigned int MAX_ROM_SIZE = MEMORY_SIZE - 0x200; // roms are loaded at 0x200 and run up to the end of memory
 const unsigned int REGISTER_COUNT = 16;
 const unsigned int STACK_LEVELS = 16;
 const unsigned int VIDEO_HEIGHT = 32;
 const unsigned int VIDEO_WIDTH = 64;
 
+class Aot;
+class AotCompiler;
+struct AotProgram;
+class BlockCache;
+class Jit;
+struct SaveState;
+
+// computed goto is a GCC/Clang extension, anywhere else the goto build gets the switch instead
+#if defined(CHIP8_DISPATCH_GOTO) && !defined(__GNUC__)
+#undef CHIP8_DISPATCH_GOTO
+#define CHIP8_DISPATCH_SWITCH
+#endif
+
+// how Run executes instructions
+enum class ExecMode
+{
+	Interpreter, // same results as Cycle, but each instruction is only decoded once and then run from a predecoded copy
+	BlockCache,  // decode straight line runs of code once and replay them from a cache keyed by pc
+	Jit,         // translate hot code to native x86-64, falls back to BlockCache where the jit isnt built in
+	Native       // run the blocks chip8_aot compiled ahead of time for this rom (see Aot.hpp), the Interpreter until SetAotProgram
+};
+
+// where the chip8 interpreters of the past disagree, and so do the games written for them. the defaults are what this emulator has
+// always done. each quirk picks a different instantiation of the handler it affects when an instruction is decoded, so the handlers
+// themselves never test a quirk, see Chip8::SetQuirks and Quirks.hpp for the presets and per rom profiles
+struct Quirks
+{
+	bool shiftVy = false;       // 8xy6/8xyE shift Vy and put the result in Vx (COSMAC VIP), instead of shifting Vx in place
+	bool indexAdvances = false; // Fx55/Fx65 leave I pointing past the last register (COSMAC VIP), instead of where it was
+	bool jumpVx = false;        // Bnnn jumps to nnn + Vx, x being the top nibble of nnn (SUPER-CHIP), instead of nnn + V0
+	bool wrapSprites = false;   // Dxyn wraps sprites round the edges of the screen (XO-CHIP), instead of clipping them
+
+	// one bit per quirk in the order above, for files
+	uint8_t Bits() const
+	{
+		return static_cast<uint8_t>(shiftVy | (indexAdvances << 1) | (jumpVx << 2) | (wrapSprites << 3));
+	}
+
+	static Quirks FromBits(uint8_t bits)
+	{
+		Quirks quirks;
+		quirks.shiftVy = (bits & 1) != 0;
+		quirks.indexAdvances = (bits & 2) != 0;
+		quirks.jumpVx = (bits & 4) != 0;
+		quirks.wrapSprites = (bits & 8) != 0;
+		return quirks;
+	}
+};
 
 class Chip8
 {
 public:
 	Chip8();
-	void LoadROM(char const* filename);
+	~Chip8();
+	bool LoadROM(char const* filename); // false if the file cant be opened or doesnt fit at 0x200, memory is left alone then
+	bool LoadROM(uint8_t const* data, size_t size); // a rom already in memory, e.g. a RomLibrary image, one bulk copy
 	void Cycle();
 
+	void SetExecMode(ExecMode mode);
+	void SetAotProgram(AotProgram const* program); // the code ExecMode::Native runs, null drops it. only blocks that match memory run
+	void SetQuirks(Quirks quirks); // everything already decoded is thrown away, so this is cheap to call once after LoadROM and costly in a loop
+	Quirks GetQuirks() const;
+	void Run(unsigned int cycles); // execute this many instructions using the current ExecMode
+	void TickTimers(); // count the delay and sound timers down by one, this is the 60hz tick
+	bool SoundActive() const; // the sound timer is running, the buzzer should be on
+	uint64_t CycleCount() const; // instructions executed since construction
+
+	// the constructor seeds from the clock, seeding explicitly makes Cxkk give the same numbers every run
+	// same seed, same rom and the same keypad at the same cycles is the same run, bit for bit
+	void Seed(uint32_t seed);
+	static uint32_t SeedState(uint32_t seed);   // the generator state Seed starts from, never 0
+	static uint8_t RandomByte(uint32_t& state); // one step of the generator Cxkk uses, state must not be 0
+
+	void Save(SaveState& state) const;
+	bool Restore(SaveState const& state); // false (and nothing changes) if the state has the wrong magic, version or size, an rng state of 0, or sp past the top of the stack
+
+	void SetTraceLevel(TraceLevel level); // does nothing unless built with CHIP8_TRACE
+	Trace const* GetTrace() const;        // null until tracing has been turned on
+
+	// does nothing unless built with CHIP8_PROFILE. while it is on Run goes through the block cache whatever the ExecMode,
+	// blocks can be counted a whole run at a time and native jit code cant be counted at all
+	void SetProfiling(bool on);
+	Profiler const* GetProfiler() const; // null until profiling has been turned on, the counts stay readable after it is turned off
+	bool WriteProfile(char const* pathPrefix); // <pathPrefix>.json and <pathPrefix>.folded, false if profiling never ran or a write failed
+
+	// whether OP_Dxyn or OP_00E0 changed the screen since the last ClearDirty
+	bool IsDirty() const;
+	void ClearDirty();
+
 	uint8_t keypad[KEY_COUNT]{};
-	uint32_t video[VIDEO_WIDTH * VIDEO_HEIGHT]{};
+	uint64_t video[VIDEO_HEIGHT]{}; // one bit per pixel, one 64 bit word per row, column 0 is the most significant bit
 
 private:
+	friend class Aot;
+	friend class AotCompiler;
+	friend class BlockCache;
+	friend class Jit;
+
+	typedef void (Chip8::*Chip8Func)();
+
+	// an instruction with its operands already pulled out of the opcode, the OP_ handlers read everything from here
+	struct Instruction
+	{
+		uint16_t opcode;
+		uint16_t nnn; // lowest 12 bits, an address
+		uint8_t x;    // second nibble, a register
+		uint8_t y;    // third nibble, a register
+		uint8_t kk;   // lowest byte
+		uint8_t n;    // lowest nibble
+	};
+
+	// one number per handler, so a predecoded instruction can name its handler in a byte
+	enum Handler : uint8_t
+	{
+		HANDLER_UNDECODED, // a predecoded entry that has not been filled in yet
+		HANDLER_NULL,
+		HANDLER_00E0, HANDLER_00EE, HANDLER_1nnn, HANDLER_2nnn, HANDLER_3xkk, HANDLER_4xkk, HANDLER_5xy0, HANDLER_6xkk, HANDLER_7xkk,
+		HANDLER_8xy0, HANDLER_8xy1, HANDLER_8xy2, HANDLER_8xy3, HANDLER_8xy4, HANDLER_8xy5, HANDLER_8xy6, HANDLER_8xy7, HANDLER_8xyE,
+		HANDLER_9xy0, HANDLER_Annn, HANDLER_Bnnn, HANDLER_Cxkk, HANDLER_Dxyn, HANDLER_Ex9E, HANDLER_ExA1,
+		HANDLER_Fx07, HANDLER_Fx0A, HANDLER_Fx15, HANDLER_Fx18, HANDLER_Fx1E, HANDLER_Fx29, HANDLER_Fx33, HANDLER_Fx55, HANDLER_Fx65,
+		// the quirk instantiations, Classify never returns these, Specialize swaps them in for the one above when the quirk is on
+		HANDLER_8xy6_VY, HANDLER_8xyE_VY, HANDLER_Fx55_ADVANCE, HANDLER_Fx65_ADVANCE, HANDLER_Bxnn, HANDLER_Dxyn_WRAP,
+		HANDLER_COUNT
+	};
+
+	// the interpreters shadow of memory, one entry per even address holding the instruction there already decoded
+	struct Predecoded
+	{
+		Instruction instruction;
+		Handler handler;
+	};
+
+	static Instruction Split(uint16_t opcode);
+	static Handler Classify(uint16_t opcode); // the same choice the tables make with the default quirks, as a Handler
+	Handler Specialize(Handler handler) const; // the instantiation of handler for this machines quirks
+	static char const* const handlerNames[HANDLER_COUNT]; // the opcode family names the profiler reports
+	static Chip8Func const handlers[HANDLER_COUNT];
+
+	Chip8Func Decode(uint16_t opcode) const; // the handler that will execute an opcode
+	void Predecode(Predecoded& entry, uint16_t address) const;
+	void Dispatch(Handler handler); // calls a handler by number, through handlers[] or a switch depending on CHIP8_DISPATCH
+	void CodeWritten(uint16_t address, uint16_t length); // called whenever an instruction writes to memory
+	void RomLoaded(uint16_t size);                         // after either LoadROM has put size bytes at 0x200
+
+	void Execute(); // calls the handler for opcode, through the tables or a switch depending on the CHIP8_DISPATCH build option
+	void Interpret(unsigned int cycles); // the ExecMode::Interpreter loop, runs from predecoded and is threaded code in the goto build
+
 	void Table0();
 	void Table8();
 	void TableE();
@@ -81,13 +219,15 @@ private:
 	// SUB Vx, Vy
 	void OP_8xy5();
 
-	// SHR Vx
+	// SHR Vx, with ShiftVy Vx = Vy first
+	template <bool ShiftVy>
 	void OP_8xy6();
 
 	// SUBN Vx, Vy
 	void OP_8xy7();
 
-	// SHL Vx
+	// SHL Vx, with ShiftVy Vx = Vy first
+	template <bool ShiftVy>
 	void OP_8xyE();
 
 	// SNE Vx, Vy
@@ -96,13 +236,15 @@ private:
 	// LD I, address
 	void OP_Annn();
 
-	// JP V0, address
+	// JP V0, address, with JumpVx JP Vx, address
+	template <bool JumpVx>
 	void OP_Bnnn();
 
 	// RND Vx, byte
 	void OP_Cxkk();
 
-	// DRW Vx, Vy, height
+	// DRW Vx, Vy, height, clipped at the edges or with Wrap wrapped round them
+	template <bool Wrap>
 	void OP_Dxyn();
 
 	// SKP Vx
@@ -132,10 +274,12 @@ private:
 	// LD B, Vx
 	void OP_Fx33();
 
-	// LD [I], Vx
+	// LD [I], Vx, with Advance I ends up past Vx
+	template <bool Advance>
 	void OP_Fx55();
 
-	// LD Vx, [I]
+	// LD Vx, [I], with Advance I ends up past Vx
+	template <bool Advance>
 	void OP_Fx65();
 
 	uint8_t memory[MEMORY_SIZE]{};
@@ -146,17 +290,31 @@ private:
 	uint8_t soundTimer{};
 	uint16_t stack[STACK_LEVELS]{};
 	uint8_t sp{};
-	uint16_t opcode{};
+	Instruction instruction{}; // the one being executed
 
-	std::default_random_engine randGen;
-	std::uniform_int_distribution<uint8_t> randByte;
+	bool dirty{}; // set by anything that changes the screen, cleared by ClearDirty
+
+	uint32_t rngState = 1; // xorshift32, a few shifts and XORs per number and the whole state is this one word, so it goes straight into save states
 
-	typedef void (Chip8::*Chip8Func)();
 	Chip8Func table[0xF + 1];
-	Chip8Func table0[0xE + 1];
-	Chip8Func table8[0xE + 1];
-	Chip8Func tableE[0xE + 1];
+	Chip8Func table0[0xF + 1];
+	Chip8Func table8[0xF + 1];
+	Chip8Func tableE[0xF + 1];
 	Chip8Func tableF[0x65 + 1];
+	Handler specialized[HANDLER_COUNT]; // Specialize of every handler for the current quirks, SetQuirks fills it in
+
+
+	ExecMode execMode = ExecMode::Interpreter;
+	Quirks quirks;
+	std::unique_ptr<Predecoded[]> predecoded; // MEMORY_SIZE / 2 entries, allocated the first time the interpreter runs
+	std::unique_ptr<BlockCache> blockCache; // only allocated once block mode is turned on
+	std::unique_ptr<Jit> jit;               // same for the jit
+	std::unique_ptr<Aot> aot;               // only once SetAotProgram has been given one
+
+	uint64_t cycleCount{};
+	std::unique_ptr<Trace> trace;
+	std::unique_ptr<Profiler> profiler; // only allocated once profiling is turned on, and kept when it is turned off again
+	Profiler* profiling = nullptr;      // the profiler while it is on, null while it is off, this is what the profiling points check
 };
 
 
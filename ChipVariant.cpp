@@ -0,0 +1,725 @@
+#include "ChipVariant.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+
+namespace
+{
+    const unsigned int START_ADDRESS = 0x200;
+    const unsigned int FONTSET_START_ADDRESS = 0x50;  // the same 4x5 digits at the same place as Chip8
+    const unsigned int BIG_FONT_START_ADDRESS = 0xA0; // 8x10 digits for Fx30, right after them
+    const unsigned int MAX_SPRITE_ROWS = 32;          // 16 rows of a 16x16 sprite, doubled in lores
+
+    const uint8_t smallFont[16 * 5] =
+    {
+        0xF0, 0x90, 0x90, 0x90, 0xF0, 0x20, 0x60, 0x20, 0x20, 0x70, 0xF0, 0x10, 0xF0, 0x80, 0xF0, 0xF0, 0x10, 0xF0, 0x10, 0xF0,
+        0x90, 0x90, 0xF0, 0x10, 0x10, 0xF0, 0x80, 0xF0, 0x10, 0xF0, 0xF0, 0x80, 0xF0, 0x90, 0xF0, 0xF0, 0x10, 0x20, 0x40, 0x40,
+        0xF0, 0x90, 0xF0, 0x90, 0xF0, 0xF0, 0x90, 0xF0, 0x10, 0xF0, 0xF0, 0x90, 0xF0, 0x90, 0x90, 0xE0, 0x90, 0xE0, 0x90, 0xE0,
+        0xF0, 0x80, 0x80, 0x80, 0xF0, 0xE0, 0x90, 0x90, 0x90, 0xE0, 0xF0, 0x80, 0xF0, 0x80, 0xF0, 0xF0, 0x80, 0xF0, 0x80, 0x80,
+    };
+
+    // SUPER-CHIP only had 0-9 big, XO-CHIP roms can ask for A-F too
+    const uint8_t bigFont[16 * 10] =
+    {
+        0x3C, 0x7E, 0xE7, 0xC3, 0xC3, 0xC3, 0xC3, 0xE7, 0x7E, 0x3C, // 0
+        0x18, 0x38, 0x58, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x3C, // 1
+        0x3E, 0x7F, 0xC3, 0x06, 0x0C, 0x18, 0x30, 0x60, 0xFF, 0xFF, // 2
+        0x3C, 0x7E, 0xC3, 0x03, 0x0E, 0x0E, 0x03, 0xC3, 0x7E, 0x3C, // 3
+        0x06, 0x0E, 0x1E, 0x36, 0x66, 0xC6, 0xFF, 0xFF, 0x06, 0x06, // 4
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFC, 0xFE, 0x03, 0xC3, 0x7E, 0x3C, // 5
+        0x3E, 0x7C, 0xE0, 0xC0, 0xFC, 0xFE, 0xC3, 0xC3, 0x7E, 0x3C, // 6
+        0xFF, 0xFF, 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x60, 0x60, // 7
+        0x3C, 0x7E, 0xC3, 0xC3, 0x7E, 0x7E, 0xC3, 0xC3, 0x7E, 0x3C, // 8
+        0x3C, 0x7E, 0xC3, 0xC3, 0x7F, 0x3F, 0x03, 0x03, 0x3E, 0x7C, // 9
+        0x18, 0x3C, 0x66, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, // A
+        0xFC, 0xFE, 0xC3, 0xC3, 0xFE, 0xFE, 0xC3, 0xC3, 0xFE, 0xFC, // B
+        0x3C, 0x7E, 0xE3, 0xC0, 0xC0, 0xC0, 0xC0, 0xE3, 0x7E, 0x3C, // C
+        0xFC, 0xFE, 0xC7, 0xC3, 0xC3, 0xC3, 0xC3, 0xC7, 0xFE, 0xFC, // D
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFC, 0xFC, 0xC0, 0xC0, 0xFF, 0xFF, // E
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFC, 0xFC, 0xC0, 0xC0, 0xC0, 0xC0, // F
+    };
+
+    // four rows of one column word, the unit the scroll and sprite kernels work in. with GCC/Clang a vector extension type so a
+    // kernel step is two SSE2 instructions (or one AVX2 one), elsewhere a plain struct the compiler can still unroll. like the
+    // Lockstep kernels they are built twice and the loader picks the AVX2 copy on cpus that have it
+#if defined(__x86_64__) && defined(__linux__)
+#define CHIP8_ROW_KERNEL __attribute__((target_clones("avx2", "default")))
+#else
+#define CHIP8_ROW_KERNEL
+#endif
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic ignored "-Wpsabi" // the helpers are inlined, a 32 byte vector never crosses a real call without AVX
+    typedef uint64_t Rows __attribute__((vector_size(32)));
+#else
+    struct Rows
+    {
+        uint64_t lane[4];
+
+        Rows operator|(Rows const& other) const { Rows out; for (int i = 0; i < 4; ++i) out.lane[i] = lane[i] | other.lane[i]; return out; }
+        Rows operator&(Rows const& other) const { Rows out; for (int i = 0; i < 4; ++i) out.lane[i] = lane[i] & other.lane[i]; return out; }
+        Rows operator^(Rows const& other) const { Rows out; for (int i = 0; i < 4; ++i) out.lane[i] = lane[i] ^ other.lane[i]; return out; }
+        Rows operator<<(unsigned int shift) const { Rows out; for (int i = 0; i < 4; ++i) out.lane[i] = lane[i] << shift; return out; }
+        Rows operator>>(unsigned int shift) const { Rows out; for (int i = 0; i < 4; ++i) out.lane[i] = lane[i] >> shift; return out; }
+    };
+#endif
+    const unsigned int LANES = sizeof(Rows) / sizeof(uint64_t);
+
+    inline Rows Load(uint64_t const* from)
+    {
+        Rows rows;
+        std::memcpy(&rows, from, sizeof(rows));
+        return rows;
+    }
+
+    inline void Store(uint64_t* to, Rows const& rows)
+    {
+        std::memcpy(to, &rows, sizeof(rows));
+    }
+
+    inline bool Any(Rows const& rows)
+    {
+        uint64_t lanes[LANES];
+        std::memcpy(lanes, &rows, sizeof(rows));
+        return (lanes[0] | lanes[1] | lanes[2] | lanes[3]) != 0;
+    }
+
+    // xors count rows of pieces into a column word's rows, true if any bit it flipped was already on
+    CHIP8_ROW_KERNEL
+    bool XorRows(uint64_t* column, uint64_t const* pieces, unsigned int count)
+    {
+        unsigned int row = 0;
+        bool hit = false;
+        for (; row + LANES <= count; row += LANES)
+        {
+            Rows screen = Load(column + row);
+            Rows sprite = Load(pieces + row);
+            hit |= Any(screen & sprite);
+            Store(column + row, screen ^ sprite);
+        }
+        for (; row < count; ++row)
+        {
+            hit |= (column[row] & pieces[row]) != 0;
+            column[row] ^= pieces[row];
+        }
+        return hit;
+    }
+
+    // the two column words move together, bits leaving one word enter the other. shift is 1..63
+    CHIP8_ROW_KERNEL
+    void ShiftRight(uint64_t* left, uint64_t* right, unsigned int count, unsigned int shift)
+    {
+        for (unsigned int row = 0; row < count; row += LANES)
+        {
+            Rows l = Load(left + row);
+            Rows r = Load(right + row);
+            Store(right + row, (r >> shift) | (l << (64 - shift)));
+            Store(left + row, l >> shift);
+        }
+    }
+
+    CHIP8_ROW_KERNEL
+    void ShiftLeft(uint64_t* left, uint64_t* right, unsigned int count, unsigned int shift)
+    {
+        for (unsigned int row = 0; row < count; row += LANES)
+        {
+            Rows l = Load(left + row);
+            Rows r = Load(right + row);
+            Store(left + row, (l << shift) | (r >> (64 - shift)));
+            Store(right + row, r << shift);
+        }
+    }
+
+    // every bit of a 16 bit sprite row twice, for lores pixels that are two hires columns wide
+    uint32_t Double(uint32_t bits)
+    {
+        bits = (bits | (bits << 8)) & 0x00FF00FFu;
+        bits = (bits | (bits << 4)) & 0x0F0F0F0Fu;
+        bits = (bits | (bits << 2)) & 0x33333333u;
+        bits = (bits | (bits << 1)) & 0x55555555u;
+        return bits | (bits << 1);
+    }
+}
+
+
+template <typename Machine>
+ChipVariant<Machine>::ChipVariant()
+{
+    pc = START_ADDRESS;
+    std::memcpy(memory + FONTSET_START_ADDRESS, smallFont, sizeof(smallFont));
+    std::memcpy(memory + BIG_FONT_START_ADDRESS, bigFont, sizeof(bigFont));
+
+    Seed(static_cast<uint32_t>(std::chrono::system_clock::now().time_since_epoch().count()));
+}
+
+template <typename Machine>
+bool ChipVariant<Machine>::LoadROM(uint8_t const* data, size_t size)
+{
+    if (size > Machine::MEMORY - START_ADDRESS)
+    {
+        return false;
+    }
+
+    std::memcpy(memory + START_ADDRESS, data, size);
+    return true;
+}
+
+template <typename Machine>
+void ChipVariant<Machine>::Seed(uint32_t seed)
+{
+    rngState = Chip8::SeedState(seed);
+}
+
+template <typename Machine>
+void ChipVariant<Machine>::Run(unsigned int cycles)
+{
+    for (unsigned int i = 0; i < cycles && !exited; ++i)
+    {
+        Cycle();
+    }
+}
+
+template <typename Machine>
+void ChipVariant<Machine>::TickTimers()
+{
+    if (delayTimer > 0)
+    {
+        --delayTimer;
+    }
+    if (soundTimer > 0)
+    {
+        --soundTimer;
+    }
+}
+
+template <typename Machine>
+bool ChipVariant<Machine>::SoundActive() const
+{
+    return soundTimer > 0;
+}
+
+template <typename Machine>
+bool ChipVariant<Machine>::HiRes() const
+{
+    return hires;
+}
+
+template <typename Machine>
+bool ChipVariant<Machine>::Exited() const
+{
+    return exited;
+}
+
+template <typename Machine>
+uint64_t ChipVariant<Machine>::CycleCount() const
+{
+    return cycleCount;
+}
+
+template <typename Machine>
+void ChipVariant<Machine>::RenderRGBA(uint32_t* pixels, uint32_t const* palette) const
+{
+    for (unsigned int y = 0; y < HEIGHT; ++y)
+    {
+        for (unsigned int x = 0; x < WIDTH; ++x)
+        {
+            unsigned int colour = 0;
+            for (unsigned int p = 0; p < PLANES; ++p)
+            {
+                colour |= ((video[p][x / 64][y] >> (63 - x % 64)) & 1) << p;
+            }
+            pixels[y * WIDTH + x] = palette[colour];
+        }
+    }
+}
+
+template <typename Machine>
+uint16_t ChipVariant<Machine>::Fetch(uint16_t address) const
+{
+    const unsigned int MASK = Machine::MEMORY - 1;
+    return static_cast<uint16_t>((memory[address & MASK] << 8) | memory[(address + 1u) & MASK]);
+}
+
+template <typename Machine>
+void ChipVariant<Machine>::Skip()
+{
+    pc += (Machine::XO && Fetch(pc) == 0xF000) ? 4 : 2;
+}
+
+template <typename Machine>
+void ChipVariant<Machine>::Clear()
+{
+    for (unsigned int p = 0; p < PLANES; ++p)
+    {
+        if (planes & (1u << p))
+        {
+            std::memset(video[p], 0, sizeof(video[p]));
+        }
+    }
+}
+
+template <typename Machine>
+void ChipVariant<Machine>::SetResolution(bool on)
+{
+    hires = on;
+    if (Machine::CLEAR_ON_RESOLUTION)
+    {
+        std::memset(video, 0, sizeof(video)); // every plane, not only the selected ones
+    }
+}
+
+// scroll amounts are in the pixels of the current mode, a lores pixel is two rows or columns of the screen
+template <typename Machine>
+void ChipVariant<Machine>::ScrollDown(unsigned int rows)
+{
+    rows = std::min(hires ? rows : rows * 2, HEIGHT);
+    for (unsigned int p = 0; p < PLANES; ++p)
+    {
+        for (unsigned int w = 0; (planes & (1u << p)) && w < WORDS; ++w)
+        {
+            std::memmove(video[p][w] + rows, video[p][w], (HEIGHT - rows) * sizeof(uint64_t));
+            std::memset(video[p][w], 0, rows * sizeof(uint64_t));
+        }
+    }
+}
+
+template <typename Machine>
+void ChipVariant<Machine>::ScrollUp(unsigned int rows)
+{
+    rows = std::min(hires ? rows : rows * 2, HEIGHT);
+    for (unsigned int p = 0; p < PLANES; ++p)
+    {
+        for (unsigned int w = 0; (planes & (1u << p)) && w < WORDS; ++w)
+        {
+            std::memmove(video[p][w], video[p][w] + rows, (HEIGHT - rows) * sizeof(uint64_t));
+            std::memset(video[p][w] + HEIGHT - rows, 0, rows * sizeof(uint64_t));
+        }
+    }
+}
+
+template <typename Machine>
+void ChipVariant<Machine>::ScrollRight(unsigned int columns)
+{
+    columns = hires ? columns : columns * 2;
+    for (unsigned int p = 0; p < PLANES; ++p)
+    {
+        if (planes & (1u << p))
+        {
+            ShiftRight(video[p][0], video[p][1], HEIGHT, columns);
+        }
+    }
+}
+
+template <typename Machine>
+void ChipVariant<Machine>::ScrollLeft(unsigned int columns)
+{
+    columns = hires ? columns : columns * 2;
+    for (unsigned int p = 0; p < PLANES; ++p)
+    {
+        if (planes & (1u << p))
+        {
+            ShiftLeft(video[p][0], video[p][1], HEIGHT, columns);
+        }
+    }
+}
+
+// Dxyn, an 8 wide sprite n rows tall, or with n of 0 a 16x16 one of two bytes a row. in lores everything is doubled onto the
+// screen. XO-CHIP draws into each selected plane in turn, the sprite data for the next plane following on from the last
+template <typename Machine>
+void ChipVariant<Machine>::Draw(uint8_t Vx, uint8_t Vy, uint8_t n)
+{
+    const unsigned int MASK = Machine::MEMORY - 1;
+    unsigned int wide = (n == 0) ? 16 : 8;
+    unsigned int tall = (n == 0) ? 16 : n;
+    unsigned int scale = hires ? 1 : 2;
+
+    // position wraps, only what runs off the far edges is clipped (or wrapped, with the quirk)
+    unsigned int x = (registers[Vx] * scale) % WIDTH;
+    unsigned int y = (registers[Vy] * scale) % HEIGHT;
+
+    bool hit = false;
+    uint16_t address = index;
+    for (unsigned int p = 0; p < PLANES; ++p)
+    {
+        if (!(planes & (1u << p)))
+        {
+            continue;
+        }
+
+        // the rows left aligned in a word, padded with 0 to a whole vector of rows for the kernel
+        uint64_t rows[MAX_SPRITE_ROWS];
+        for (unsigned int r = 0; r < tall; ++r)
+        {
+            uint32_t bits = (wide == 16)
+                ? (memory[(address + 2 * r) & MASK] << 8) | memory[(address + 2 * r + 1) & MASK]
+                : memory[(address + r) & MASK];
+
+            if (hires)
+            {
+                rows[r] = uint64_t(bits) << (64 - wide);
+            }
+            else
+            {
+                rows[2 * r] = rows[2 * r + 1] = uint64_t(Double(bits)) << (64 - 2 * wide);
+            }
+        }
+
+        for (unsigned int r = tall * scale; r % LANES != 0; ++r)
+        {
+            rows[r] = 0;
+        }
+
+        hit |= Blit(p, rows, tall * scale, x, y);
+        address = static_cast<uint16_t>(address + tall * wide / 8);
+    }
+
+    registers[0xF] = hit ? 1 : 0;
+}
+
+// the hires sprite kernel. every row of the sprite is shifted by the same amount, so the pieces for both column words are worked
+// out a vector of rows at a time and then xored into the screen the same way
+template <typename Machine>
+bool ChipVariant<Machine>::Blit(unsigned int plane, uint64_t const* rows, unsigned int count, unsigned int x, unsigned int y)
+{
+    const bool WRAP = Machine::QUIRKS.wrapSprites;
+
+    uint64_t left[MAX_SPRITE_ROWS];
+    uint64_t right[MAX_SPRITE_ROWS];
+
+    // where the sprite starts, and how far its bits carry into the word after (or off the right edge, from the second word).
+    // a sprite is always at least one row, which the do lets the compiler see
+    unsigned int shift = x % 64;
+    unsigned int carry = 64 - shift;
+    unsigned int r = 0;
+    do
+    {
+        Rows sprite = Load(rows + r);
+        Rows none{};
+        Rows first = sprite >> shift;
+        Rows spill = (shift != 0) ? sprite << carry : none;
+
+        if (x < 64)
+        {
+            Store(left + r, first);
+            Store(right + r, spill);
+        }
+        else
+        {
+            Store(left + r, WRAP ? spill : none);
+            Store(right + r, first);
+        }
+        r += LANES;
+    }
+    while (r < count);
+
+    uint64_t* column0 = video[plane][0];
+    uint64_t* column1 = video[plane][1];
+
+    unsigned int onScreen = std::min(count, HEIGHT - y);
+    bool hit = XorRows(column0 + y, left, onScreen) | XorRows(column1 + y, right, onScreen);
+    if (WRAP && count > onScreen)
+    {
+        hit |= XorRows(column0, left + onScreen, count - onScreen) | XorRows(column1, right + onScreen, count - onScreen);
+    }
+    return hit;
+}
+
+// the chip8 instructions do exactly what Chip8's OP_ handlers do with this machines quirks, the same order of writes included. the only
+// difference is where Chip8 would index outside its arrays (a stack overflow, a key above F, an address past the end of memory),
+// here those wrap round instead
+template <typename Machine>
+void ChipVariant<Machine>::Cycle()
+{
+    if (exited)
+    {
+        return;
+    }
+
+    const unsigned int MASK = Machine::MEMORY - 1;
+    uint16_t opcode = Fetch(pc);
+    pc += 2;
+    ++cycleCount;
+
+    uint16_t nnn = opcode & 0x0FFFu;
+    uint8_t x = (opcode >> 8) & 0xFu;
+    uint8_t y = (opcode >> 4) & 0xFu;
+    uint8_t kk = opcode & 0xFFu;
+    uint8_t n = opcode & 0xFu;
+    uint8_t* V = registers;
+
+    switch (opcode >> 12)
+    {
+    case 0x0:
+        if (opcode == 0x00E0)
+        {
+            Clear();
+        }
+        else if (opcode == 0x00EE)
+        {
+            --sp;
+            pc = stack[sp % STACK_LEVELS];
+        }
+        else if ((opcode & 0xFFF0) == 0x00C0)
+        {
+            ScrollDown(n);
+        }
+        else if (Machine::XO && (opcode & 0xFFF0) == 0x00D0)
+        {
+            ScrollUp(n);
+        }
+        else if (opcode == 0x00FB)
+        {
+            ScrollRight(4);
+        }
+        else if (opcode == 0x00FC)
+        {
+            ScrollLeft(4);
+        }
+        else if (opcode == 0x00FD)
+        {
+            exited = true;
+            pc -= 2; // stay on the 00FD
+        }
+        else if (opcode == 0x00FE || opcode == 0x00FF)
+        {
+            SetResolution(opcode == 0x00FF);
+        }
+        break;
+
+    case 0x1:
+        pc = nnn;
+        break;
+
+    case 0x2:
+        stack[sp % STACK_LEVELS] = pc;
+        ++sp;
+        pc = nnn;
+        break;
+
+    case 0x3:
+        if (V[x] == kk)
+        {
+            Skip();
+        }
+        break;
+
+    case 0x4:
+        if (V[x] != kk)
+        {
+            Skip();
+        }
+        break;
+
+    case 0x5:
+        if (Machine::XO && (n == 2 || n == 3))
+        {
+            // save or load Vx through Vy, in either direction, without moving I
+            unsigned int count = (x <= y) ? y - x : x - y;
+            for (unsigned int i = 0; i <= count; ++i)
+            {
+                uint8_t reg = static_cast<uint8_t>((x <= y) ? x + i : x - i);
+                uint8_t& cell = memory[(index + i) & MASK];
+                if (n == 2)
+                {
+                    cell = V[reg];
+                }
+                else
+                {
+                    V[reg] = cell;
+                }
+            }
+        }
+        else if (V[x] == V[y])
+        {
+            Skip();
+        }
+        break;
+
+    case 0x6:
+        V[x] = kk;
+        break;
+
+    case 0x7:
+        V[x] += kk;
+        break;
+
+    case 0x8:
+        // statement for statement what Chip8's OP_8xy handlers do, VF is written before Vx so with x = F the result is what stays
+        switch (n)
+        {
+        case 0x0: V[x] = V[y]; break;
+        case 0x1: V[x] |= V[y]; break;
+        case 0x2: V[x] &= V[y]; break;
+        case 0x3: V[x] ^= V[y]; break;
+        case 0x4:
+        {
+            unsigned int sum = V[x] + V[y];
+            V[0xF] = (sum > 0xFF) ? 1 : 0;
+            V[x] = static_cast<uint8_t>(sum);
+            break;
+        }
+        case 0x5: V[0xF] = (V[x] > V[y]) ? 1 : 0; V[x] -= V[y]; break;
+        case 0x7: V[0xF] = (V[y] > V[x]) ? 1 : 0; V[x] = V[y] - V[x]; break;
+        case 0x6:
+            if (Machine::QUIRKS.shiftVy)
+            {
+                V[x] = V[y];
+            }
+            V[0xF] = V[x] & 0x1u;
+            V[x] >>= 1;
+            break;
+        case 0xE:
+            if (Machine::QUIRKS.shiftVy)
+            {
+                V[x] = V[y];
+            }
+            V[0xF] = V[x] >> 7;
+            V[x] = static_cast<uint8_t>(V[x] << 1);
+            break;
+        }
+        break;
+
+    case 0x9:
+        if (V[x] != V[y])
+        {
+            Skip();
+        }
+        break;
+
+    case 0xA:
+        index = nnn;
+        break;
+
+    case 0xB:
+        pc = static_cast<uint16_t>(nnn + (Machine::QUIRKS.jumpVx ? V[x] : V[0]));
+        break;
+
+    case 0xC:
+        V[x] = Chip8::RandomByte(rngState) & kk;
+        break;
+
+    case 0xD:
+        Draw(x, y, n);
+        break;
+
+    case 0xE:
+        if (kk == 0x9E && keypad[V[x] & 0xFu])
+        {
+            Skip();
+        }
+        else if (kk == 0xA1 && !keypad[V[x] & 0xFu])
+        {
+            Skip();
+        }
+        break;
+
+    case 0xF:
+        switch (kk)
+        {
+        case 0x00:
+            if (Machine::XO && x == 0)
+            {
+                index = Fetch(pc); // F000 nnnn, a 16 bit I from the word after
+                pc += 2;
+            }
+            break;
+        case 0x01:
+            if (Machine::XO)
+            {
+                planes = x & ((1u << PLANES) - 1);
+            }
+            break;
+        case 0x02:
+            if (Machine::XO && x == 0)
+            {
+                for (unsigned int i = 0; i < sizeof(audioPattern); ++i)
+                {
+                    audioPattern[i] = memory[(index + i) & MASK];
+                }
+            }
+            break;
+        case 0x07:
+            V[x] = delayTimer;
+            break;
+        case 0x0A:
+        {
+            // like Chip8::OP_Fx0A, the lowest key held goes into Vx and with none held Vx is left alone, nothing waits
+            unsigned int key = 0;
+            while (key < KEY_COUNT && !keypad[key])
+            {
+                ++key;
+            }
+            if (key < KEY_COUNT)
+            {
+                V[x] = static_cast<uint8_t>(key);
+            }
+            break;
+        }
+        case 0x15:
+            delayTimer = V[x];
+            break;
+        case 0x18:
+            soundTimer = V[x];
+            break;
+        case 0x1E:
+            index = static_cast<uint16_t>(index + V[x]);
+            break;
+        case 0x29:
+            index = static_cast<uint16_t>(FONTSET_START_ADDRESS + 5 * V[x]);
+            break;
+        case 0x30:
+            index = static_cast<uint16_t>(BIG_FONT_START_ADDRESS + 10 * (V[x] & 0xFu));
+            break;
+        case 0x33:
+            memory[index & MASK] = V[x] / 100;
+            memory[(index + 1) & MASK] = (V[x] / 10) % 10;
+            memory[(index + 2) & MASK] = V[x] % 10;
+            break;
+        case 0x3A:
+            if (Machine::XO)
+            {
+                pitch = V[x];
+            }
+            break;
+        case 0x55:
+        case 0x65:
+            for (unsigned int i = 0; i <= x; ++i)
+            {
+                uint8_t& cell = memory[(index + i) & MASK];
+                if (kk == 0x55)
+                {
+                    cell = V[i];
+                }
+                else
+                {
+                    V[i] = cell;
+                }
+            }
+            if (Machine::QUIRKS.indexAdvances)
+            {
+                index = static_cast<uint16_t>(index + x + 1);
+            }
+            break;
+        case 0x75:
+        case 0x85:
+            for (unsigned int i = 0; i <= x && i < Machine::FLAGS; ++i)
+            {
+                if (kk == 0x75)
+                {
+                    flags[i] = V[i];
+                }
+                else
+                {
+                    V[i] = flags[i];
+                }
+            }
+            break;
+        }
+        break;
+    }
+}
+
+
+template class ChipVariant<SuperChipMachine>;
+template class ChipVariant<XoChipMachine>;
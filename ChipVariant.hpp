@@ -0,0 +1,114 @@
+#ifndef CHIP_VARIANT_HPP
+#define CHIP_VARIANT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include "Chip8.hpp"
+
+
+// the machines after chip8, each one a compile-time description that ChipVariant is instantiated with. Chip8 itself is left exactly
+// as it was, a 64x32 screen in 256 bytes and 4k of memory, so nothing here costs the plain chip8 roms anything
+
+// SUPER-CHIP 1.1 on the HP48: a 128x64 hires mode next to the 64x32 lores one, scrolling, 16x16 sprites, a big font and 8 RPL flags
+struct SuperChipMachine
+{
+	static constexpr unsigned int WIDTH = 128;
+	static constexpr unsigned int HEIGHT = 64;
+	static constexpr unsigned int MEMORY = 4096;
+	static constexpr unsigned int PLANES = 1;
+	static constexpr unsigned int FLAGS = 8;             // registers Fx75/Fx85 can save to and load from
+	static constexpr bool XO = false;                    // F000 nnnn, 5xy2/5xy3, Fn01, 00Dn, F002 and Fx3A
+	static constexpr bool CLEAR_ON_RESOLUTION = false;   // 00FE/00FF clear the screen
+	static constexpr Quirks QUIRKS{ false, false, true, false }; // jump, what the "schip" preset in Quirks.hpp is
+};
+
+// XO-CHIP: everything SUPER-CHIP has plus 64k of memory, two bit planes, scrolling up and a few more instructions
+struct XoChipMachine
+{
+	static constexpr unsigned int WIDTH = 128;
+	static constexpr unsigned int HEIGHT = 64;
+	static constexpr unsigned int MEMORY = 65536;
+	static constexpr unsigned int PLANES = 2;
+	static constexpr unsigned int FLAGS = 16;
+	static constexpr bool XO = true;
+	static constexpr bool CLEAR_ON_RESOLUTION = true;
+	static constexpr Quirks QUIRKS{ true, true, false, true }; // shift,memory,wrap, the "xochip" preset
+};
+
+// the chip8 core for a Machine above. everything the machine fixes (screen, memory, planes, quirks) is a constant here, so each
+// instantiation is its own straight interpreter with no runtime test for which machine it is
+//
+// the screen is always WIDTH x HEIGHT, lores pixels are drawn as 2x2 blocks of it. its rows are stored a column word at a time, all
+// the rows of columns 0-63 and then all the rows of columns 64-127, so scrolling sideways and xoring a sprite in are the same shift
+// or xor on whole vectors of rows
+template <typename Machine>
+class ChipVariant
+{
+public:
+	static constexpr unsigned int WIDTH = Machine::WIDTH;
+	static constexpr unsigned int HEIGHT = Machine::HEIGHT;
+	static constexpr unsigned int WORDS = WIDTH / 64; // column words across a row
+	static constexpr unsigned int PLANES = Machine::PLANES;
+
+	static_assert(WIDTH == 128, "the scroll and sprite kernels are written for rows of two column words");
+	static_assert((Machine::MEMORY & (Machine::MEMORY - 1)) == 0, "addresses wrap with a mask");
+
+	ChipVariant(); // seeds from the clock, like Chip8
+	bool LoadROM(uint8_t const* data, size_t size); // false if it doesnt fit at 0x200, memory is left alone then
+	void Cycle();
+	void Run(unsigned int cycles); // stops early once the rom exits with 00FD
+	void TickTimers();
+	void Seed(uint32_t seed); // the same generator and seeding as Chip8::Seed
+
+	bool SoundActive() const;
+	bool HiRes() const;
+	bool Exited() const; // 00FD ran, Cycle does nothing from then on
+	uint64_t CycleCount() const;
+
+	// fills WIDTH * HEIGHT RGBA pixels, each one palette[its plane bits], so a one plane machine needs 2 colours and XO-CHIP 4
+	void RenderRGBA(uint32_t* pixels, uint32_t const* palette) const;
+
+	uint8_t keypad[KEY_COUNT]{};
+	uint64_t video[PLANES][WORDS][HEIGHT]{}; // plane, column word, row. column 0 is the most significant bit of word 0
+
+	// XO-CHIP sound, F002 loads a 128 bit 1 bit per sample pattern and Fx3A its playback pitch. kept for a frontend to play,
+	// the core only runs the sound timer
+	uint8_t audioPattern[16]{};
+	uint8_t pitch = 64;
+
+private:
+	uint16_t Fetch(uint16_t address) const;
+	void Skip(); // over the next instruction, which is two words when it is F000 nnnn
+	void Clear();
+	void SetResolution(bool on);
+	void ScrollDown(unsigned int rows);
+	void ScrollUp(unsigned int rows);
+	void ScrollRight(unsigned int columns);
+	void ScrollLeft(unsigned int columns);
+	void Draw(uint8_t Vx, uint8_t Vy, uint8_t n);
+	bool Blit(unsigned int plane, uint64_t const* rows, unsigned int count, unsigned int x, unsigned int y); // true if it hit a lit pixel
+
+	uint8_t registers[REGISTER_COUNT]{};
+	uint8_t memory[Machine::MEMORY]{};
+	uint16_t index{};
+	uint16_t pc{};
+	uint16_t stack[STACK_LEVELS]{};
+	uint8_t sp{};
+	uint8_t delayTimer{};
+	uint8_t soundTimer{};
+	uint8_t flags[Machine::FLAGS]{};
+	uint8_t planes = 1; // which planes draw, clear and scroll work on, Fn01 changes it on XO-CHIP
+	bool hires = false;
+	bool exited = false;
+	uint32_t rngState = 1;
+	uint64_t cycleCount = 0;
+};
+
+extern template class ChipVariant<SuperChipMachine>;
+extern template class ChipVariant<XoChipMachine>;
+
+typedef ChipVariant<SuperChipMachine> SuperChip8;
+typedef ChipVariant<XoChipMachine> XoChip8;
+
+
+#endif
@@ -0,0 +1,668 @@
+#include "Jit.hpp"
+#include <algorithm>
+#include <cstring>
+
+#if defined(CHIP8_JIT) && defined(__x86_64__) && defined(__unix__)
+#define CHIP8_JIT_X64 1
+#include <sys/mman.h>
+#endif
+
+
+#ifdef CHIP8_JIT_X64
+namespace
+{
+    // host register numbers as they are encoded in x86-64 instructions
+    enum HostReg : uint8_t
+    {
+        RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSP = 4, RBP = 5, RSI = 6, RDI = 7,
+        R8 = 8, R9 = 9, R10 = 10, R11 = 11, R12 = 12, R13 = 13, R14 = 14, R15 = 15
+    };
+
+    // condition codes for jcc and setcc
+    enum Cond : uint8_t
+    {
+        COND_C = 0x2, COND_E = 0x4, COND_NE = 0x5, COND_A = 0x7
+    };
+
+    // rdi holds the address of chip8.registers for the whole block and rax is scratch, everything else can hold a chip8 register
+    const uint8_t ALLOCATABLE[] = { RCX, RDX, RSI, R8, R9, R10, R11, RBX, RBP, R12, R13, R14, R15 };
+    const unsigned int ALLOCATABLE_COUNT = sizeof(ALLOCATABLE);
+
+    bool CalleeSaved(uint8_t reg)
+    {
+        return reg == RBX || reg == RBP || reg >= R12;
+    }
+
+    // every byte sized instruction carries a REX prefix, with one present register numbers 4-7 mean spl/bpl/sil/dil instead of ah/ch/dh/bh
+    // so all 16 host registers can be used as byte registers the same way
+    class Emitter
+    {
+    public:
+        std::vector<uint8_t> code;
+
+        void Byte(uint8_t b) { code.push_back(b); }
+
+        void Dword(uint32_t d)
+        {
+            for (int i = 0; i < 4; ++i)
+            {
+                Byte(static_cast<uint8_t>(d >> (8 * i)));
+            }
+        }
+
+        void Word(uint16_t w)
+        {
+            Byte(static_cast<uint8_t>(w));
+            Byte(static_cast<uint8_t>(w >> 8));
+        }
+
+        void Rex(uint8_t reg, uint8_t rm) { Byte(0x40 | ((reg >> 3) << 2) | (rm >> 3)); }
+        void ModRM(uint8_t mod, uint8_t reg, uint8_t rm) { Byte((mod << 6) | ((reg & 7) << 3) | (rm & 7)); }
+
+        // op r/m8, r8 (mov 0x88, add 0x00, or 0x08, and 0x20, sub 0x28, xor 0x30, cmp 0x38)
+        void OpRegReg8(uint8_t op, uint8_t rm, uint8_t reg)
+        {
+            Rex(reg, rm);
+            Byte(op);
+            ModRM(3, reg, rm);
+        }
+
+        // 0x80 group, op r/m8, imm8 (/0 add, /7 cmp, /4 and)
+        void OpRegImm8(uint8_t ext, uint8_t rm, uint8_t imm)
+        {
+            Rex(0, rm);
+            Byte(0x80);
+            ModRM(3, ext, rm);
+            Byte(imm);
+        }
+
+        void MovRegImm8(uint8_t reg, uint8_t imm)
+        {
+            Rex(0, reg);
+            Byte(0xB0 + (reg & 7));
+            Byte(imm);
+        }
+
+        // shift r/m8 by one (/4 shl, /5 shr)
+        void ShiftOne8(uint8_t ext, uint8_t rm)
+        {
+            Rex(0, rm);
+            Byte(0xD0);
+            ModRM(3, ext, rm);
+        }
+
+        // shift r/m8 by an immediate
+        void ShiftImm8(uint8_t ext, uint8_t rm, uint8_t count)
+        {
+            Rex(0, rm);
+            Byte(0xC0);
+            ModRM(3, ext, rm);
+            Byte(count);
+        }
+
+        void SetCC(uint8_t cond, uint8_t rm)
+        {
+            Rex(0, rm);
+            Byte(0x0F);
+            Byte(0x90 + cond);
+            ModRM(3, 0, rm);
+        }
+
+        // movzx r32, byte [rdi + disp]
+        void LoadByte(uint8_t reg, int32_t disp)
+        {
+            Rex(reg, RDI);
+            Byte(0x0F);
+            Byte(0xB6);
+            ModRM(2, reg, RDI);
+            Dword(static_cast<uint32_t>(disp));
+        }
+
+        // mov byte [rdi + disp], r8
+        void StoreByte(int32_t disp, uint8_t reg)
+        {
+            Rex(reg, RDI);
+            Byte(0x88);
+            ModRM(2, reg, RDI);
+            Dword(static_cast<uint32_t>(disp));
+        }
+
+        // movzx eax, r8
+        void ZeroExtendToEax(uint8_t rm)
+        {
+            Rex(RAX, rm);
+            Byte(0x0F);
+            Byte(0xB6);
+            ModRM(3, RAX, rm);
+        }
+
+        // mov word [rdi + disp], imm16
+        void StoreWordImm(int32_t disp, uint16_t imm)
+        {
+            Byte(0x66);
+            Byte(0xC7);
+            ModRM(2, 0, RDI);
+            Dword(static_cast<uint32_t>(disp));
+            Word(imm);
+        }
+
+        // add word [rdi + disp], ax
+        void AddWordAx(int32_t disp)
+        {
+            Byte(0x66);
+            Byte(0x01);
+            ModRM(2, RAX, RDI);
+            Dword(static_cast<uint32_t>(disp));
+        }
+
+        void Push(uint8_t reg)
+        {
+            if (reg >= 8) Byte(0x41);
+            Byte(0x50 + (reg & 7));
+        }
+
+        void Pop(uint8_t reg)
+        {
+            if (reg >= 8) Byte(0x41);
+            Byte(0x58 + (reg & 7));
+        }
+
+        // jcc rel32 with the target patched in later, returns where the displacement lives
+        size_t JumpIf(uint8_t cond)
+        {
+            Byte(0x0F);
+            Byte(0x80 + cond);
+            size_t at = code.size();
+            Dword(0);
+            return at;
+        }
+
+        void PatchJumpHere(size_t at)
+        {
+            uint32_t rel = static_cast<uint32_t>(code.size() - (at + 4));
+            std::memcpy(&code[at], &rel, 4);
+        }
+    };
+
+    // one decoded instruction the jit knows how to translate
+    struct JitOp
+    {
+        uint16_t opcode;
+        uint16_t address;
+    };
+
+    bool Handled(uint16_t opcode, Quirks const& quirks)
+    {
+        switch ((opcode & 0xF000u) >> 12u)
+        {
+            case 0x1: case 0x3: case 0x4: case 0x5: case 0x6: case 0x7: case 0x9: case 0xA:
+                return true; // like table[], 5xy_ and 9xy_ ignore the last nibble
+            case 0x8:
+            {
+                uint8_t n = opcode & 0x000Fu;
+                if (quirks.shiftVy && (n == 0x6 || n == 0xE))
+                {
+                    return false; // the shifts are only translated the default way, Vy shifts run through the handlers
+                }
+                return n <= 0x7 || n == 0xE;
+            }
+            case 0xF:
+                return (opcode & 0x00FFu) == 0x1E;
+            default:
+                return false; // draws, calls, returns, random, key checks, timers, memory ops
+        }
+    }
+
+    bool EndsBlock(uint16_t opcode)
+    {
+        switch ((opcode & 0xF000u) >> 12u)
+        {
+            case 0x1: case 0x3: case 0x4: case 0x5: case 0x9:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    // the chip8 registers an instruction touches, VF counts for every flag setting 8xy_ instruction
+    void RegistersUsed(uint16_t opcode, bool used[REGISTER_COUNT], bool written[REGISTER_COUNT])
+    {
+        uint8_t x = (opcode & 0x0F00u) >> 8u;
+        uint8_t y = (opcode & 0x00F0u) >> 4u;
+
+        switch ((opcode & 0xF000u) >> 12u)
+        {
+            case 0x3: case 0x4:
+                used[x] = true;
+                break;
+            case 0x5: case 0x9:
+                used[x] = used[y] = true;
+                break;
+            case 0x6: case 0x7:
+                used[x] = written[x] = true;
+                break;
+            case 0x8:
+            {
+                uint8_t n = opcode & 0x000Fu;
+                used[x] = written[x] = true;
+                if (n != 0x6 && n != 0xE) // the shifts ignore Vy
+                {
+                    used[y] = true;
+                }
+                if (n >= 0x4)
+                {
+                    used[0xF] = written[0xF] = true;
+                }
+            } break;
+            case 0xF: // Fx1E
+                used[x] = true;
+                break;
+            default:
+                break;
+        }
+    }
+}
+#endif
+
+
+Jit::Jit()
+{
+#ifdef CHIP8_JIT_X64
+    void* memory = mmap(nullptr, ARENA_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    arena = (memory == MAP_FAILED) ? nullptr : static_cast<uint8_t*>(memory);
+#endif
+}
+
+Jit::~Jit()
+{
+#ifdef CHIP8_JIT_X64
+    if (arena)
+    {
+        munmap(arena, ARENA_SIZE);
+    }
+#endif
+}
+
+bool Jit::Supported()
+{
+#ifdef CHIP8_JIT_X64
+    return true;
+#else
+    return false;
+#endif
+}
+
+void Jit::Clear()
+{
+    std::fill(std::begin(translations), std::end(translations), Translation{});
+    std::fill(std::begin(hits), std::end(hits), 0);
+    std::fill(std::begin(coverage), std::end(coverage), 0);
+    arenaUsed = 0;
+}
+
+void Jit::Run(Chip8& chip8, unsigned int cycles)
+{
+    while (cycles > 0)
+    {
+        uint16_t pc = chip8.pc;
+
+        if (pc < MEMORY_SIZE - 1 && arena)
+        {
+            Translation& translation = translations[pc];
+
+            if (translation.state == State::Cold && ++hits[pc] >= HOT_THRESHOLD)
+            {
+                Translate(chip8, pc);
+            }
+
+            // a block has to run to the end once entered, so near the end of the budget we finish one instruction at a time
+            if (translation.state == State::Translated && translation.length <= cycles)
+            {
+                translation.code(chip8.registers);
+                chip8.cycleCount += translation.length; // native code doesnt produce per instruction trace records
+                cycles -= translation.length;
+                continue;
+            }
+        }
+
+        // cold code, untranslatable instructions and the tail of the budget go through the normal interpreter
+        chip8.Cycle();
+        --cycles;
+    }
+}
+
+void Jit::Release(uint16_t start)
+{
+    Translation& translation = translations[start];
+
+    if (translation.state == State::Translated)
+    {
+        for (unsigned int i = start; i < translation.end; ++i)
+        {
+            --coverage[i];
+        }
+    }
+
+    translation = Translation{};
+    hits[start] = 0;
+}
+
+void Jit::Invalidate(uint16_t address, uint16_t length)
+{
+    unsigned int first = address;
+    unsigned int last = std::min<unsigned int>(address + length, MEMORY_SIZE);
+
+    if (first >= last)
+    {
+        return;
+    }
+
+    // a translation only reads bytes from its own start onward, so an untranslatable mark is only stale if its first instruction changed
+    for (unsigned int i = (first > 0 ? first - 1 : 0); i < last; ++i)
+    {
+        if (translations[i].state == State::Untranslatable)
+        {
+            Release(static_cast<uint16_t>(i));
+        }
+    }
+
+    bool hitsCode = false;
+    for (unsigned int i = first; i < last; ++i)
+    {
+        if (coverage[i] != 0)
+        {
+            hitsCode = true;
+            break;
+        }
+    }
+
+    if (!hitsCode)
+    {
+        return;
+    }
+
+    // self modifying code, any translation overlapping the written bytes is now wrong
+    for (unsigned int start = 0; start < MEMORY_SIZE; ++start)
+    {
+        Translation const& translation = translations[start];
+
+        if (translation.state == State::Translated && start < last && translation.end > first)
+        {
+            Release(static_cast<uint16_t>(start));
+        }
+    }
+}
+
+void Jit::Translate(Chip8 const& chip8, uint16_t start)
+{
+#ifdef CHIP8_JIT_X64
+    // pass 1, collect the instructions and decide which host register each chip8 register lives in
+    std::vector<JitOp> ops;
+    bool used[REGISTER_COUNT]{};
+    bool written[REGISTER_COUNT]{};
+    unsigned int usedCount = 0;
+    uint16_t address = start;
+
+    while (ops.size() < MAX_BLOCK_LENGTH && address < MEMORY_SIZE - 1)
+    {
+        uint16_t opcode = (chip8.memory[address] << 8u) | chip8.memory[address + 1];
+
+        if (!Handled(opcode, chip8.quirks))
+        {
+            break;
+        }
+
+        bool opUsed[REGISTER_COUNT]{};
+        bool opWritten[REGISTER_COUNT]{};
+        RegistersUsed(opcode, opUsed, opWritten);
+
+        unsigned int newCount = usedCount;
+        for (unsigned int r = 0; r < REGISTER_COUNT; ++r)
+        {
+            if (opUsed[r] && !used[r])
+            {
+                ++newCount;
+            }
+        }
+
+        if (newCount > ALLOCATABLE_COUNT) // out of host registers, end the block before this instruction
+        {
+            break;
+        }
+
+        for (unsigned int r = 0; r < REGISTER_COUNT; ++r)
+        {
+            used[r] = used[r] || opUsed[r];
+            written[r] = written[r] || opWritten[r];
+        }
+        usedCount = newCount;
+
+        ops.push_back({opcode, address});
+        address += 2;
+
+        if (EndsBlock(opcode))
+        {
+            break;
+        }
+    }
+
+    Translation& translation = translations[start];
+
+    if (ops.empty())
+    {
+        translation.state = State::Untranslatable;
+        return;
+    }
+
+    uint8_t host[REGISTER_COUNT]{};
+    std::vector<uint8_t> calleeSaved;
+    unsigned int next = 0;
+    for (unsigned int r = 0; r < REGISTER_COUNT; ++r)
+    {
+        if (used[r])
+        {
+            host[r] = ALLOCATABLE[next++];
+            if (CalleeSaved(host[r]))
+            {
+                calleeSaved.push_back(host[r]);
+            }
+        }
+    }
+
+    // offsets of the other fields from registers[], the block only ever gets that one pointer
+    uintptr_t base = reinterpret_cast<uintptr_t>(chip8.registers);
+    int32_t indexOffset = static_cast<int32_t>(reinterpret_cast<uintptr_t>(&chip8.index) - base);
+    int32_t pcOffset = static_cast<int32_t>(reinterpret_cast<uintptr_t>(&chip8.pc) - base);
+
+    // pass 2, emit the code
+    Emitter e;
+
+    for (uint8_t reg : calleeSaved)
+    {
+        e.Push(reg);
+    }
+
+    for (unsigned int r = 0; r < REGISTER_COUNT; ++r)
+    {
+        if (used[r])
+        {
+            e.LoadByte(host[r], static_cast<int32_t>(r));
+        }
+    }
+
+    // writes the registers back, sets pc and returns, every way out of the block goes through one of these
+    auto exitTo = [&](uint16_t newPc)
+    {
+        for (unsigned int r = 0; r < REGISTER_COUNT; ++r)
+        {
+            if (written[r])
+            {
+                e.StoreByte(static_cast<int32_t>(r), host[r]);
+            }
+        }
+
+        e.StoreWordImm(pcOffset, newPc);
+
+        for (auto it = calleeSaved.rbegin(); it != calleeSaved.rend(); ++it)
+        {
+            e.Pop(*it);
+        }
+
+        e.Byte(0xC3); // ret
+    };
+
+    // a skip picks between two exits, the next instruction or the one after it
+    auto skipExit = [&](uint8_t skipCond, uint16_t address)
+    {
+        size_t patch = e.JumpIf(skipCond);
+        exitTo(address + 2);
+        e.PatchJumpHere(patch);
+        exitTo(address + 4);
+    };
+
+    bool exited = false;
+
+    for (JitOp const& op : ops)
+    {
+        uint16_t opcode = op.opcode;
+        uint8_t x = host[(opcode & 0x0F00u) >> 8u];
+        uint8_t y = host[(opcode & 0x00F0u) >> 4u];
+        uint8_t vf = host[0xF];
+        uint8_t kk = opcode & 0x00FFu;
+
+        // each case mirrors the order of reads and writes in the matching OP_* handler, including when x or y is VF
+        switch ((opcode & 0xF000u) >> 12u)
+        {
+            case 0x1:
+                exitTo(opcode & 0x0FFFu);
+                exited = true;
+                break;
+
+            case 0x3:
+                e.OpRegImm8(7, x, kk); // cmp
+                skipExit(COND_E, op.address);
+                exited = true;
+                break;
+
+            case 0x4:
+                e.OpRegImm8(7, x, kk);
+                skipExit(COND_NE, op.address);
+                exited = true;
+                break;
+
+            case 0x5:
+                e.OpRegReg8(0x38, x, y);
+                skipExit(COND_E, op.address);
+                exited = true;
+                break;
+
+            case 0x9:
+                e.OpRegReg8(0x38, x, y);
+                skipExit(COND_NE, op.address);
+                exited = true;
+                break;
+
+            case 0x6:
+                e.MovRegImm8(x, kk);
+                break;
+
+            case 0x7:
+                e.OpRegImm8(0, x, kk); // add
+                break;
+
+            case 0x8:
+                switch (opcode & 0x000Fu)
+                {
+                    case 0x0: e.OpRegReg8(0x88, x, y); break; // mov
+                    case 0x1: e.OpRegReg8(0x08, x, y); break; // or
+                    case 0x2: e.OpRegReg8(0x20, x, y); break; // and
+                    case 0x3: e.OpRegReg8(0x30, x, y); break; // xor
+
+                    case 0x4: // sum from the old values, then VF = carry, then Vx = sum
+                        e.OpRegReg8(0x88, RAX, x);
+                        e.OpRegReg8(0x00, RAX, y);
+                        e.SetCC(COND_C, vf);
+                        e.OpRegReg8(0x88, x, RAX);
+                        break;
+
+                    case 0x5: // VF = Vx > Vy, then Vx -= Vy
+                        e.OpRegReg8(0x38, x, y);
+                        e.SetCC(COND_A, RAX);
+                        e.OpRegReg8(0x88, vf, RAX);
+                        e.OpRegReg8(0x28, x, y);
+                        break;
+
+                    case 0x6: // VF = lsb of Vx, then Vx >>= 1
+                        e.OpRegReg8(0x88, RAX, x);
+                        e.OpRegImm8(4, RAX, 0x01);
+                        e.OpRegReg8(0x88, vf, RAX);
+                        e.ShiftOne8(5, x);
+                        break;
+
+                    case 0x7: // VF = Vy > Vx, then Vx = Vy - Vx
+                        e.OpRegReg8(0x38, y, x);
+                        e.SetCC(COND_A, RAX);
+                        e.OpRegReg8(0x88, vf, RAX);
+                        e.OpRegReg8(0x88, RAX, y);
+                        e.OpRegReg8(0x28, RAX, x);
+                        e.OpRegReg8(0x88, x, RAX);
+                        break;
+
+                    case 0xE: // VF = msb of Vx, then Vx <<= 1
+                        e.OpRegReg8(0x88, RAX, x);
+                        e.ShiftImm8(5, RAX, 7);
+                        e.OpRegReg8(0x88, vf, RAX);
+                        e.ShiftOne8(4, x);
+                        break;
+                }
+                break;
+
+            case 0xA:
+                e.StoreWordImm(indexOffset, opcode & 0x0FFFu);
+                break;
+
+            case 0xF: // Fx1E, index is 16 bits so the add wraps the same way as in OP_Fx1E
+                e.ZeroExtendToEax(x);
+                e.AddWordAx(indexOffset);
+                break;
+        }
+    }
+
+    if (!exited) // stopped at something the jit doesnt handle, or the block got too long, either way continue at the next address
+    {
+        exitTo(address);
+    }
+
+    // when the arena fills up, throw every translation away and start over
+    if (arenaUsed + e.code.size() > ARENA_SIZE)
+    {
+        Clear();
+    }
+
+    // keep the arena writable only while copying code in, executable the rest of the time
+    size_t page = 4096;
+    size_t firstPage = arenaUsed & ~(page - 1);
+    size_t lastByte = arenaUsed + e.code.size();
+    size_t protectLength = ((lastByte + page - 1) & ~(page - 1)) - firstPage;
+
+    mprotect(arena + firstPage, protectLength, PROT_READ | PROT_WRITE);
+    std::memcpy(arena + arenaUsed, e.code.data(), e.code.size());
+    mprotect(arena + firstPage, protectLength, PROT_READ | PROT_EXEC);
+
+    translation.code = reinterpret_cast<BlockFunc>(arena + arenaUsed);
+    translation.length = static_cast<uint16_t>(ops.size());
+    translation.end = address;
+    translation.state = State::Translated;
+
+    // keep code 16 byte aligned
+    arenaUsed = (lastByte + 15) & ~size_t(15);
+
+    for (unsigned int i = start; i < address; ++i)
+    {
+        ++coverage[i];
+    }
+#else
+    (void)chip8;
+    translations[start].state = State::Untranslatable;
+#endif
+}
@@ -0,0 +1,63 @@
+#ifndef JIT_HPP
+#define JIT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Chip8.hpp"
+
+
+// x86-64 dynamic recompiler
+// once the same pc has been reached HOT_THRESHOLD times, the straight line code starting there is translated into native code.
+// the chip8 registers used by the block live in host registers while it runs. the block exits back to Run at the first instruction
+// it doesnt translate (draws, timer reads, key checks, memory ops, calls...) and Run executes that one through Cycle and the OP_* handlers
+class Jit
+{
+public:
+	Jit();
+	~Jit();
+
+	Jit(Jit const&) = delete;
+	Jit& operator=(Jit const&) = delete;
+
+	static bool Supported(); // false when built without CHIP8_JIT or for a host that isnt x86-64
+
+	void Run(Chip8& chip8, unsigned int cycles);
+	void Invalidate(uint16_t address, uint16_t length); // forget every translation that covers any of these bytes
+	void Clear();
+
+private:
+	typedef void (*BlockFunc)(uint8_t* registers);
+
+	enum class State : uint8_t
+	{
+		Cold,         // not translated yet, still counting hits
+		Translated,
+		Untranslatable // first instruction isnt handled by the jit, dont try again until the code changes
+	};
+
+	struct Translation
+	{
+		BlockFunc code;
+		uint16_t length; // instructions executed by one call
+		uint16_t end;    // first address past the translated code
+		State state;
+	};
+
+	void Translate(Chip8 const& chip8, uint16_t start);
+	void Release(uint16_t start);
+
+	static const unsigned int HOT_THRESHOLD = 16;
+	static const unsigned int MAX_BLOCK_LENGTH = 64;
+	static const size_t ARENA_SIZE = 1 << 20;
+
+	Translation translations[MEMORY_SIZE]{};
+	uint16_t hits[MEMORY_SIZE]{};
+	uint16_t coverage[MEMORY_SIZE]{}; // how many live translations contain each byte
+
+	uint8_t* arena = nullptr; // executable memory the translations are written into
+	size_t arenaUsed = 0;
+};
+
+
+#endif
@@ -0,0 +1,705 @@
+#include "Lockstep.hpp"
+#include "SaveState.hpp"
+#include <algorithm>
+#include <cstring>
+
+
+// the kernels are built twice and the loader picks the AVX2 copy on cpus that have it, the rows are written with 32 byte vectors
+// so the AVX2 copy does a row block per instruction and the default copy does it as two SSE2 halves
+#if defined(__x86_64__) && defined(__linux__)
+#define CHIP8_LANE_KERNEL __attribute__((target_clones("avx2", "default")))
+#else
+#define CHIP8_LANE_KERNEL
+#endif
+
+// the vector helpers below are always inlined into the kernels, so the warning about returning 32 byte vectors without AVX never applies
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+namespace
+{
+    typedef uint8_t Bytes __attribute__((vector_size(32)));     // 32 lanes of a byte row
+    typedef int8_t ByteMask __attribute__((vector_size(32)));
+    typedef uint8_t HalfBytes __attribute__((vector_size(16))); // 16 lanes of a byte row, to line up with a word row
+    typedef int8_t HalfMask __attribute__((vector_size(16)));
+    typedef uint16_t Words __attribute__((vector_size(32)));    // 16 lanes of a 16 bit row
+    typedef int16_t WordMask __attribute__((vector_size(32)));
+    typedef uint32_t Keys __attribute__((vector_size(32)));     // 8 lanes of a 32 bit value
+
+    const unsigned int START_ADDRESS = 0x200;
+    const unsigned int FONTSET_START_ADDRESS = 0x50; // has to match Chip8.cpp
+
+    // rows are plain vectors with no alignment promise, memcpy compiles to one unaligned load or store
+    template <typename Vector, typename T>
+    inline Vector Load(T const* from)
+    {
+        Vector value;
+        std::memcpy(&value, from, sizeof(value));
+        return value;
+    }
+
+    template <typename Vector, typename T>
+    inline void Store(T* to, Vector const& value)
+    {
+        std::memcpy(to, &value, sizeof(value));
+    }
+}
+
+
+Lockstep::Lockstep(unsigned int laneCount)
+    : lanes(std::max(1u, laneCount))
+    , stride((lanes + LANE_BLOCK - 1) / LANE_BLOCK * LANE_BLOCK)
+    , registers(REGISTER_COUNT * stride)
+    , pc(stride)
+    , index(stride)
+    , delayTimer(stride)
+    , soundTimer(stride)
+    , sp(stride)
+    , stack(STACK_LEVELS * stride)
+    , video(VIDEO_HEIGHT * stride)
+    , keypad(KEY_COUNT * stride)
+    , randState(stride, 1)
+    , cycleCount(stride)
+    , memory(size_t(stride) * MEMORY_SIZE)
+    , remaining(stride)
+    , mask(stride)
+{
+    std::fill(pc.begin(), pc.end(), START_ADDRESS);
+}
+
+unsigned int Lockstep::Lanes() const
+{
+    return lanes;
+}
+
+uint64_t Lockstep::Steps() const
+{
+    return steps;
+}
+
+// let a real Chip8 load the rom, so the lanes start from exactly the machine it would have
+bool Lockstep::LoadROM(char const* filename)
+{
+    Chip8 loader;
+    if (!loader.LoadROM(filename))
+    {
+        return false;
+    }
+    Reset(loader);
+    return true;
+}
+
+bool Lockstep::LoadROM(uint8_t const* data, size_t size)
+{
+    Chip8 loader;
+    if (!loader.LoadROM(data, size))
+    {
+        return false;
+    }
+    Reset(loader);
+    return true;
+}
+
+void Lockstep::Reset(Chip8 const& loader)
+{
+    SaveState state;
+    loader.Save(state);
+
+    std::memcpy(code, state.memory, MEMORY_SIZE);
+    std::fill(std::begin(divergent), std::end(divergent), false);
+
+    for (unsigned int lane = 0; lane < lanes; ++lane)
+    {
+        Inject(lane, state);
+    }
+}
+
+void Lockstep::SetKey(unsigned int lane, unsigned int key, bool down)
+{
+    if (lane < lanes && key < KEY_COUNT)
+    {
+        keypad[key * stride + lane] = down ? 1 : 0;
+    }
+}
+
+bool Lockstep::Inject(unsigned int lane, SaveState const& state)
+{
+    if (lane >= lanes || std::memcmp(state.magic, "C8SS", 4) != 0 || state.version != SaveState::VERSION || state.size != sizeof(SaveState)
+        || state.rngState == 0)
+    {
+        return false;
+    }
+
+    for (unsigned int r = 0; r < REGISTER_COUNT; ++r)
+    {
+        registers[r * stride + lane] = state.registers[r];
+    }
+    for (unsigned int level = 0; level < STACK_LEVELS; ++level)
+    {
+        stack[level * stride + lane] = state.stack[level];
+    }
+    for (unsigned int row = 0; row < VIDEO_HEIGHT; ++row)
+    {
+        video[row * stride + lane] = state.video[row];
+    }
+    for (unsigned int key = 0; key < KEY_COUNT; ++key)
+    {
+        keypad[key * stride + lane] = state.keypad[key];
+    }
+
+    pc[lane] = state.pc;
+    index[lane] = state.index;
+    sp[lane] = state.sp;
+    delayTimer[lane] = state.delayTimer;
+    soundTimer[lane] = state.soundTimer;
+    randState[lane] = state.rngState;
+    cycleCount[lane] = state.cycleCount;
+
+    // a lane whose memory is not the shared image has to have those addresses fetched lane by lane
+    uint8_t* laneMemory = &memory[size_t(lane) * MEMORY_SIZE];
+    std::memcpy(laneMemory, state.memory, MEMORY_SIZE);
+    for (unsigned int address = 0; address < MEMORY_SIZE; ++address)
+    {
+        divergent[address] = divergent[address] || laneMemory[address] != code[address];
+    }
+
+    return true;
+}
+
+void Lockstep::Extract(unsigned int lane, SaveState& state) const
+{
+    std::memset(&state, 0, sizeof(state));
+
+    if (lane >= lanes)
+    {
+        return;
+    }
+
+    std::memcpy(state.magic, "C8SS", 4);
+    state.version = SaveState::VERSION;
+    state.size = sizeof(SaveState);
+    state.cycleCount = cycleCount[lane];
+
+    for (unsigned int r = 0; r < REGISTER_COUNT; ++r)
+    {
+        state.registers[r] = registers[r * stride + lane];
+    }
+    for (unsigned int level = 0; level < STACK_LEVELS; ++level)
+    {
+        state.stack[level] = stack[level * stride + lane];
+    }
+    for (unsigned int row = 0; row < VIDEO_HEIGHT; ++row)
+    {
+        state.video[row] = video[row * stride + lane];
+    }
+    for (unsigned int key = 0; key < KEY_COUNT; ++key)
+    {
+        state.keypad[key] = keypad[key * stride + lane];
+    }
+
+    std::memcpy(state.memory, &memory[size_t(lane) * MEMORY_SIZE], MEMORY_SIZE);
+    state.pc = pc[lane];
+    state.index = index[lane];
+    state.sp = sp[lane];
+    state.delayTimer = delayTimer[lane];
+    state.soundTimer = soundTimer[lane];
+    state.rngState = randState[lane];
+}
+
+void Lockstep::RunFrames(uint64_t frames, unsigned int instructionsPerFrame)
+{
+    for (uint64_t frame = 0; frame < frames; ++frame)
+    {
+        Run(instructionsPerFrame);
+        TickTimers();
+    }
+}
+
+void Lockstep::Run(unsigned int cycles)
+{
+    // remaining is 16 bits so the step picker can pack it next to a pc, longer runs go in pieces
+    while (cycles > 0)
+    {
+        uint16_t batch = static_cast<uint16_t>(std::min(cycles, 0xFFFFu));
+        cycles -= batch;
+
+        std::fill(remaining.begin(), remaining.begin() + lanes, batch);
+
+        uint16_t stepPc;
+        while (NextStep(stepPc))
+        {
+            uint16_t opcode = (code[stepPc & 0xFFFu] << 8u) | code[(stepPc + 1u) & 0xFFFu];
+
+            // somebody wrote over this instruction, so only the lanes that still hold the same one as the first lane can go together
+            if (divergent[stepPc & 0xFFFu] || divergent[(stepPc + 1u) & 0xFFFu])
+            {
+                int leader = -1;
+
+                for (unsigned int lane = 0; lane < lanes; ++lane)
+                {
+                    if (!mask[lane])
+                    {
+                        continue;
+                    }
+
+                    uint8_t const* laneMemory = &memory[size_t(lane) * MEMORY_SIZE];
+                    uint16_t laneOpcode = (laneMemory[stepPc & 0xFFFu] << 8u) | laneMemory[(stepPc + 1u) & 0xFFFu];
+
+                    if (leader < 0)
+                    {
+                        leader = static_cast<int>(lane);
+                        opcode = laneOpcode;
+                    }
+                    else if (laneOpcode != opcode)
+                    {
+                        // not this step after all, put back what NextStep took
+                        mask[lane] = 0;
+                        ++remaining[lane];
+                        pc[lane] -= 2;
+                    }
+                }
+            }
+
+            Execute(opcode);
+            ++steps;
+        }
+
+        for (unsigned int lane = 0; lane < lanes; ++lane)
+        {
+            cycleCount[lane] += batch;
+        }
+    }
+}
+
+// the lane with the most instructions left goes next, lowest pc first between equals. every lane at that pc with instructions left
+// joins the step, has one taken off remaining and its pc moved past the instruction, like Cycle does before calling a handler
+CHIP8_LANE_KERNEL
+bool Lockstep::NextStep(uint16_t& stepPc)
+{
+    // remaining in the top half and the inverted pc in the bottom half, so the largest key is the lane we want
+    Keys best = {};
+    for (unsigned int i = 0; i < stride; i += 8)
+    {
+        Keys left = __builtin_convertvector(Load<__attribute__((vector_size(16))) uint16_t>(&remaining[i]), Keys);
+        Keys at = __builtin_convertvector(Load<__attribute__((vector_size(16))) uint16_t>(&pc[i]), Keys);
+        Keys key = (left << 16) | (0xFFFFu - at);
+        best = (key > best) ? key : best;
+    }
+
+    uint32_t top = 0;
+    for (unsigned int i = 0; i < 8; ++i)
+    {
+        top = std::max(top, best[i]);
+    }
+
+    if ((top >> 16) == 0)
+    {
+        return false;
+    }
+
+    stepPc = static_cast<uint16_t>(0xFFFFu - (top & 0xFFFFu));
+
+    for (unsigned int i = 0; i < stride; i += 16)
+    {
+        Words at = Load<Words>(&pc[i]);
+        Words left = Load<Words>(&remaining[i]);
+        WordMask in = (at == stepPc) & (left != 0);
+
+        Store(&remaining[i], left + (Words)in);
+        Store(&pc[i], at + ((Words)in & 2));
+        Store(&mask[i], __builtin_convertvector(in, HalfMask));
+    }
+
+    return true;
+}
+
+CHIP8_LANE_KERNEL
+void Lockstep::TickTimers()
+{
+    for (unsigned int i = 0; i < stride; i += LANE_BLOCK)
+    {
+        // adding the -1 of a true compare counts a non zero timer down and leaves zero alone
+        Bytes delay = Load<Bytes>(&delayTimer[i]);
+        Store(&delayTimer[i], delay + (Bytes)(delay != 0));
+
+        Bytes sound = Load<Bytes>(&soundTimer[i]);
+        Store(&soundTimer[i], sound + (Bytes)(sound != 0));
+    }
+}
+
+void Lockstep::WriteMemory(unsigned int lane, unsigned int address, uint8_t value)
+{
+    address &= MEMORY_SIZE - 1;
+    memory[size_t(lane) * MEMORY_SIZE + address] = value;
+
+    if (value != code[address])
+    {
+        divergent[address] = true;
+    }
+}
+
+// every case does what the matching Chip8::OP_ handler does, in the same order, for each lane in mask. the opcode is the same for the
+// whole step so x, y, kk, nnn and n are plain numbers and each register operand is a whole row. instructions that only touch registers,
+// pc, index and the timers are SIMD over the rows, the ones that go through memory, the stack, the keypad or the screen at a per lane
+// position loop over the lanes instead
+CHIP8_LANE_KERNEL
+void Lockstep::Execute(uint16_t opcode)
+{
+    uint16_t nnn = opcode & 0x0FFFu;
+    uint8_t x = (opcode & 0x0F00u) >> 8u;
+    uint8_t y = (opcode & 0x00F0u) >> 4u;
+    uint8_t kk = opcode & 0x00FFu;
+    uint8_t n = opcode & 0x000Fu;
+
+    uint8_t* vx = &registers[x * stride];
+    uint8_t* vy = &registers[y * stride];
+    uint8_t* vf = &registers[0xF * stride];
+
+    // a per lane row with the lanes outside the step left alone
+    auto blend = [](Bytes const& in, Bytes const& value, Bytes const& old) -> Bytes { return (value & in) | (old & ~in); };
+    auto blendWords = [](Words const& in, Words const& value, Words const& old) -> Words { return (value & in) | (old & ~in); };
+
+    switch (opcode >> 12u)
+    {
+        case 0x0:
+        {
+            if (n == 0x0) // CLS
+            {
+                for (unsigned int lane = 0; lane < lanes; ++lane)
+                {
+                    if (mask[lane])
+                    {
+                        for (unsigned int row = 0; row < VIDEO_HEIGHT; ++row)
+                        {
+                            video[row * stride + lane] = 0;
+                        }
+                    }
+                }
+            }
+            else if (n == 0xE) // RET
+            {
+                for (unsigned int lane = 0; lane < lanes; ++lane)
+                {
+                    if (mask[lane])
+                    {
+                        --sp[lane];
+                        pc[lane] = stack[(sp[lane] & (STACK_LEVELS - 1)) * stride + lane];
+                    }
+                }
+            }
+        } break;
+
+        case 0x1: // JP
+        {
+            for (unsigned int i = 0; i < stride; i += 16)
+            {
+                Words in = (Words)__builtin_convertvector(Load<HalfMask>(&mask[i]), WordMask);
+                Store(&pc[i], blendWords(in, Words{} + nnn, Load<Words>(&pc[i])));
+            }
+        } break;
+
+        case 0x2: // CALL
+        {
+            for (unsigned int lane = 0; lane < lanes; ++lane)
+            {
+                if (mask[lane])
+                {
+                    stack[(sp[lane] & (STACK_LEVELS - 1)) * stride + lane] = pc[lane];
+                    ++sp[lane];
+                    pc[lane] = nnn;
+                }
+            }
+        } break;
+
+        // the skips compare 16 lanes of bytes at a time so the result lines up with 16 lanes of pc
+        case 0x3:
+        case 0x4:
+        case 0x5:
+        case 0x9:
+        {
+            unsigned int kind = opcode >> 12u;
+
+            for (unsigned int i = 0; i < stride; i += 16)
+            {
+                HalfBytes a = Load<HalfBytes>(&vx[i]);
+                HalfBytes b = (kind == 0x3 || kind == 0x4) ? HalfBytes{} + kk : Load<HalfBytes>(&vy[i]);
+                HalfMask skip = (kind == 0x3 || kind == 0x5) ? (HalfMask)(a == b) : (HalfMask)(a != b);
+                skip &= Load<HalfMask>(&mask[i]);
+
+                Words in = (Words)__builtin_convertvector(skip, WordMask);
+                Store(&pc[i], Load<Words>(&pc[i]) + (in & 2));
+            }
+        } break;
+
+        case 0x6: // LD Vx, byte
+        {
+            for (unsigned int i = 0; i < stride; i += LANE_BLOCK)
+            {
+                Bytes in = (Bytes)Load<ByteMask>(&mask[i]);
+                Store(&vx[i], blend(in, Bytes{} + kk, Load<Bytes>(&vx[i])));
+            }
+        } break;
+
+        case 0x7: // ADD Vx, byte
+        {
+            for (unsigned int i = 0; i < stride; i += LANE_BLOCK)
+            {
+                Bytes in = (Bytes)Load<ByteMask>(&mask[i]);
+                Store(&vx[i], Load<Bytes>(&vx[i]) + (in & kk));
+            }
+        } break;
+
+        case 0x8:
+        {
+            for (unsigned int i = 0; i < stride; i += LANE_BLOCK)
+            {
+                Bytes in = (Bytes)Load<ByteMask>(&mask[i]);
+                Bytes a = Load<Bytes>(&vx[i]);
+                Bytes b = Load<Bytes>(&vy[i]);
+
+                // the flag is written first and Vx last, and x or y can be 0xF, so Vx and Vy are read again after the flag like the
+                // handlers do
+                switch (n)
+                {
+                    case 0x0: Store(&vx[i], blend(in, b, a)); break;
+                    case 0x1: Store(&vx[i], blend(in, a | b, a)); break;
+                    case 0x2: Store(&vx[i], blend(in, a & b, a)); break;
+                    case 0x3: Store(&vx[i], blend(in, a ^ b, a)); break;
+
+                    case 0x4:
+                    {
+                        Bytes sum = a + b;
+                        Store(&vf[i], blend(in, (Bytes)(sum < a) & 1, Load<Bytes>(&vf[i])));
+                        Store(&vx[i], blend(in, sum, Load<Bytes>(&vx[i])));
+                    } break;
+
+                    case 0x5:
+                    {
+                        Store(&vf[i], blend(in, (Bytes)(a > b) & 1, Load<Bytes>(&vf[i])));
+                        a = Load<Bytes>(&vx[i]);
+                        b = Load<Bytes>(&vy[i]);
+                        Store(&vx[i], blend(in, a - b, a));
+                    } break;
+
+                    case 0x6:
+                    {
+                        Store(&vf[i], blend(in, a & 1, Load<Bytes>(&vf[i])));
+                        a = Load<Bytes>(&vx[i]);
+                        Store(&vx[i], blend(in, a >> 1, a));
+                    } break;
+
+                    case 0x7:
+                    {
+                        Store(&vf[i], blend(in, (Bytes)(b > a) & 1, Load<Bytes>(&vf[i])));
+                        a = Load<Bytes>(&vx[i]);
+                        b = Load<Bytes>(&vy[i]);
+                        Store(&vx[i], blend(in, b - a, a));
+                    } break;
+
+                    case 0xE:
+                    {
+                        Store(&vf[i], blend(in, a >> 7, Load<Bytes>(&vf[i])));
+                        a = Load<Bytes>(&vx[i]);
+                        Store(&vx[i], blend(in, a << 1, a));
+                    } break;
+
+                    default: break;
+                }
+            }
+        } break;
+
+        case 0xA: // LD I, address
+        {
+            for (unsigned int i = 0; i < stride; i += 16)
+            {
+                Words in = (Words)__builtin_convertvector(Load<HalfMask>(&mask[i]), WordMask);
+                Store(&index[i], blendWords(in, Words{} + nnn, Load<Words>(&index[i])));
+            }
+        } break;
+
+        case 0xB: // JP V0, address
+        {
+            uint8_t const* v0 = &registers[0];
+
+            for (unsigned int i = 0; i < stride; i += 16)
+            {
+                Words in = (Words)__builtin_convertvector(Load<HalfMask>(&mask[i]), WordMask);
+                Words target = __builtin_convertvector(Load<HalfBytes>(&v0[i]), Words) + nnn;
+                Store(&pc[i], blendWords(in, target, Load<Words>(&pc[i])));
+            }
+        } break;
+
+        case 0xC: // RND
+        {
+            for (unsigned int lane = 0; lane < lanes; ++lane)
+            {
+                if (mask[lane])
+                {
+                    vx[lane] = Chip8::RandomByte(randState[lane]) & kk;
+                }
+            }
+        } break;
+
+        case 0xD: // DRW, see Chip8::OP_Dxyn
+        {
+            for (unsigned int lane = 0; lane < lanes; ++lane)
+            {
+                if (!mask[lane])
+                {
+                    continue;
+                }
+
+                uint8_t const* laneMemory = &memory[size_t(lane) * MEMORY_SIZE];
+                uint8_t xPos = vx[lane] % VIDEO_WIDTH;
+                uint8_t yPos = vy[lane] % VIDEO_HEIGHT;
+
+                vf[lane] = 0;
+
+                unsigned int rows = (yPos + n > VIDEO_HEIGHT) ? VIDEO_HEIGHT - yPos : n;
+
+                for (unsigned int row = 0; row < rows; ++row)
+                {
+                    uint8_t spriteByte = laneMemory[(index[lane] + row) & (MEMORY_SIZE - 1)];
+                    uint64_t spriteRow = (xPos <= VIDEO_WIDTH - 8) ? uint64_t(spriteByte) << (VIDEO_WIDTH - 8 - xPos)
+                                                                  : uint64_t(spriteByte) >> (xPos - (VIDEO_WIDTH - 8));
+                    uint64_t& line = video[(yPos + row) * stride + lane];
+
+                    if (line & spriteRow)
+                    {
+                        vf[lane] = 1;
+                    }
+
+                    line ^= spriteRow;
+                }
+            }
+        } break;
+
+        case 0xE:
+        {
+            if (n != 0xE && n != 0x1)
+            {
+                break;
+            }
+
+            for (unsigned int lane = 0; lane < lanes; ++lane)
+            {
+                if (mask[lane])
+                {
+                    bool pressed = keypad[(vx[lane] & (KEY_COUNT - 1)) * stride + lane] != 0;
+
+                    if (pressed == (n == 0xE)) // SKP skips on pressed, SKNP on not pressed
+                    {
+                        pc[lane] += 2;
+                    }
+                }
+            }
+        } break;
+
+        case 0xF:
+        {
+            switch (kk)
+            {
+                case 0x07: // LD Vx, DT
+                {
+                    for (unsigned int i = 0; i < stride; i += LANE_BLOCK)
+                    {
+                        Bytes in = (Bytes)Load<ByteMask>(&mask[i]);
+                        Store(&vx[i], blend(in, Load<Bytes>(&delayTimer[i]), Load<Bytes>(&vx[i])));
+                    }
+                } break;
+
+                case 0x0A: // LD Vx, K, the lowest key held down, and nothing when none is
+                {
+                    for (unsigned int lane = 0; lane < lanes; ++lane)
+                    {
+                        if (!mask[lane])
+                        {
+                            continue;
+                        }
+
+                        for (unsigned int key = 0; key < KEY_COUNT; ++key)
+                        {
+                            if (keypad[key * stride + lane])
+                            {
+                                vx[lane] = static_cast<uint8_t>(key);
+                                break;
+                            }
+                        }
+                    }
+                } break;
+
+                case 0x15: // LD DT, Vx
+                case 0x18: // LD ST, Vx
+                {
+                    uint8_t* timer = (kk == 0x15) ? &delayTimer[0] : &soundTimer[0];
+
+                    for (unsigned int i = 0; i < stride; i += LANE_BLOCK)
+                    {
+                        Bytes in = (Bytes)Load<ByteMask>(&mask[i]);
+                        Store(&timer[i], blend(in, Load<Bytes>(&vx[i]), Load<Bytes>(&timer[i])));
+                    }
+                } break;
+
+                case 0x1E: // ADD I, Vx
+                case 0x29: // LD F, Vx
+                {
+                    for (unsigned int i = 0; i < stride; i += 16)
+                    {
+                        Words in = (Words)__builtin_convertvector(Load<HalfMask>(&mask[i]), WordMask);
+                        Words value = __builtin_convertvector(Load<HalfBytes>(&vx[i]), Words);
+                        Words old = Load<Words>(&index[i]);
+                        Words updated = (kk == 0x1E) ? old + value : FONTSET_START_ADDRESS + value * 5;
+                        Store(&index[i], blendWords(in, updated, old));
+                    }
+                } break;
+
+                case 0x33: // LD B, Vx
+                {
+                    for (unsigned int lane = 0; lane < lanes; ++lane)
+                    {
+                        if (mask[lane])
+                        {
+                            uint8_t value = vx[lane];
+                            WriteMemory(lane, index[lane] + 2u, value % 10);
+                            value /= 10;
+                            WriteMemory(lane, index[lane] + 1u, value % 10);
+                            value /= 10;
+                            WriteMemory(lane, index[lane], value % 10);
+                        }
+                    }
+                } break;
+
+                case 0x55: // LD [I], Vx
+                {
+                    for (unsigned int lane = 0; lane < lanes; ++lane)
+                    {
+                        if (mask[lane])
+                        {
+                            for (unsigned int r = 0; r <= x; ++r)
+                            {
+                                WriteMemory(lane, index[lane] + r, registers[r * stride + lane]);
+                            }
+                        }
+                    }
+                } break;
+
+                case 0x65: // LD Vx, [I]
+                {
+                    for (unsigned int lane = 0; lane < lanes; ++lane)
+                    {
+                        if (mask[lane])
+                        {
+                            uint8_t const* laneMemory = &memory[size_t(lane) * MEMORY_SIZE];
+
+                            for (unsigned int r = 0; r <= x; ++r)
+                            {
+                                registers[r * stride + lane] = laneMemory[(index[lane] + r) & (MEMORY_SIZE - 1)];
+                            }
+                        }
+                    }
+                } break;
+
+                default: break;
+            }
+        } break;
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef LOCKSTEP_HPP
+#define LOCKSTEP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Chip8.hpp"
+
+
+// many copies of one rom stepped together, for batch work like fuzzing or reinforcement learning where every copy runs the same code
+// with different inputs
+// the machines are stored struct of arrays, register V3 of every lane is one contiguous row and so are pc, index, the timers and each
+// row of the screens. a step executes one instruction for every lane sitting at the same pc, as SIMD over those rows (AVX2 where the cpu
+// has it, SSE2 otherwise), with lanes at any other pc masked out. the lanes furthest behind always go next, so lanes that branched apart
+// catch up on their own path and tend to fall back into step where the paths join
+//
+// each lane gives exactly the results a Chip8 would, Inject and Extract move a machine between the two through a SaveState.
+// the one difference is that stack, memory and keypad accesses that would run off the end of their arrays wrap round instead
+// needs GCC or Clang, the rows are processed with their vector extensions
+class Lockstep
+{
+public:
+	static const unsigned int LANE_BLOCK = 32; // lanes are processed this many at a time, one AVX2 register of bytes
+
+	explicit Lockstep(unsigned int lanes);
+
+	bool LoadROM(char const* filename); // every lane is reset to a fresh machine with this rom loaded, false leaves the lanes alone
+	bool LoadROM(uint8_t const* data, size_t size);
+	void Run(unsigned int cycles);      // every lane executes exactly this many instructions
+	void TickTimers();
+	void RunFrames(uint64_t frames, unsigned int instructionsPerFrame); // the same as a Scheduler at instructionsPerFrame * 60 per second
+
+	void SetKey(unsigned int lane, unsigned int key, bool down);
+	bool Inject(unsigned int lane, SaveState const& state); // false (and nothing changes) for a bad lane, magic, version, size or an rng state of 0. sp, pc and I wrap in a lane, so any value is safe
+	void Extract(unsigned int lane, SaveState& state) const;
+
+	unsigned int Lanes() const;
+	uint64_t Steps() const; // steps run so far, instructions across all lanes / (Steps * Lanes) is how well the lanes kept together
+
+private:
+	bool NextStep(uint16_t& stepPc); // picks the pc to run next and masks in the lanes at it, false once no lane has cycles left
+	void Execute(uint16_t opcode);   // one instruction for every lane in mask, their pc has already moved past it
+	void WriteMemory(unsigned int lane, unsigned int address, uint8_t value);
+	void Reset(Chip8 const& loader); // every lane becomes a copy of loader
+
+	unsigned int lanes;
+	unsigned int stride; // lanes rounded up to LANE_BLOCK, the length of every row
+
+	// one row of stride entries per register, stack level, screen row and key
+	std::vector<uint8_t> registers;
+	std::vector<uint16_t> pc;
+	std::vector<uint16_t> index;
+	std::vector<uint8_t> delayTimer;
+	std::vector<uint8_t> soundTimer;
+	std::vector<uint8_t> sp;
+	std::vector<uint16_t> stack;
+	std::vector<uint64_t> video;
+	std::vector<uint8_t> keypad;
+	std::vector<uint32_t> randState; // each lanes xorshift32 state, the same generator Chip8 uses
+	std::vector<uint64_t> cycleCount;
+
+	// memory is the exception, a whole MEMORY_SIZE block per lane, since every lane reads and writes it at its own index anyway
+	std::vector<uint8_t> memory;
+
+	// instructions are fetched once per step from the image every lane started with, unless some lane has written over that address
+	uint8_t code[MEMORY_SIZE]{};
+	bool divergent[MEMORY_SIZE]{};
+
+	std::vector<uint16_t> remaining; // instructions each lane still has to run in this Run
+	std::vector<int8_t> mask;        // -1 for the lanes in the current step, 0 for the rest
+	uint64_t steps = 0;
+};
+
+
+#endif
@@ -0,0 +1,170 @@
+#include "Movie.hpp"
+#include "SaveState.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+
+uint64_t Movie::RomHash(Chip8 const& chip8)
+{
+    SaveState state;
+    chip8.Save(state);
+
+    uint64_t hash = 14695981039346656037ull;
+    for (uint8_t byte : state.memory)
+    {
+        hash = (hash ^ byte) * 1099511628211ull;
+    }
+    return hash;
+}
+
+void Movie::Start(Chip8 const& chip8, uint32_t seed, unsigned int instructionsPerSecond)
+{
+    std::memcpy(header.magic, "C8MV", 4);
+    header.version = MovieHeader::VERSION;
+    header.seed = seed;
+    header.instructionsPerSecond = instructionsPerSecond;
+    header.romHash = RomHash(chip8);
+    header.endCycle = chip8.CycleCount();
+    header.eventCount = 0;
+    header.quirks = chip8.GetQuirks().Bits();
+
+    events.clear();
+    std::memset(lastKeypad, 0, sizeof(lastKeypad));
+    next = 0;
+
+    Record(chip8); // keys already held when recording starts
+}
+
+void Movie::Record(Chip8 const& chip8)
+{
+    for (unsigned int key = 0; key < KEY_COUNT; ++key)
+    {
+        uint8_t down = chip8.keypad[key] ? 1 : 0;
+
+        if (down != lastKeypad[key])
+        {
+            events.push_back(MovieEvent{chip8.CycleCount(), static_cast<uint8_t>(key), down, {}});
+            lastKeypad[key] = down;
+        }
+    }
+}
+
+void Movie::Stop(Chip8 const& chip8)
+{
+    Record(chip8);
+    header.endCycle = chip8.CycleCount();
+    header.eventCount = events.size();
+}
+
+bool Movie::Save(char const* path) const
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+    file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+    file.write(reinterpret_cast<char const*>(events.data()), events.size() * sizeof(MovieEvent));
+
+    return file.good();
+}
+
+bool Movie::Load(char const* path)
+{
+    std::ifstream file(path, std::ios::binary);
+
+    // the version 1 header first, the rest of the header only if the file has one
+    const size_t VERSION_1_SIZE = offsetof(MovieHeader, quirks);
+    MovieHeader loaded{};
+    if (!file.read(reinterpret_cast<char*>(&loaded), VERSION_1_SIZE)
+        || std::memcmp(loaded.magic, "C8MV", 4) != 0 || loaded.version < 1 || loaded.version > MovieHeader::VERSION)
+    {
+        return false;
+    }
+
+    if (loaded.version >= 2 && !file.read(reinterpret_cast<char*>(&loaded) + VERSION_1_SIZE, sizeof(loaded) - VERSION_1_SIZE))
+    {
+        return false;
+    }
+
+    // check the count against what is actually in the file before allocating for it
+    std::streampos eventsStart = file.tellg();
+    file.seekg(0, std::ios::end);
+    uint64_t available = static_cast<uint64_t>(file.tellg() - eventsStart) / sizeof(MovieEvent);
+    file.seekg(eventsStart);
+
+    if (loaded.eventCount > available)
+    {
+        return false;
+    }
+
+    std::vector<MovieEvent> loadedEvents(loaded.eventCount);
+    if (!file.read(reinterpret_cast<char*>(loadedEvents.data()), loadedEvents.size() * sizeof(MovieEvent)))
+    {
+        return false;
+    }
+
+    header = loaded;
+    header.version = MovieHeader::VERSION; // saved again it is a current movie
+    events.swap(loadedEvents);
+    next = 0;
+    return true;
+}
+
+bool Movie::Matches(Chip8 const& chip8) const
+{
+    return RomHash(chip8) == header.romHash;
+}
+
+void Movie::Apply(Chip8& chip8)
+{
+    while (next < events.size() && events[next].cycle <= chip8.CycleCount())
+    {
+        chip8.keypad[events[next].key & (KEY_COUNT - 1)] = events[next].down;
+        ++next;
+    }
+}
+
+// run straight from one keypad change to the next, the scheduler ticks the timers on the same cycles it did while recording
+void Movie::Replay(Chip8& chip8, Scheduler& scheduler)
+{
+    next = 0;
+
+    while (chip8.CycleCount() < header.endCycle)
+    {
+        Apply(chip8);
+
+        uint64_t until = header.endCycle;
+        if (next < events.size())
+        {
+            until = std::min(until, events[next].cycle);
+        }
+
+        scheduler.RunInstructions(until - chip8.CycleCount());
+    }
+
+    Apply(chip8); // changes on the very last cycle, so the keypad ends up as it was recorded
+}
+
+uint32_t Movie::Seed() const
+{
+    return header.seed;
+}
+
+Quirks Movie::GetQuirks() const
+{
+    return Quirks::FromBits(header.quirks);
+}
+
+unsigned int Movie::InstructionsPerSecond() const
+{
+    return header.instructionsPerSecond;
+}
+
+uint64_t Movie::EndCycle() const
+{
+    return header.endCycle;
+}
+
+size_t Movie::EventCount() const
+{
+    return events.size();
+}
@@ -0,0 +1,75 @@
+#ifndef MOVIE_HPP
+#define MOVIE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Chip8.hpp"
+#include "Scheduler.hpp"
+
+
+// input movie, the seed plus every keypad change stamped with the cycle count it happened at
+// a run from power on is decided completely by the rom, its quirks, the seed, the cpu speed (which picks the cycles the timers tick on)
+// and the keypad, so replaying a movie gives the recorded run back bit for bit, as fast as the host can go
+//
+// file layout: MovieHeader, then eventCount MovieEvents. multi byte fields are in the hosts byte order
+struct MovieHeader
+{
+	static const uint32_t VERSION = 2; // version 1 ended at eventCount and is still read, as a movie with the default quirks
+
+	char magic[4];                 // "C8MV"
+	uint32_t version;
+	uint32_t seed;
+	uint32_t instructionsPerSecond;
+	uint64_t romHash;              // of memory straight after LoadROM, so a movie isnt played against the wrong rom
+	uint64_t endCycle;             // cycle count when recording stopped
+	uint64_t eventCount;
+	uint8_t quirks;                // Quirks::Bits
+	uint8_t reserved[7];
+};
+
+struct MovieEvent
+{
+	uint64_t cycle; // the instruction with this cycle count is the first to see the change
+	uint8_t key;
+	uint8_t down;
+	uint8_t reserved[6];
+};
+
+static_assert(sizeof(MovieHeader) == 48, "movie layout changed");
+static_assert(sizeof(MovieEvent) == 16, "movie layout changed");
+
+
+class Movie
+{
+public:
+	static uint64_t RomHash(Chip8 const& chip8); // FNV-1a of the whole of memory
+
+	// recording, Start right after LoadROM, SetQuirks and Seed
+	void Start(Chip8 const& chip8, uint32_t seed, unsigned int instructionsPerSecond);
+	void Record(Chip8 const& chip8); // after anything that may have changed the keypad, adds an event for every key that differs from last time
+	void Stop(Chip8 const& chip8);
+	bool Save(char const* path) const;
+
+	// playback
+	bool Load(char const* path); // false for a missing, truncated or wrong version file
+	bool Matches(Chip8 const& chip8) const; // the rom loaded in chip8 is the one the movie was recorded on
+	void Replay(Chip8& chip8, Scheduler& scheduler); // from power on up to EndCycle, feeding the keypad changes in as it goes
+
+	uint32_t Seed() const;
+	Quirks GetQuirks() const; // set them on the machine before Replay
+	unsigned int InstructionsPerSecond() const;
+	uint64_t EndCycle() const;
+	size_t EventCount() const;
+
+private:
+	void Apply(Chip8& chip8); // every event up to the current cycle count
+
+	MovieHeader header{};
+	std::vector<MovieEvent> events;
+	uint8_t lastKeypad[KEY_COUNT]{}; // what Record saw last time
+	size_t next = 0;                 // first event Replay hasnt applied yet
+};
+
+
+#endif
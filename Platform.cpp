@@ -1,17 +1,21 @@
 #include "Platform.hpp"
+#include <thread>
 
-Platform::Platform(char const* title, int windowWidth, int windowHeight, int textureWidth, int textureHeight) // constructor for the platform class, takes in arguments
+Platform::Platform(char const* title, int windowWidth, int windowHeight, int textureWidth, int textureHeight, bool softwareRenderer) // constructor for the platform class, takes in arguments
 // the platform class is used to handle how the emulator interacts with my operating system
 //	it handles
 // 		creating the window on the screen where the game will be displayed
 // 		updating the window with what should be drawn on the screen
 // 		checking if any keys on the keyboard are being pressed
+	: textureWidth(textureWidth)
 {
 	SDL_Init(SDL_INIT_VIDEO); // initializes the sdl video system
 
+	frameEvent = SDL_RegisterEvents(1); // NotifyFrame wakes PumpInput with one of these
+
 	window = SDL_CreateWindow(title, 0, 0, windowWidth, windowHeight, SDL_WINDOW_SHOWN); // creates an sdl window with the specific title, dimensions, and flags
 
-	renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED); // creates an sdl renderer, which is used for drawing graphics to the window
+	renderer = SDL_CreateRenderer(window, -1, softwareRenderer ? SDL_RENDERER_SOFTWARE : SDL_RENDERER_ACCELERATED); // creates an sdl renderer, which is used for drawing graphics to the window
 
 	texture = SDL_CreateTexture(
 		renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, textureWidth, textureHeight); // creates an sdl texture, which is a surface that can be drawn to then rendered to the window, sdl_...8888 specifies that
@@ -27,210 +31,103 @@ Platform::~Platform() // destructor for the Platform class, its called automatic
 	SDL_Quit();
 }
 
-void Platform::Update(void const* buffer, int pitch) // function takes in a buffer (a pointer to a pixel data) and a pitch (the width of a row in bytes) as arguments
+// only the rows that changed are copied into the texture, the rest of the texture keeps what it had
+void Platform::UpdateRows(void const* buffer, int pitch, int firstRow, int rowCount)
 {
-	SDL_UpdateTexture(texture, nullptr, buffer, pitch); // updates sdl texture with new pixel data from buffer
-	SDL_RenderClear(renderer); // clears the renderer with a default color, usually black
-	SDL_RenderCopy(renderer, texture, nullptr, nullptr); // copies the texture to the renderer
-	SDL_RenderPresent(renderer); // presents the rendered graphics to the window
-}// this function effectivly draws the contents of the buffer to the screen
+	SDL_Rect rows{0, firstRow, textureWidth, rowCount}; // the strip of the texture being replaced
+	uint8_t const* firstPixel = static_cast<uint8_t const*>(buffer) + firstRow * pitch; // SDL reads the strip starting from this pointer
+
+	SDL_UpdateTexture(texture, &rows, firstPixel, pitch);
+	SDL_RenderClear(renderer);
+	SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+	SDL_RenderPresent(renderer);
+}
 
 
-// this function ahndles specific key presses and releases, mapping them to the keys array, each key corresponds to an index in the array. for example, if the x key is pressed, key[0] = 1, if it is released key[0] = 0
-bool Platform::ProcessInput(uint8_t* keys)// this function takes a pointer to an array of uint8_t named keys as an argument, this array will be used to store the state of the Chip8 keys
+// keyboard keys for chip8 keys 0 to F, the left hand block of a qwerty keyboard laid out like the original hex keypad
+//	1 2 3 4        1 2 3 C
+//	q w e r   ->   4 5 6 D
+//	a s d f        7 8 9 E
+//	z x c v        A 0 B F
+static SDL_Keycode const keymap[16] =
 {
-	bool quit = false; // initializes a boolean variable quit to flase, used to indicate whether the user wants to quit the emulator
+	SDLK_x, SDLK_1, SDLK_2, SDLK_3, SDLK_q, SDLK_w, SDLK_e, SDLK_a,
+	SDLK_s, SDLK_d, SDLK_z, SDLK_c, SDLK_4, SDLK_r, SDLK_f, SDLK_v,
+};
 
-	SDL_Event event; // declares and sdlevent variable to store info about events (like keyboard presses, window events)
+// SDL only delivers window events to the thread that created the window, so this runs there and the emulation gets the key changes
+// through the queue. it sleeps in SDL_WaitEvent until something happens, the emulation thread never waits on the event pump
+bool Platform::PumpInput(InputQueue& queue, bool& frameReady)
+{
+	bool quit = false;
+	frameReady = false;
 
-	while (SDL_PollEvent(&event)) // this loop proccesses events in the sdl event queue
-	// SDL_PollEvent gets the next event from the queue
+	// keys only ever change here, so the emulation thread always drains the queue eventually and a full queue only means waiting a moment
+	auto push = [&queue](InputEvent const& input)
 	{
-		switch (event.type) // handles different event types
+		while (!queue.Push(input))
 		{
-			case SDL_QUIT: // indicates the user has requested to quit
-			{
-				quit = true;
-			} break;
-
-			case SDL_KEYDOWN: // indicates that a key has been pressed down
-			{
-				switch (event.key.keysym.sym)
-				{
-					case SDLK_ESCAPE:
-					{
-						quit = true;
-					} break;
-
-					case SDLK_x:
-					{
-						keys[0] = 1;
-					} break;
-
-					case SDLK_1:
-					{
-						keys[1] = 1;
-					} break;
-
-					case SDLK_2:
-					{
-						keys[2] = 1;
-					} break;
-
-					case SDLK_3:
-					{
-						keys[3] = 1;
-					} break;
-
-					case SDLK_q:
-					{
-						keys[4] = 1;
-					} break;
-
-					case SDLK_w:
-					{
-						keys[5] = 1;
-					} break;
-
-					case SDLK_e:
-					{
-						keys[6] = 1;
-					} break;
-
-					case SDLK_a:
-					{
-						keys[7] = 1;
-					} break;
-
-					case SDLK_s:
-					{
-						keys[8] = 1;
-					} break;
-
-					case SDLK_d:
-					{
-						keys[9] = 1;
-					} break;
-
-					case SDLK_z:
-					{
-						keys[0xA] = 1;
-					} break;
-
-					case SDLK_c:
-					{
-						keys[0xB] = 1;
-					} break;
-
-					case SDLK_4:
-					{
-						keys[0xC] = 1;
-					} break;
-
-					case SDLK_r:
-					{
-						keys[0xD] = 1;
-					} break;
+			std::this_thread::yield();
+		}
+	};
 
-					case SDLK_f:
-					{
-						keys[0xE] = 1;
-					} break;
+	SDL_Event event;
+	if (!SDL_WaitEvent(&event))
+	{
+		return quit;
+	}
 
-					case SDLK_v:
-					{
-						keys[0xF] = 1;
-					} break;
-				}
-			} break;
+	do
+	{
+		if (event.type == SDL_QUIT)
+		{
+			quit = true;
+		}
+		else if ((event.type == SDL_KEYDOWN || event.type == SDL_KEYUP) && !event.key.repeat) // held keys repeat, only the changes matter
+		{
+			uint8_t down = (event.type == SDL_KEYDOWN) ? 1 : 0;
+			SDL_Keycode sym = event.key.keysym.sym;
 
-			case SDL_KEYUP: // indicates that a key has been released
+			if (sym == SDLK_ESCAPE)
 			{
-				switch (event.key.keysym.sym)
+				quit = quit || (down != 0);
+			}
+			else if (sym == SDLK_BACKSPACE) // held down to run the game backwards
+			{
+				push(InputEvent{InputEvent::REWIND, 0, down});
+			}
+			else
+			{
+				for (uint8_t key = 0; key < 16; ++key)
 				{
-					case SDLK_x:
-					{
-						keys[0] = 0;
-					} break;
-
-					case SDLK_1:
-					{
-						keys[1] = 0;
-					} break;
-
-					case SDLK_2:
-					{
-						keys[2] = 0;
-					} break;
-
-					case SDLK_3:
-					{
-						keys[3] = 0;
-					} break;
-
-					case SDLK_q:
-					{
-						keys[4] = 0;
-					} break;
-
-					case SDLK_w:
-					{
-						keys[5] = 0;
-					} break;
-
-					case SDLK_e:
-					{
-						keys[6] = 0;
-					} break;
-
-					case SDLK_a:
-					{
-						keys[7] = 0;
-					} break;
-
-					case SDLK_s:
-					{
-						keys[8] = 0;
-					} break;
-
-					case SDLK_d:
-					{
-						keys[9] = 0;
-					} break;
-
-					case SDLK_z:
-					{
-						keys[0xA] = 0;
-					} break;
-
-					case SDLK_c:
-					{
-						keys[0xB] = 0;
-					} break;
-
-					case SDLK_4:
-					{
-						keys[0xC] = 0;
-					} break;
-
-					case SDLK_r:
-					{
-						keys[0xD] = 0;
-					} break;
-
-					case SDLK_f:
+					if (keymap[key] == sym)
 					{
-						keys[0xE] = 0;
-					} break;
-
-					case SDLK_v:
-					{
-						keys[0xF] = 0;
-					} break;
+						push(InputEvent{InputEvent::KEY, key, down});
+						break;
+					}
 				}
-			} break;
+			}
+		}
+		else if (event.type == frameEvent)
+		{
+			framePending.store(false, std::memory_order_relaxed);
+			frameReady = true;
 		}
 	}
+	while (SDL_PollEvent(&event)); // everything else that piled up while we were away
 
 	return quit;
-}
\ No newline at end of file
+}
+
+// SDL_PushEvent is safe from any thread, and at most one frame event is ever waiting in the SDL queue
+void Platform::NotifyFrame()
+{
+	if (framePending.exchange(true, std::memory_order_relaxed))
+	{
+		return;
+	}
+
+	SDL_Event event{};
+	event.type = frameEvent;
+	SDL_PushEvent(&event);
+}
@@ -2,21 +2,48 @@
 #define PLATFORM_HPP
 
 #include <SDL.h>
+#include <atomic>
 #include <cstdint>
+#include "SpscQueue.hpp"
+
+
+// a change on the keyboard, collected on the thread that owns the window and applied by the emulation thread between frames
+struct InputEvent
+{
+    enum Kind : uint8_t
+    {
+        KEY,    // key is the chip8 key, 0 to F
+        REWIND, // backspace
+    };
+
+    uint8_t kind;
+    uint8_t key;
+    uint8_t down;
+};
+
+using InputQueue = SpscQueue<InputEvent, 256>;
 
 class Platform
 {
 public:
-    Platform(char const* title, int windowWidth, int windowHeight, int textureWidth, int textureHeight);
+    // softwareRenderer draws without the gpu, then the texture should already be the size of the window (see Scaler.hpp)
+    Platform(char const* title, int windowWidth, int windowHeight, int textureWidth, int textureHeight, bool softwareRenderer = false);
     ~Platform();
 
-    void Update(void const* buffer, int pitch);
-    bool ProcessInput(uint8_t* keys);
+    void UpdateRows(void const* buffer, int pitch, int firstRow, int rowCount); // uploads only these rows of buffer, then presents
+
+    // waits for window events and pushes every key change onto queue, true once the user asks to quit
+    // frameReady is set when NotifyFrame was called since the last time, only call this from the thread that made the Platform
+    bool PumpInput(InputQueue& queue, bool& frameReady);
+    void NotifyFrame(); // from any thread, wakes PumpInput
 
 private:
     SDL_Window* window{};
     SDL_Renderer* renderer{};
     SDL_Texture* texture{};
+    int textureWidth{};
+    Uint32 frameEvent{};
+    std::atomic<bool> framePending{false};
 };
 
 #endif
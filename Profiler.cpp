@@ -0,0 +1,245 @@
+#include "Profiler.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <ostream>
+#include <string>
+
+
+Profiler::Profiler()
+    : recentFrames(FRAME_HISTORY)
+{
+    std::fill(std::begin(familyAt), std::end(familyAt), 0);
+    Reset();
+}
+
+void Profiler::Reset()
+{
+    std::fill(std::begin(pcCounts), std::end(pcCounts), 0);
+    std::fill(std::begin(settledCounts), std::end(settledCounts), 0);
+    std::fill(std::begin(familyCounts), std::end(familyCounts), 0);
+    draws = 0;
+    drawRows = 0;
+
+    lastFrameCycle = 0;
+    frameCount = 0;
+    frameMin = UINT64_MAX;
+    frameMax = 0;
+    frameTotal = 0;
+    std::fill(recentFrames.begin(), recentFrames.end(), 0);
+
+    paths.assign(1, CallPath{0, 0, 0});
+    children.clear();
+    std::fill(std::begin(childCache), std::end(childCache), CachedChild{UINT64_MAX, 0});
+    currentPath = 0;
+    pathStart = 0;
+    overflow = 0;
+}
+
+void Profiler::CodeChanged(uint16_t address, uint8_t family)
+{
+    address &= ADDRESS_COUNT - 1;
+    familyCounts[familyAt[address]] += pcCounts[address] - settledCounts[address];
+    settledCounts[address] = pcCounts[address];
+    familyAt[address] = family & (FAMILY_COUNT - 1);
+}
+
+void Profiler::Settle(uint64_t cycle)
+{
+    paths[currentPath].instructions += cycle - pathStart;
+    pathStart = cycle;
+}
+
+void Profiler::Call(uint64_t cycle, uint16_t routine)
+{
+    Settle(cycle);
+
+    uint64_t key = (uint64_t(currentPath) << 16) | routine;
+    CachedChild& cached = childCache[(routine ^ (currentPath * 0x9E37u)) & (CHILD_CACHE_SIZE - 1)];
+
+    if (cached.key == key)
+    {
+        currentPath = cached.path;
+        return;
+    }
+
+    auto found = children.find(key);
+
+    if (found != children.end())
+    {
+        currentPath = found->second;
+        cached = CachedChild{key, currentPath};
+    }
+    else if (paths.size() < MAX_CALL_PATHS)
+    {
+        uint32_t path = static_cast<uint32_t>(paths.size());
+        paths.push_back(CallPath{currentPath, routine, 0});
+        children.emplace(key, path);
+        cached = CachedChild{key, path};
+        currentPath = path;
+    }
+    else
+    {
+        ++overflow;
+    }
+}
+
+void Profiler::Return(uint64_t cycle)
+{
+    Settle(cycle);
+
+    if (overflow > 0)
+    {
+        --overflow;
+    }
+    else if (currentPath != 0)
+    {
+        currentPath = paths[currentPath].parent;
+    }
+}
+
+void Profiler::Frame(uint64_t cycle)
+{
+    uint64_t instructions = cycle - lastFrameCycle;
+    lastFrameCycle = cycle;
+
+    recentFrames[frameCount % FRAME_HISTORY] = static_cast<uint32_t>(std::min<uint64_t>(instructions, UINT32_MAX));
+    ++frameCount;
+    frameMin = std::min(frameMin, instructions);
+    frameMax = std::max(frameMax, instructions);
+    frameTotal += instructions;
+}
+
+// the stack this chip8 had before is gone, whatever it runs next is counted from the root again
+void Profiler::Jump(uint64_t from, uint64_t to)
+{
+    Settle(from);
+    currentPath = 0;
+    overflow = 0;
+    pathStart = to;
+    lastFrameCycle = to;
+}
+
+uint64_t Profiler::Instructions() const
+{
+    uint64_t total = 0;
+    for (uint64_t count : pcCounts)
+    {
+        total += count;
+    }
+    return total;
+}
+
+uint64_t Profiler::PcCount(uint16_t pc) const
+{
+    return pcCounts[pc & (ADDRESS_COUNT - 1)];
+}
+
+uint64_t Profiler::FamilyCount(uint8_t family) const
+{
+    family &= FAMILY_COUNT - 1;
+    uint64_t count = familyCounts[family];
+
+    for (unsigned int address = 0; address < ADDRESS_COUNT; ++address)
+    {
+        if (familyAt[address] == family)
+        {
+            count += pcCounts[address] - settledCounts[address];
+        }
+    }
+    return count;
+}
+
+uint64_t Profiler::Draws() const
+{
+    return draws;
+}
+
+namespace
+{
+    std::string Hex(unsigned int value, int digits)
+    {
+        char text[16];
+        std::snprintf(text, sizeof(text), "0x%0*X", digits, value);
+        return text;
+    }
+}
+
+void Profiler::WriteJson(std::ostream& out, char const* const* familyNames, unsigned int familyCount, unsigned int hotspots) const
+{
+    out << "{\n";
+    out << "  \"version\": 1,\n";
+    out << "  \"instructions\": " << Instructions() << ",\n";
+
+    out << "  \"families\": {";
+    bool first = true;
+    unsigned int families = (familyCount < FAMILY_COUNT) ? familyCount : FAMILY_COUNT; // not std::min, that would need FAMILY_COUNT defined out of the class
+    for (unsigned int family = 0; family < families; ++family)
+    {
+        uint64_t count = FamilyCount(static_cast<uint8_t>(family));
+        if (count == 0)
+        {
+            continue;
+        }
+        out << (first ? "\n" : ",\n") << "    \"" << familyNames[family] << "\": " << count;
+        first = false;
+    }
+    out << "\n  },\n";
+
+    // the busiest addresses first, and only the ones that ran at all
+    std::vector<uint16_t> order;
+    for (unsigned int pc = 0; pc < ADDRESS_COUNT; ++pc)
+    {
+        if (pcCounts[pc] != 0)
+        {
+            order.push_back(static_cast<uint16_t>(pc));
+        }
+    }
+    std::sort(order.begin(), order.end(), [this](uint16_t a, uint16_t b) { return pcCounts[a] != pcCounts[b] ? pcCounts[a] > pcCounts[b] : a < b; });
+    order.resize(std::min<size_t>(order.size(), hotspots));
+
+    out << "  \"hotspots\": [";
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        out << (i == 0 ? "\n" : ",\n") << "    {\"pc\": \"" << Hex(order[i], 3) << "\", \"count\": " << pcCounts[order[i]] << "}";
+    }
+    out << "\n  ],\n";
+
+    out << "  \"draws\": {\"calls\": " << draws << ", \"rows\": " << drawRows << "},\n";
+
+    out << "  \"frames\": {\"count\": " << frameCount << ", \"min\": " << (frameCount ? frameMin : 0) << ", \"max\": " << frameMax
+        << ", \"mean\": " << (frameCount ? double(frameTotal) / frameCount : 0.0) << ", \"recent\": [";
+    uint64_t kept = std::min<uint64_t>(frameCount, FRAME_HISTORY);
+    for (uint64_t i = 0; i < kept; ++i)
+    {
+        out << (i == 0 ? "" : ", ") << recentFrames[(frameCount - kept + i) % FRAME_HISTORY];
+    }
+    out << "]}\n";
+    out << "}\n";
+}
+
+void Profiler::WriteCollapsed(std::ostream& out, uint64_t cycle) const
+{
+    std::vector<uint32_t> chain;
+
+    for (uint32_t path = 0; path < paths.size(); ++path)
+    {
+        uint64_t instructions = paths[path].instructions + ((path == currentPath) ? cycle - pathStart : 0);
+        if (instructions == 0)
+        {
+            continue;
+        }
+
+        chain.clear();
+        for (uint32_t at = path; at != 0; at = paths[at].parent)
+        {
+            chain.push_back(at);
+        }
+
+        out << "main";
+        for (auto it = chain.rbegin(); it != chain.rend(); ++it)
+        {
+            out << ";sub_" << Hex(paths[*it].routine, 3).substr(2);
+        }
+        out << " " << instructions << "\n";
+    }
+}
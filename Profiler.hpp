@@ -0,0 +1,111 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <cstdint>
+#include <iosfwd>
+#include <unordered_map>
+#include <vector>
+
+
+// where a rom spends its time
+// counts every instruction by address and by family (8xy4, Dxyn, ...), every draw, the instructions run in each 60hz frame, and the
+// instructions run under each chain of subroutine calls. the call chains are what the collapsed stack export is made of
+//
+// only the count for each address is kept as instructions run, and Chip8 feeds those a whole cached block at a time. the family counts
+// are worked out from them: whenever an instruction is decoded the profiler is told its family, and the counts so far at that address
+// are credited to the family that was there before. code is always decoded again after it is written, so writes cost nothing here.
+// the call chains only do work on CALL and RET and are settled from the cycle count, so it all stays cheap enough to leave on while playing
+class Profiler
+{
+public:
+	static const unsigned int ADDRESS_COUNT = 4096;
+	static const unsigned int FAMILY_COUNT = 64;     // room for every Chip8 handler
+	static const unsigned int FRAME_HISTORY = 3600;  // per frame counts kept for the last minute, min, max and mean cover the whole run
+	static const unsigned int MAX_CALL_PATHS = 4096; // distinct call chains tracked, deeper calls after that count toward their caller
+
+	Profiler();
+
+	void Reset();
+
+	void Execute(uint16_t pc, uint64_t times = 1)
+	{
+		pcCounts[pc & (ADDRESS_COUNT - 1)] += times;
+	}
+
+	void CodeChanged(uint16_t address, uint8_t family); // the instruction at address was decoded and is of this family
+
+	void Draw(unsigned int rows)
+	{
+		++draws;
+		drawRows += rows;
+	}
+
+	void Call(uint64_t cycle, uint16_t routine); // cycle is the cycle count after the CALL, the CALL itself belongs to the caller
+	void Return(uint64_t cycle);
+	void Frame(uint64_t cycle);                  // a 60hz timer tick
+	void Jump(uint64_t from, uint64_t to);       // the cycle count was reset (a save state was loaded), the call chain starts over
+
+	uint64_t Instructions() const;
+	uint64_t PcCount(uint16_t pc) const;
+	uint64_t FamilyCount(uint8_t family) const;
+	uint64_t Draws() const;
+
+	// family names come from Chip8, the profiler only ever sees their numbers
+	void WriteJson(std::ostream& out, char const* const* familyNames, unsigned int familyCount, unsigned int hotspots = 64) const;
+
+	// "main;sub_0300;sub_0348 12345" lines, for flamegraph.pl and friends. cycle is the current cycle count, so the instructions since
+	// the last CALL or RET are counted too
+	void WriteCollapsed(std::ostream& out, uint64_t cycle) const;
+
+private:
+	struct CallPath
+	{
+		uint32_t parent;
+		uint16_t routine;
+		uint64_t instructions; // run with this chain on top, not counting the calls it made
+	};
+
+	void Settle(uint64_t cycle); // credit the instructions since the last settle to the current call path
+
+	uint64_t pcCounts[ADDRESS_COUNT];
+	uint64_t settledCounts[ADDRESS_COUNT];  // part of pcCounts already in familyCounts
+	uint8_t familyAt[ADDRESS_COUNT];        // family of the instruction last decoded at each address
+	uint64_t familyCounts[FAMILY_COUNT];    // only up to the last CodeChanged at each address, FamilyCount adds the rest
+	uint64_t draws;
+	uint64_t drawRows;
+
+	uint64_t lastFrameCycle;
+	uint64_t frameCount;
+	uint64_t frameMin;
+	uint64_t frameMax;
+	uint64_t frameTotal;
+	std::vector<uint32_t> recentFrames; // ring of FRAME_HISTORY
+
+	std::vector<CallPath> paths;                     // 0 is the root, code outside any subroutine
+	std::unordered_map<uint64_t, uint32_t> children; // parent << 16 | routine -> path
+
+	// most calls are the same few call sites over and over, a small direct mapped cache in front of children keeps those off the hash map
+	struct CachedChild
+	{
+		uint64_t key;
+		uint32_t path;
+	};
+	static const unsigned int CHILD_CACHE_SIZE = 256;
+	CachedChild childCache[CHILD_CACHE_SIZE];
+	uint32_t currentPath;
+	uint64_t pathStart;     // cycle the current path was last settled at
+	unsigned int overflow;  // calls made while MAX_CALL_PATHS was full, their returns dont pop a path
+};
+
+
+// profiling points compile to nothing unless the build turns on CHIP8_PROFILE
+// when it is on, a profiling point costs one pointer check while the profiler is switched off
+#ifdef CHIP8_PROFILE
+#define CHIP8_PROFILE_RECORD(profilerPtr, call) \
+	do { if (profilerPtr) (profilerPtr)->call; } while (0)
+#else
+#define CHIP8_PROFILE_RECORD(profilerPtr, call) do {} while (0)
+#endif
+
+
+#endif
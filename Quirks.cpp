@@ -0,0 +1,178 @@
+#include "Quirks.hpp"
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+
+bool ParseProfile(char const* text, QuirkProfile& profile)
+{
+    QuirkProfile parsed = profile;
+    std::stringstream list(text);
+    std::string name;
+
+    while (std::getline(list, name, ','))
+    {
+        // the machines bring their own quirks, anything else is a chip8 rom again
+        if (name == "schip")
+        {
+            parsed = QuirkProfile{ Machine::SuperChip, SuperChipMachine::QUIRKS };
+            continue;
+        }
+        if (name == "xochip")
+        {
+            parsed = QuirkProfile{ Machine::XoChip, XoChipMachine::QUIRKS };
+            continue;
+        }
+        parsed.machine = Machine::Chip8;
+
+        if (name == "chip8")
+        {
+            parsed.quirks = Quirks{};
+        }
+        else if (name == "vip")
+        {
+            parsed.quirks.shiftVy = true;
+            parsed.quirks.indexAdvances = true;
+        }
+        else if (name == "shift")
+        {
+            parsed.quirks.shiftVy = true;
+        }
+        else if (name == "memory")
+        {
+            parsed.quirks.indexAdvances = true;
+        }
+        else if (name == "jump")
+        {
+            parsed.quirks.jumpVx = true;
+        }
+        else if (name == "wrap")
+        {
+            parsed.quirks.wrapSprites = true;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    profile = parsed;
+    return true;
+}
+
+std::string QuirksName(Quirks quirks)
+{
+    std::string name;
+    auto add = [&name](bool on, char const* quirk)
+    {
+        if (on)
+        {
+            name += name.empty() ? quirk : std::string(",") + quirk;
+        }
+    };
+
+    add(quirks.shiftVy, "shift");
+    add(quirks.indexAdvances, "memory");
+    add(quirks.jumpVx, "jump");
+    add(quirks.wrapSprites, "wrap");
+    return name.empty() ? "chip8" : name;
+}
+
+std::string ProfileName(QuirkProfile const& profile)
+{
+    switch (profile.machine)
+    {
+    case Machine::SuperChip:
+        return "schip";
+    case Machine::XoChip:
+        return "xochip";
+    default:
+        return QuirksName(profile.quirks);
+    }
+}
+
+bool QuirkProfiles::Load(char const* path)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        std::cerr << "Could not read quirk profiles " << path << "\n";
+        return false;
+    }
+
+    std::string line;
+    unsigned int lineNumber = 0;
+    while (std::getline(file, line))
+    {
+        ++lineNumber;
+        line = line.substr(0, line.find('#'));
+
+        std::stringstream fields(line);
+        std::string rom;
+        std::string list;
+        if (!(fields >> rom))
+        {
+            continue; // blank or only a comment
+        }
+
+        QuirkProfile profile;
+        if (!(fields >> list) || !ParseProfile(list.c_str(), profile))
+        {
+            std::cerr << path << ":" << lineNumber << ": expected a rom and a quirk list, got \"" << line << "\"\n";
+            return false;
+        }
+
+        // 16 hex digits is a hash, anything else a file name
+        char* end = nullptr;
+        uint64_t hash = std::strtoull(rom.c_str(), &end, 16);
+        if (rom.size() == 16 && *end == '\0')
+        {
+            byHash[hash] = profile;
+        }
+        else
+        {
+            byName[rom] = profile;
+        }
+    }
+    return true;
+}
+
+void QuirkProfiles::SetFallback(QuirkProfile profile)
+{
+    fallback = profile;
+}
+
+bool QuirkProfiles::LoadEnvironment()
+{
+    if (char const* list = std::getenv("CHIP8_QUIRKS"))
+    {
+        QuirkProfile profile;
+        if (!ParseProfile(list, profile))
+        {
+            std::cerr << "Unknown quirk in CHIP8_QUIRKS=" << list << ", expected chip8, vip, schip, xochip, shift, memory, jump or wrap\n";
+            return false;
+        }
+        fallback = profile;
+    }
+
+    char const* path = std::getenv("CHIP8_QUIRK_PROFILES");
+    return !path || Load(path);
+}
+
+QuirkProfile QuirkProfiles::For(std::string const& name, uint64_t hash) const
+{
+    auto byHashFound = byHash.find(hash);
+    if (byHashFound != byHash.end())
+    {
+        return byHashFound->second;
+    }
+
+    auto byNameFound = byName.find(name);
+    return (byNameFound != byName.end()) ? byNameFound->second : fallback;
+}
+
+QuirkProfile QuirkProfiles::For(RomImage const& rom) const
+{
+    return For(rom.name, rom.hash);
+}
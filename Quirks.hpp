@@ -0,0 +1,61 @@
+#ifndef QUIRKS_HPP
+#define QUIRKS_HPP
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include "Chip8.hpp"
+#include "ChipVariant.hpp"
+#include "RomLibrary.hpp"
+
+
+// picks the machine and quirks each rom runs with. a chip8 rom runs on Chip8, which SetQuirks gives the handler instantiations for
+// its quirks. SUPER-CHIP and XO-CHIP roms run on their ChipVariant, which has its machine's quirks built in
+enum class Machine : uint8_t
+{
+	Chip8,
+	SuperChip, // SuperChip8, 128x64 and the SUPER-CHIP instructions
+	XoChip     // XoChip8, that plus 64k of memory and two planes
+};
+
+struct QuirkProfile
+{
+	Machine machine = Machine::Chip8;
+	Quirks quirks; // only for Machine::Chip8
+};
+
+// a quirk list is preset and quirk names separated by commas, each one adding to the ones before it
+//     chip8    nothing on, what this emulator has always done
+//     vip      shift,memory       the COSMAC VIP interpreter
+//     schip    the SUPER-CHIP 1.1 machine, with its quirks (jump)
+//     xochip   the XO-CHIP machine, with its quirks (shift,memory,wrap)
+//     shift, memory, jump, wrap   one quirk each, shiftVy, indexAdvances, jumpVx and wrapSprites in Quirks, and back to Chip8
+bool ParseProfile(char const* text, QuirkProfile& profile); // false (and profile untouched) for a name it doesnt know
+std::string QuirksName(Quirks quirks);                      // the quirk names with commas, "chip8" for none
+std::string ProfileName(QuirkProfile const& profile);       // "schip" or "xochip", or the QuirksName for a chip8 rom
+
+// which machine and quirks each rom needs, from a profile file with one rom per line: its file name or its RomLibrary::Hash as 16
+// hex digits, then its quirk list. blank lines and anything after a # are skipped
+//     PONG.ch8           chip8
+//     BLINKY.ch8         schip
+//     9a3c0d7e5b1f2468   vip,wrap
+class QuirkProfiles
+{
+public:
+	bool Load(char const* path); // false if the file cant be read or a line doesnt parse, the reason goes to std::cerr
+	void SetFallback(QuirkProfile profile); // for roms the file doesnt list, plain chip8 with the default quirks until this is called
+
+	// CHIP8_QUIRKS=list sets the fallback and CHIP8_QUIRK_PROFILES=path loads a profile file, false if either is bad
+	bool LoadEnvironment();
+
+	QuirkProfile For(std::string const& name, uint64_t hash) const; // the hash is looked for first, so a renamed rom keeps its profile
+	QuirkProfile For(RomImage const& rom) const;
+
+private:
+	std::unordered_map<uint64_t, QuirkProfile> byHash;
+	std::unordered_map<std::string, QuirkProfile> byName;
+	QuirkProfile fallback;
+};
+
+
+#endif
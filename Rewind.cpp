@@ -0,0 +1,291 @@
+#include "Rewind.hpp"
+#include <cstring>
+
+
+RewindBuffer::RewindBuffer(size_t budgetBytes, unsigned int keyframeInterval)
+    : ring(budgetBytes)
+    , keyframeInterval(keyframeInterval > 0 ? keyframeInterval : 1)
+    , scratch(sizeof(SaveState) * 2 + 16) // worst case encoding, every byte a literal plus the run headers
+{}
+
+void RewindBuffer::Clear()
+{
+    entries.clear();
+    head = 0;
+    used = 0;
+    haveKeyframe = false;
+    sinceKeyframe = 0;
+}
+
+size_t RewindBuffer::Frames() const
+{
+    return entries.size();
+}
+
+size_t RewindBuffer::BytesUsed() const
+{
+    return used;
+}
+
+namespace
+{
+    size_t WriteVarint(uint8_t* out, size_t value)
+    {
+        size_t length = 0;
+        while (value >= 0x80)
+        {
+            out[length++] = static_cast<uint8_t>(value | 0x80);
+            value >>= 7;
+        }
+        out[length++] = static_cast<uint8_t>(value);
+        return length;
+    }
+
+    size_t ReadVarint(uint8_t const* in, size_t& position)
+    {
+        size_t value = 0;
+        unsigned int shift = 0;
+        uint8_t byte;
+        do
+        {
+            byte = in[position++];
+            value |= size_t(byte & 0x7F) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+        return value;
+    }
+}
+
+// XOR the two states and run length encode the result as pairs of (bytes that didnt change, bytes that did, the XORed bytes)
+size_t RewindBuffer::EncodeDelta(uint8_t const* base, uint8_t const* current, size_t size, uint8_t* out)
+{
+    size_t length = 0;
+    size_t i = 0;
+
+    while (i < size)
+    {
+        size_t runStart = i;
+        while (i < size && base[i] == current[i])
+        {
+            ++i;
+        }
+        size_t same = i - runStart;
+
+        size_t literalStart = i;
+        while (i < size && base[i] != current[i])
+        {
+            ++i;
+        }
+        size_t changed = i - literalStart;
+
+        length += WriteVarint(out + length, same);
+        length += WriteVarint(out + length, changed);
+
+        for (size_t j = literalStart; j < i; ++j)
+        {
+            out[length++] = base[j] ^ current[j];
+        }
+    }
+
+    return length;
+}
+
+void RewindBuffer::ApplyDelta(uint8_t const* delta, size_t length, uint8_t* state)
+{
+    size_t position = 0;
+    size_t offset = 0;
+
+    while (position < length)
+    {
+        offset += ReadVarint(delta, position);
+        size_t changed = ReadVarint(delta, position);
+
+        for (size_t j = 0; j < changed; ++j)
+        {
+            state[offset++] ^= delta[position++];
+        }
+    }
+}
+
+void RewindBuffer::DropOldest()
+{
+    Entry dropped = entries.front();
+    entries.pop_front();
+    used -= dropped.length;
+
+    if (haveKeyframe && dropped.sequence == keyframeSequence)
+    {
+        haveKeyframe = false; // the next Record has to start a new keyframe
+    }
+
+    // deltas are useless without their keyframe
+    while (!entries.empty() && entries.front().keyframeSequence == dropped.sequence)
+    {
+        used -= entries.front().length;
+        entries.pop_front();
+    }
+
+    if (entries.empty())
+    {
+        head = 0;
+    }
+}
+
+// entries are allocated one after another around the ring, so the free space is always the gap from head up to the oldest entry
+bool RewindBuffer::Reserve(size_t length, size_t& offset)
+{
+    if (length > ring.size())
+    {
+        return false;
+    }
+
+    for (;;)
+    {
+        if (entries.empty())
+        {
+            offset = 0;
+            head = length;
+            return true;
+        }
+
+        size_t tail = entries.front().offset;
+
+        if (head > tail) // live bytes are [tail, head), free space is after head and before tail
+        {
+            if (head + length <= ring.size())
+            {
+                offset = head;
+                head += length;
+                return true;
+            }
+
+            if (length <= tail) // doesnt fit at the end, skip the leftover bytes and start again from the front
+            {
+                offset = 0;
+                head = length;
+                return true;
+            }
+        }
+        else if (head + length <= tail) // already wrapped, free space is between head and tail
+        {
+            offset = head;
+            head += length;
+            return true;
+        }
+
+        DropOldest();
+    }
+}
+
+void RewindBuffer::Record(Chip8 const& chip8)
+{
+    chip8.Save(current);
+
+    uint8_t const* bytes = reinterpret_cast<uint8_t const*>(&current);
+    bool asKeyframe = !haveKeyframe || sinceKeyframe >= keyframeInterval;
+    size_t length = 0;
+
+    if (!asKeyframe)
+    {
+        length = EncodeDelta(reinterpret_cast<uint8_t const*>(&keyframe), bytes, sizeof(SaveState), scratch.data());
+    }
+
+    size_t offset = 0;
+
+    if (!asKeyframe)
+    {
+        if (!Reserve(length, offset))
+        {
+            return;
+        }
+
+        // making room can drop the keyframe this delta was made against, then this frame has to be a keyframe after all
+        // give the space back first, at worst that leaves a few unused bytes before the end of the ring until it wraps again
+        if (!haveKeyframe)
+        {
+            head = offset;
+            asKeyframe = true;
+        }
+    }
+
+    if (asKeyframe)
+    {
+        length = sizeof(SaveState);
+        if (!Reserve(length, offset))
+        {
+            return;
+        }
+
+        std::memcpy(&ring[offset], bytes, length);
+        keyframe = current;
+        haveKeyframe = true;
+        keyframeSequence = nextSequence;
+        sinceKeyframe = 0;
+    }
+    else
+    {
+        std::memcpy(&ring[offset], scratch.data(), length);
+    }
+
+    entries.push_back(Entry{nextSequence, keyframeSequence, offset, length});
+    used += length;
+    ++nextSequence;
+    ++sinceKeyframe;
+}
+
+RewindBuffer::Entry const* RewindBuffer::Find(uint64_t sequence) const
+{
+    if (entries.empty() || sequence < entries.front().sequence || sequence > entries.back().sequence)
+    {
+        return nullptr;
+    }
+
+    return &entries[sequence - entries.front().sequence]; // sequences have no gaps, so this is a direct index
+}
+
+void RewindBuffer::Decode(Entry const& entry, SaveState& state) const
+{
+    Entry const* base = Find(entry.keyframeSequence);
+    std::memcpy(&state, &ring[base->offset], sizeof(SaveState));
+
+    if (base != &entry)
+    {
+        ApplyDelta(&ring[entry.offset], entry.length, reinterpret_cast<uint8_t*>(&state));
+    }
+}
+
+bool RewindBuffer::StepBack(Chip8& chip8)
+{
+    if (entries.size() < 2)
+    {
+        return false;
+    }
+
+    // the newest frame is the one on screen now, go to the one before and only throw the newest away once that one is restored
+    Entry newest = entries.back();
+    Entry const& target = entries[entries.size() - 2];
+    Decode(target, current);
+
+    // the keypad is whatever the player is holding now, not what they held back then. keys only change on a press or release
+    // event, so one let go of while rewinding would otherwise stay down until it is pressed and released again
+    uint8_t keypad[KEY_COUNT];
+    std::memcpy(keypad, chip8.keypad, sizeof(keypad));
+    if (!chip8.Restore(current))
+    {
+        return false;
+    }
+    std::memcpy(chip8.keypad, keypad, sizeof(keypad));
+
+    entries.pop_back();
+    used -= newest.length;
+    head = newest.offset;
+    nextSequence = newest.sequence;
+
+    // recording carries on from here, against the keyframe of the frame we landed on
+    Entry const* base = Find(target.keyframeSequence);
+    std::memcpy(&keyframe, &ring[base->offset], sizeof(SaveState));
+    haveKeyframe = true;
+    keyframeSequence = base->sequence;
+    sinceKeyframe = static_cast<unsigned int>(target.sequence - base->sequence) + 1;
+    return true;
+}
@@ -0,0 +1,67 @@
+#ifndef REWIND_HPP
+#define REWIND_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include "Chip8.hpp"
+#include "SaveState.hpp"
+
+
+// frame accurate rewind inside a fixed memory budget
+// Record is called once per frame and stores a snapshot of the machine. every keyframeInterval frames the snapshot is a full SaveState,
+// the frames in between only store how they differ from their keyframe: the two states XORed together, then run length encoded so the
+// long runs of unchanged (zero) bytes cost almost nothing. because every delta is against its keyframe and not the frame before it,
+// going back one frame is one keyframe copy plus one delta, however far back it is
+//
+// all snapshots live in one byte ring of budgetBytes. when it is full the oldest frames are dropped, and a keyframe is only dropped
+// together with the deltas that depend on it
+class RewindBuffer
+{
+public:
+	explicit RewindBuffer(size_t budgetBytes, unsigned int keyframeInterval = 60);
+
+	void Record(Chip8 const& chip8);
+	bool StepBack(Chip8& chip8); // drops the newest frame and restores the one before it, all but the live keypad. false (and nothing changes) once there is nothing left to go back to or the frame doesnt restore
+	void Clear();
+
+	size_t Frames() const;     // frames that can still be stepped back through
+	size_t BytesUsed() const;
+
+private:
+	struct Entry
+	{
+		uint64_t sequence;         // frame number, counts up forever
+		uint64_t keyframeSequence; // the keyframe this frame is stored against, itself for a keyframe
+		size_t offset;             // where the bytes start in the ring
+		size_t length;
+	};
+
+	bool Reserve(size_t length, size_t& offset); // find room for length contiguous bytes, dropping old frames if needed
+	void DropOldest();
+	Entry const* Find(uint64_t sequence) const;
+	void Decode(Entry const& entry, SaveState& state) const;
+
+	static size_t EncodeDelta(uint8_t const* base, uint8_t const* current, size_t size, uint8_t* out);
+	static void ApplyDelta(uint8_t const* delta, size_t length, uint8_t* state);
+
+	std::vector<uint8_t> ring;
+	size_t head = 0; // next free byte
+	size_t used = 0; // the lengths of all the entries added up, the tail skipped when an entry wraps to the start isnt in it
+	unsigned int keyframeInterval;
+
+	std::deque<Entry> entries;
+	uint64_t nextSequence = 0;
+
+	SaveState keyframe{}; // copy of the keyframe new deltas are made against
+	bool haveKeyframe = false;
+	uint64_t keyframeSequence = 0;
+	unsigned int sinceKeyframe = 0;
+
+	SaveState current{};               // scratch, so recording never allocates
+	std::vector<uint8_t> scratch;      // encoded delta before it is copied into the ring
+};
+
+
+#endif
@@ -0,0 +1,172 @@
+#include "RomLibrary.hpp"
+#include "Chip8.hpp"
+#include <algorithm>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+RomLibrary::~RomLibrary()
+{
+    Close();
+}
+
+bool RomLibrary::Open(char const* path)
+{
+    Close();
+
+    struct stat info;
+    if (stat(path, &info) != 0)
+    {
+        skipped.push_back(std::string(path) + ": cant be opened");
+        return false;
+    }
+
+    if (!S_ISDIR(info.st_mode))
+    {
+        std::string name = path;
+        size_t slash = name.find_last_of('/');
+        Add(path, (slash == std::string::npos) ? name : name.substr(slash + 1));
+        return !roms.empty();
+    }
+
+    DIR* directory = opendir(path);
+    if (!directory)
+    {
+        skipped.push_back(std::string(path) + ": cant be opened");
+        return false;
+    }
+
+    std::vector<std::string> names;
+    while (dirent* entry = readdir(directory))
+    {
+        if (std::strcmp(entry->d_name, ".") != 0 && std::strcmp(entry->d_name, "..") != 0)
+        {
+            names.push_back(entry->d_name);
+        }
+    }
+    closedir(directory);
+
+    // readdir order is whatever the filesystem likes, sorting keeps Rom(i) the same from run to run
+    std::sort(names.begin(), names.end());
+
+    for (std::string const& name : names)
+    {
+        Add(std::string(path) + "/" + name, name);
+    }
+    return !roms.empty();
+}
+
+void RomLibrary::Add(std::string const& path, std::string const& name)
+{
+    int file = open(path.c_str(), O_RDONLY);
+    if (file < 0)
+    {
+        skipped.push_back(name + ": cant be opened");
+        return;
+    }
+
+    struct stat info;
+    if (fstat(file, &info) != 0 || !S_ISREG(info.st_mode))
+    {
+        close(file);
+        skipped.push_back(name + ": not a regular file");
+        return;
+    }
+
+    if (info.st_size <= 0 || static_cast<uint64_t>(info.st_size) > MAX_ROM_SIZE)
+    {
+        close(file);
+        skipped.push_back(name + ": " + std::to_string(info.st_size) + " bytes, a rom has to be 1 to " + std::to_string(MAX_ROM_SIZE));
+        return;
+    }
+
+    size_t size = static_cast<size_t>(info.st_size);
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file); // the mapping keeps the file alive on its own
+
+    if (mapped == MAP_FAILED)
+    {
+        skipped.push_back(name + ": cant be mapped");
+        return;
+    }
+
+    uint8_t const* data = static_cast<uint8_t const*>(mapped);
+    uint64_t hash = Hash(data, size);
+
+    auto found = byHash.find(hash);
+    if (found != byHash.end())
+    {
+        RomImage const& existing = roms[found->second];
+        bool same = (existing.size == size) && std::memcmp(existing.data, data, size) == 0;
+
+        munmap(mapped, size);
+        if (same)
+        {
+            byName.emplace(name, found->second); // one more name for a rom already in the library
+        }
+        else
+        {
+            skipped.push_back(name + ": hash collides with " + existing.name);
+        }
+        return;
+    }
+
+    mappings.push_back(Mapping{mapped, size});
+    byHash.emplace(hash, roms.size());
+    byName.emplace(name, roms.size());
+    roms.push_back(RomImage{name, hash, data, size});
+}
+
+void RomLibrary::Close()
+{
+    for (Mapping const& mapping : mappings)
+    {
+        munmap(mapping.address, mapping.size);
+    }
+    mappings.clear();
+    roms.clear();
+    byHash.clear();
+    byName.clear();
+    skipped.clear();
+}
+
+size_t RomLibrary::Count() const
+{
+    return roms.size();
+}
+
+RomImage const& RomLibrary::Rom(size_t index) const
+{
+    return roms[index];
+}
+
+RomImage const* RomLibrary::Find(uint64_t hash) const
+{
+    auto found = byHash.find(hash);
+    return (found != byHash.end()) ? &roms[found->second] : nullptr;
+}
+
+RomImage const* RomLibrary::Find(std::string const& name) const
+{
+    auto found = byName.find(name);
+    return (found != byName.end()) ? &roms[found->second] : nullptr;
+}
+
+std::vector<std::string> const& RomLibrary::Skipped() const
+{
+    return skipped;
+}
+
+uint64_t RomLibrary::Hash(uint8_t const* data, size_t size)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash = (hash ^ data[i]) * 1099511628211ull;
+    }
+    return hash;
+}
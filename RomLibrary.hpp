@@ -0,0 +1,63 @@
+#ifndef ROMLIBRARY_HPP
+#define ROMLIBRARY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+// one rom in a RomLibrary, the bytes are read only and shared by every machine loaded from it
+struct RomImage
+{
+	std::string name;    // file name, without the directory
+	uint64_t hash;       // FNV-1a of the contents
+	uint8_t const* data; // inside the librarys mapping, valid until the library is closed
+	size_t size;         // always 1 to MAX_ROM_SIZE
+};
+
+
+// a directory of roms mapped read only once, for batch runs that start thousands of machines from the same few roms
+// every file is mapped, checked to fit at 0x200 and indexed by the hash of its contents. files with the same contents under
+// different names are kept once. after Open nothing changes, so any number of threads can load machines from it at the same time,
+// each load being one copy out of the page cache with no file access at all
+class RomLibrary
+{
+public:
+	RomLibrary() = default;
+	~RomLibrary();
+
+	RomLibrary(RomLibrary const&) = delete;
+	RomLibrary& operator=(RomLibrary const&) = delete;
+
+	bool Open(char const* path); // a directory of roms or a single rom file, false if no usable rom was found
+	void Close();
+
+	size_t Count() const;
+	RomImage const& Rom(size_t index) const; // in file name order
+	RomImage const* Find(uint64_t hash) const;
+	RomImage const* Find(std::string const& name) const; // duplicates are found under any of their names
+
+	std::vector<std::string> const& Skipped() const; // "name: why" for every file that wasnt added
+
+	static uint64_t Hash(uint8_t const* data, size_t size);
+
+private:
+	void Add(std::string const& path, std::string const& name);
+
+	struct Mapping
+	{
+		void* address;
+		size_t size;
+	};
+
+	std::vector<Mapping> mappings;
+	std::vector<RomImage> roms;
+	std::unordered_map<uint64_t, size_t> byHash;      // hash -> index into roms
+	std::unordered_map<std::string, size_t> byName;   // every name, duplicates included
+	std::vector<std::string> skipped;
+};
+
+
+#endif
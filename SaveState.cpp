@@ -0,0 +1,196 @@
+#include "SaveState.hpp"
+#include "RomLibrary.hpp"
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+bool SaveStateToFile(Chip8 const& chip8, char const* path)
+{
+    int file = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (file < 0)
+    {
+        return false;
+    }
+
+    if (ftruncate(file, sizeof(SaveState)) != 0)
+    {
+        close(file);
+        return false;
+    }
+
+    void* mapped = mmap(nullptr, sizeof(SaveState), PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+    close(file); // the mapping keeps the file alive on its own
+
+    if (mapped == MAP_FAILED)
+    {
+        return false;
+    }
+
+    chip8.Save(*static_cast<SaveState*>(mapped));
+    munmap(mapped, sizeof(SaveState));
+    return true;
+}
+
+bool LoadStateFromFile(Chip8& chip8, char const* path)
+{
+    int file = open(path, O_RDONLY);
+    if (file < 0)
+    {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(file, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(SaveState))
+    {
+        close(file);
+        return false;
+    }
+
+    void* mapped = mmap(nullptr, sizeof(SaveState), PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+
+    if (mapped == MAP_FAILED)
+    {
+        return false;
+    }
+
+    bool loaded = chip8.Restore(*static_cast<SaveState const*>(mapped));
+    munmap(mapped, sizeof(SaveState));
+    return loaded;
+}
+
+
+uint64_t StateDigest(SaveState const& state)
+{
+    return RomLibrary::Hash(reinterpret_cast<uint8_t const*>(&state), sizeof(state));
+}
+
+SaveStateStore::~SaveStateStore()
+{
+    Close();
+}
+
+bool SaveStateStore::Open(char const* path, uint32_t slotCount)
+{
+    Close();
+
+    fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0)
+    {
+        Close();
+        return false;
+    }
+
+    // an existing store keeps its slots, and only grows if more were asked for
+    uint32_t existing = 0;
+    if (static_cast<size_t>(info.st_size) >= HEADER_SIZE)
+    {
+        uint8_t header[16];
+        if (pread(fd, header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)) || std::memcmp(header, "C8SA", 4) != 0)
+        {
+            Close();
+            return false;
+        }
+
+        uint32_t slotSize;
+        std::memcpy(&slotSize, header + 8, 4);
+        std::memcpy(&existing, header + 12, 4);
+
+        if (slotSize != SLOT_SIZE)
+        {
+            Close();
+            return false;
+        }
+    }
+
+    slots = (slotCount > existing) ? slotCount : existing;
+    mappingSize = HEADER_SIZE + size_t(slots) * SLOT_SIZE;
+
+    if (static_cast<size_t>(info.st_size) < mappingSize && ftruncate(fd, mappingSize) != 0)
+    {
+        Close();
+        return false;
+    }
+
+    void* mapped = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED)
+    {
+        Close();
+        return false;
+    }
+    mapping = static_cast<uint8_t*>(mapped);
+
+    uint32_t version = SaveState::VERSION;
+    uint32_t slotSize = SLOT_SIZE;
+    std::memcpy(mapping, "C8SA", 4);
+    std::memcpy(mapping + 4, &version, 4);
+    std::memcpy(mapping + 8, &slotSize, 4);
+    std::memcpy(mapping + 12, &slots, 4);
+    return true;
+}
+
+void SaveStateStore::Close()
+{
+    if (mapping)
+    {
+        munmap(mapping, mappingSize);
+        mapping = nullptr;
+    }
+
+    if (fd >= 0)
+    {
+        close(fd);
+        fd = -1;
+    }
+
+    mappingSize = 0;
+    slots = 0;
+}
+
+SaveState* SaveStateStore::Slot(uint32_t slot) const
+{
+    if (!mapping || slot >= slots)
+    {
+        return nullptr;
+    }
+
+    return reinterpret_cast<SaveState*>(mapping + HEADER_SIZE + size_t(slot) * SLOT_SIZE);
+}
+
+bool SaveStateStore::Save(uint32_t slot, Chip8 const& chip8)
+{
+    SaveState* state = Slot(slot);
+    if (!state)
+    {
+        return false;
+    }
+
+    chip8.Save(*state);
+    return true;
+}
+
+// an unused slot is all zeros, Restore rejects it because the magic is missing
+bool SaveStateStore::Load(uint32_t slot, Chip8& chip8) const
+{
+    SaveState const* state = Slot(slot);
+    return state && chip8.Restore(*state);
+}
+
+bool SaveStateStore::Flush()
+{
+    return mapping && msync(mapping, mappingSize, MS_SYNC) == 0;
+}
+
+uint32_t SaveStateStore::SlotCount() const
+{
+    return slots;
+}
@@ -0,0 +1,87 @@
+#ifndef SAVESTATE_HPP
+#define SAVESTATE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include "Chip8.hpp"
+
+
+// fixed layout binary save state, version 2 (version 1 stored a minstd_rand0 state in rngState, 2 stores the xorshift32 state)
+// every field has a fixed size and a fixed offset (checked below) and there are no pointers, so a state can be copied, written to disk
+// or used straight out of a memory mapped file. multi byte fields are in the hosts byte order
+struct SaveState
+{
+	static const uint32_t VERSION = 2;
+
+	char magic[4];          // "C8SS"
+	uint32_t version;
+	uint32_t size;          // sizeof(SaveState), a second check that the reader and writer agree on the layout
+	uint32_t reserved0;
+	uint64_t cycleCount;
+	uint64_t video[VIDEO_HEIGHT];
+	uint8_t memory[MEMORY_SIZE];
+	uint8_t registers[REGISTER_COUNT];
+	uint16_t stack[STACK_LEVELS];
+	uint16_t index;
+	uint16_t pc;
+	uint8_t sp;
+	uint8_t delayTimer;
+	uint8_t soundTimer;
+	uint8_t reserved1;
+	uint32_t rngState;      // never 0, that is the one state xorshift32 cant leave
+	uint8_t keypad[KEY_COUNT];
+	uint32_t reserved2;
+};
+
+static_assert(offsetof(SaveState, cycleCount) == 16, "save state layout changed");
+static_assert(offsetof(SaveState, video) == 24, "save state layout changed");
+static_assert(offsetof(SaveState, memory) == 280, "save state layout changed");
+static_assert(offsetof(SaveState, pc) == 4426, "save state layout changed");
+static_assert(offsetof(SaveState, rngState) == 4432, "save state layout changed");
+static_assert(sizeof(SaveState) == 4456, "save state layout changed");
+
+
+// single state in its own file, the file is mapped and the state is written into or read out of the mapping directly
+bool SaveStateToFile(Chip8 const& chip8, char const* path);
+bool LoadStateFromFile(Chip8& chip8, char const* path);
+
+// FNV-1a of the whole state, two runs agree on this exactly when they agree on every register, pixel and byte of memory
+uint64_t StateDigest(SaveState const& state);
+
+
+// many states in one memory mapped file, for checkpointing long batch runs
+// the file is mapped once in Open, after that every Save and Load is a copy of one state into or out of the mapping
+//
+// file layout: 64 byte header ("C8SA", uint32 version, uint32 slot size, uint32 slot count), then slotCount slots of SLOT_SIZE bytes
+class SaveStateStore
+{
+public:
+	static const size_t HEADER_SIZE = 64;
+	static const size_t SLOT_SIZE = (sizeof(SaveState) + 63) & ~size_t(63); // each slot starts on a cache line
+
+	SaveStateStore() = default;
+	~SaveStateStore();
+
+	SaveStateStore(SaveStateStore const&) = delete;
+	SaveStateStore& operator=(SaveStateStore const&) = delete;
+
+	bool Open(char const* path, uint32_t slotCount); // creates or grows the file so it has at least slotCount slots
+	void Close();
+
+	bool Save(uint32_t slot, Chip8 const& chip8);
+	bool Load(uint32_t slot, Chip8& chip8) const;
+	bool Flush(); // push dirty pages to disk now instead of whenever the os gets round to it
+
+	uint32_t SlotCount() const;
+
+private:
+	SaveState* Slot(uint32_t slot) const;
+
+	int fd = -1;
+	uint8_t* mapping = nullptr;
+	size_t mappingSize = 0;
+	uint32_t slots = 0;
+};
+
+
+#endif
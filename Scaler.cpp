@@ -0,0 +1,282 @@
+#include "Scaler.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+// SSE2 is part of x86-64 so that path is always there, the AVX2 one is built alongside it and picked at runtime
+#if defined(__x86_64__) && defined(__GNUC__)
+#define CHIP8_SCALER_X64
+#include <immintrin.h>
+#endif
+
+
+namespace
+{
+#ifdef CHIP8_SCALER_X64
+    // 4 pixels from each nibble, SSE2 has no blendv so the palette is picked with and/andnot/or
+    void ExpandSse2(uint64_t const* bits, size_t words, uint32_t* out, Palette palette)
+    {
+        const __m128i select = _mm_set_epi32(1, 2, 4, 8); // first pixel is the top bit of the nibble
+        const __m128i off = _mm_set1_epi32(static_cast<int>(palette.off));
+        const __m128i on = _mm_set1_epi32(static_cast<int>(palette.on));
+
+        for (size_t word = 0; word < words; ++word)
+        {
+            uint64_t line = bits[word];
+
+            for (int shift = 60; shift >= 0; shift -= 4)
+            {
+                __m128i nibble = _mm_set1_epi32(static_cast<int>((line >> shift) & 0xF));
+                __m128i lit = _mm_cmpeq_epi32(_mm_and_si128(nibble, select), select);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_or_si128(_mm_and_si128(lit, on), _mm_andnot_si128(lit, off)));
+                out += 4;
+            }
+        }
+    }
+
+    // 8 pixels from each byte
+    __attribute__((target("avx2")))
+    void ExpandAvx2(uint64_t const* bits, size_t words, uint32_t* out, Palette palette)
+    {
+        const __m256i select = _mm256_set_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+        const __m256i off = _mm256_set1_epi32(static_cast<int>(palette.off));
+        const __m256i on = _mm256_set1_epi32(static_cast<int>(palette.on));
+
+        for (size_t word = 0; word < words; ++word)
+        {
+            uint64_t line = bits[word];
+
+            for (int shift = 56; shift >= 0; shift -= 8)
+            {
+                __m256i byte = _mm256_set1_epi32(static_cast<int>((line >> shift) & 0xFF));
+                __m256i lit = _mm256_cmpeq_epi32(_mm256_and_si256(byte, select), select);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), _mm256_blendv_epi8(off, on, lit));
+                out += 8;
+            }
+        }
+    }
+#else
+    // anywhere else, one pixel at a time
+    void ExpandScalar(uint64_t const* bits, size_t words, uint32_t* out, Palette palette)
+    {
+        for (size_t word = 0; word < words; ++word)
+        {
+            for (unsigned int bit = 0; bit < 64; ++bit)
+            {
+                *out++ = ((bits[word] >> (63 - bit)) & 1) ? palette.on : palette.off;
+            }
+        }
+    }
+#endif
+
+    typedef void (*ExpandKernel)(uint64_t const* bits, size_t words, uint32_t* out, Palette palette);
+
+    struct Kernel
+    {
+        ExpandKernel expand;
+        char const* name;
+    };
+
+    Kernel PickKernel()
+    {
+#ifdef CHIP8_SCALER_X64
+        if (__builtin_cpu_supports("avx2"))
+        {
+            return Kernel{ ExpandAvx2, "avx2" };
+        }
+        return Kernel{ ExpandSse2, "sse2" };
+#else
+        return Kernel{ ExpandScalar, "scalar" };
+#endif
+    }
+
+    Kernel const& ActiveKernel()
+    {
+        static const Kernel kernel = PickKernel();
+        return kernel;
+    }
+
+    // bit i of x goes to bit 2i
+    uint64_t Spread(uint32_t x)
+    {
+        uint64_t v = x;
+        v = (v | (v << 16)) & 0x0000FFFF0000FFFFull;
+        v = (v | (v << 8)) & 0x00FF00FF00FF00FFull;
+        v = (v | (v << 4)) & 0x0F0F0F0F0F0F0F0Full;
+        v = (v | (v << 2)) & 0x3333333333333333ull;
+        v = (v | (v << 1)) & 0x5555555555555555ull;
+        return v;
+    }
+
+    // every bit of in repeated factor times, most significant bit first. the odd part of the factor goes in as runs, which is about one
+    // step per source pixel, and every factor of two after that is a Spread of whole words
+    void Stretch(uint64_t const* in, unsigned int words, unsigned int factor, uint64_t* out)
+    {
+        unsigned int odd = factor;
+        while (odd % 2 == 0)
+        {
+            odd /= 2;
+        }
+
+        if (odd == 1)
+        {
+            std::copy(in, in + words, out);
+        }
+        else
+        {
+            uint64_t* next = out;
+            uint64_t pending = 0;
+            unsigned int filled = 0;
+
+            for (unsigned int word = 0; word < words; ++word)
+            {
+                for (int bit = 63; bit >= 0; --bit)
+                {
+                    uint64_t ones = 0 - ((in[word] >> bit) & 1); // all ones for a lit pixel
+                    unsigned int left = odd;
+
+                    while (left > 0)
+                    {
+                        unsigned int take = std::min(left, 64 - filled);
+                        pending = (take == 64) ? ones : (pending << take) | (ones >> (64 - take));
+                        filled += take;
+                        left -= take;
+
+                        if (filled == 64)
+                        {
+                            *next++ = pending;
+                            pending = 0;
+                            filled = 0;
+                        }
+                    }
+                }
+            }
+        }
+
+        // doubling in place from the back, word i only ever lands on words 2i and 2i + 1 which nothing still to come reads
+        for (unsigned int have = words * odd; have < words * factor; have *= 2)
+        {
+            for (unsigned int i = have; i-- > 0;)
+            {
+                uint64_t word = out[i];
+                out[2 * i + 1] = Spread(static_cast<uint32_t>(word)) * 3;
+                out[2 * i] = Spread(static_cast<uint32_t>(word >> 32)) * 3;
+            }
+        }
+    }
+
+    // left and right pixels side by side, left first, 64 pixels each into 128
+    void Interleave(uint64_t left, uint64_t right, uint64_t* out)
+    {
+        out[0] = (Spread(static_cast<uint32_t>(left >> 32)) << 1) | Spread(static_cast<uint32_t>(right >> 32));
+        out[1] = (Spread(static_cast<uint32_t>(left)) << 1) | Spread(static_cast<uint32_t>(right));
+    }
+
+    // EPX on a whole row of 1 bit pixels at once. with only two colours every "equal" in the usual rules is an xnor, so each of the
+    // four output pixels is one mask over the row. pixels past the edge count as copies of the edge pixel
+    //      A
+    //    C P B   ->   E0 E1
+    //      D          E2 E3
+    void Scale2xRow(uint64_t above, uint64_t row, uint64_t below, uint64_t* top, uint64_t* bottom)
+    {
+        const uint64_t FIRST = 1ull << 63;
+        uint64_t a = above;
+        uint64_t d = below;
+        uint64_t c = (row >> 1) | (row & FIRST); // left neighbour lined up with each pixel
+        uint64_t b = (row << 1) | (row & 1);     // right neighbour
+        uint64_t p = row;
+
+        uint64_t use0 = ~(c ^ a) & (c ^ d) & (a ^ b);
+        uint64_t use1 = ~(a ^ b) & (a ^ c) & (b ^ d);
+        uint64_t use2 = ~(d ^ c) & (d ^ b) & (c ^ a);
+        uint64_t use3 = ~(b ^ d) & (b ^ a) & (d ^ c);
+
+        uint64_t e0 = (use0 & a) | (~use0 & p);
+        uint64_t e1 = (use1 & b) | (~use1 & p);
+        uint64_t e2 = (use2 & c) | (~use2 & p);
+        uint64_t e3 = (use3 & d) | (~use3 & p);
+
+        Interleave(e0, e1, top);
+        Interleave(e2, e3, bottom);
+    }
+
+    // one output row of bits into pixels, then copied down for the rest of its block
+    void EmitRow(uint64_t const* bits, unsigned int width, unsigned int copies, uint32_t* out, size_t pitch, Palette palette)
+    {
+        ActiveKernel().expand(bits, width / 64, out, palette);
+
+        for (unsigned int copy = 1; copy < copies; ++copy)
+        {
+            std::memcpy(out + copy * pitch, out, width * sizeof(uint32_t));
+        }
+    }
+}
+
+bool ScaleVideo(uint64_t const* video, uint32_t* out, size_t pitch, unsigned int factor, ScaleFilter filter, Palette palette,
+    unsigned int firstRow, unsigned int rowCount)
+{
+    if (factor == 0 || factor > MAX_SCALE || (filter == ScaleFilter::Scale2x && factor % 2 != 0))
+    {
+        return false;
+    }
+
+    unsigned int width = VIDEO_WIDTH * factor;
+    unsigned int endRow = std::min(firstRow + rowCount, VIDEO_HEIGHT);
+    uint64_t line[MAX_SCALE]; // one output row as bits
+
+    for (unsigned int y = firstRow; y < endRow; ++y)
+    {
+        uint32_t* block = out + size_t(y) * factor * pitch; // first output row for this source row
+
+        if (filter == ScaleFilter::Nearest)
+        {
+            Stretch(&video[y], 1, factor, line);
+            EmitRow(line, width, factor, block, pitch, palette);
+            continue;
+        }
+
+        uint64_t top[2];
+        uint64_t bottom[2];
+        Scale2xRow(video[(y > 0) ? y - 1 : y], video[y], video[(y + 1 < VIDEO_HEIGHT) ? y + 1 : y], top, bottom);
+
+        unsigned int grow = factor / 2;
+        Stretch(top, 2, grow, line);
+        EmitRow(line, width, grow, block, pitch, palette);
+        Stretch(bottom, 2, grow, line);
+        EmitRow(line, width, grow, block + grow * pitch, pitch, palette);
+    }
+    return true;
+}
+
+Palette ParsePalette(char const* text, Palette fallback)
+{
+    Palette palette = fallback;
+    char* end = nullptr;
+
+    uint32_t off = static_cast<uint32_t>(std::strtoul(text, &end, 16));
+    if (end != text)
+    {
+        palette.off = off;
+    }
+
+    if (*end == ',')
+    {
+        char const* onText = end + 1;
+        uint32_t on = static_cast<uint32_t>(std::strtoul(onText, &end, 16));
+        if (end != onText)
+        {
+            palette.on = on;
+        }
+    }
+    return palette;
+}
+
+void ExpandBits(uint64_t const* bits, size_t pixelCount, uint32_t* out, Palette palette)
+{
+    ActiveKernel().expand(bits, pixelCount / 64, out, palette);
+}
+
+char const* ScalerKernel()
+{
+    return ActiveKernel().name;
+}
@@ -0,0 +1,42 @@
+#ifndef SCALER_HPP
+#define SCALER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include "Chip8.hpp"
+
+
+// cpu side scaling of the 1 bit display to RGBA, for software rendered windows and headless capture where there is no gpu to stretch
+// a 64x32 texture. every filter first works out each output row as bits (64 source pixels at a time, in plain 64 bit words) and then
+// turns the bits into pixels through the palette with SSE2, or AVX2 on cpus that have it, 8 pixels per instruction
+struct Palette
+{
+	uint32_t off = 0x00000000; // RGBA8888, the same as SDL_PIXELFORMAT_RGBA8888 on a little endian host
+	uint32_t on = 0xFFFFFFFF;
+};
+
+// "RRGGBBAA,RRGGBBAA", off then on, anything missing keeps the fallback colour
+Palette ParsePalette(char const* text, Palette fallback = Palette{});
+
+enum class ScaleFilter
+{
+	Nearest, // every pixel becomes a factor x factor block
+	Scale2x, // EPX, diagonal edges get rounded off instead of staircased. factor has to be even, the 2x result is then grown by factor / 2
+};
+
+const unsigned int MAX_SCALE = 32;
+
+// writes VIDEO_WIDTH * factor by VIDEO_HEIGHT * factor pixels into out, pitch is in pixels and at least VIDEO_WIDTH * factor
+// with firstRow and rowCount only the output rows made from those source rows are written. Scale2x looks at the rows above and below,
+// so a changed row changes the output of its neighbours too and callers that track changed rows should widen them by one each way.
+// false (and nothing written) if the factor is 0, over MAX_SCALE, or odd for Scale2x
+bool ScaleVideo(uint64_t const* video, uint32_t* out, size_t pitch, unsigned int factor, ScaleFilter filter = ScaleFilter::Nearest,
+	Palette palette = Palette{}, unsigned int firstRow = 0, unsigned int rowCount = VIDEO_HEIGHT);
+
+// bits to pixels, most significant bit first, pixelCount a multiple of 64
+void ExpandBits(uint64_t const* bits, size_t pixelCount, uint32_t* out, Palette palette);
+
+char const* ScalerKernel(); // "avx2", "sse2" or "scalar", whichever ExpandBits runs on this machine
+
+
+#endif
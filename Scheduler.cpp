@@ -0,0 +1,145 @@
+#include "Scheduler.hpp"
+#include "Capture.hpp"
+#include <algorithm>
+#include <thread>
+
+
+Scheduler::Scheduler(Chip8& chip8, unsigned int instructionsPerSecond)
+    : chip8(chip8)
+    , instructionsPerSecond(std::max(1u, instructionsPerSecond))
+{}
+
+void Scheduler::SetInstructionsPerSecond(unsigned int rate)
+{
+    rate = std::max(1u, rate);
+
+    // rescale how far we are toward the next tick so changing speed mid run doesnt make a tick come early or late
+    tickPhase = tickPhase * rate / instructionsPerSecond;
+    instructionsPerSecond = rate;
+}
+
+unsigned int Scheduler::InstructionsPerSecond() const
+{
+    return instructionsPerSecond;
+}
+
+void Scheduler::SetCapture(Capture* value)
+{
+    capture = value;
+}
+
+// how many more instructions run before the next 60hz tick, rounded up so the tick lands after a whole instruction
+uint64_t Scheduler::InstructionsUntilTick() const
+{
+    uint64_t remaining = instructionsPerSecond - tickPhase;
+    return (remaining + TIMER_HZ - 1) / TIMER_HZ;
+}
+
+void Scheduler::RunInstructions(uint64_t count)
+{
+    while (count > 0)
+    {
+        // run straight up to the next tick, or to the end of the request if that comes first
+        uint64_t batch = std::min(count, InstructionsUntilTick());
+
+        chip8.Run(static_cast<unsigned int>(batch));
+        instructions += batch;
+        count -= batch;
+        tickPhase += batch * TIMER_HZ;
+
+        if (tickPhase >= instructionsPerSecond)
+        {
+            tickPhase -= instructionsPerSecond;
+            chip8.TickTimers();
+            ++frames;
+
+            if (capture)
+            {
+                capture->Frame(chip8.video);
+            }
+        }
+    }
+}
+
+void Scheduler::RunFrames(uint64_t count)
+{
+    uint64_t target = frames + count;
+
+    while (frames < target)
+    {
+        RunInstructions(InstructionsUntilTick());
+    }
+}
+
+void Scheduler::SetSpeed(double multiplier)
+{
+    speed = std::max(0.0, multiplier);
+    pacing = false; // the old deadlines mean nothing at the new speed, start counting again from the next frame
+}
+
+double Scheduler::Speed() const
+{
+    return speed;
+}
+
+bool Scheduler::Unthrottled() const
+{
+    return speed <= 0.0;
+}
+
+bool Scheduler::Pace()
+{
+    const auto frameDuration = std::chrono::nanoseconds(1000000000 / TIMER_HZ);
+    const auto maxLag = frameDuration * 5; // if we fall further behind than this we skip ahead instead of rushing to catch up
+
+    Clock::time_point now = Clock::now();
+    if (!pacing)
+    {
+        paceStart = now;
+        pacedFrames = 0;
+        nextPresent = now;
+        pacing = true;
+    }
+    ++pacedFrames;
+
+    if (!Unthrottled())
+    {
+        // absolute deadline for the end of this frame, sleep_until gives the cpu back to the os until then
+        Clock::time_point deadline = paceStart
+            + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(pacedFrames / (TIMER_HZ * speed)));
+
+        if (now > deadline + maxLag)
+        {
+            paceStart = now;
+            pacedFrames = 0;
+        }
+        else
+        {
+            std::this_thread::sleep_until(deadline);
+            now = Clock::now();
+        }
+
+        if (speed <= 1.0)
+        {
+            return true;
+        }
+    }
+
+    // frames come faster than real time, but the screen still only needs to change 60 times a real second
+    if (now < nextPresent)
+    {
+        return false;
+    }
+    nextPresent = now + frameDuration;
+    return true;
+}
+
+uint64_t Scheduler::Instructions() const
+{
+    return instructions;
+}
+
+uint64_t Scheduler::Frames() const
+{
+    return frames;
+}
@@ -0,0 +1,66 @@
+#ifndef SCHEDULER_HPP
+#define SCHEDULER_HPP
+
+#include <chrono>
+#include <cstdint>
+#include "Chip8.hpp"
+
+class Capture;
+
+
+// drives a Chip8 in emulated time
+// the cpu runs at a configurable number of instructions per second and the timers tick at exactly 60hz of that same emulated time,
+// so a game sees the same number of instructions between timer ticks whether it runs at real speed, 100x or completely unthrottled
+class Scheduler
+{
+public:
+	static const unsigned int TIMER_HZ = 60;
+
+	explicit Scheduler(Chip8& chip8, unsigned int instructionsPerSecond = 700);
+
+	void SetInstructionsPerSecond(unsigned int instructionsPerSecond);
+	unsigned int InstructionsPerSecond() const;
+
+	// the display goes to capture after every timer tick, so a capture gets one frame per emulated 60hz frame at any speed. null stops it
+	void SetCapture(Capture* capture);
+
+	// emulated time only, runs as fast as the host allows
+	void RunInstructions(uint64_t count);
+	void RunFrames(uint64_t frames); // runs until the timers have ticked this many times
+
+	// real time pacing for a loop that runs one frame at a time. 1.0 is real time, 100.0 runs 100 emulated seconds per real second
+	// and 0 is unthrottled, frames run back to back as fast as the host allows. the instruction to timer ratio is the same at any speed
+	void SetSpeed(double multiplier);
+	double Speed() const;
+	bool Unthrottled() const;
+
+	// call once for every frame the loop runs, sleeps until that frame is due at the current speed and doesnt sleep at all unthrottled.
+	// true when the frame should go to the screen: every frame up to real time, at most 60 a real second when running faster than that
+	bool Pace();
+
+	uint64_t Instructions() const; // instructions executed so far
+	uint64_t Frames() const;       // timer ticks so far
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	uint64_t InstructionsUntilTick() const;
+
+	Chip8& chip8;
+	unsigned int instructionsPerSecond;
+	Capture* capture = nullptr; // not owned
+
+	// each instruction adds TIMER_HZ and a tick happens every instructionsPerSecond, this keeps the 60hz exact with no rounding drift
+	uint64_t tickPhase = 0;
+	uint64_t instructions = 0;
+	uint64_t frames = 0;
+
+	double speed = 1.0;
+	bool pacing = false;         // false until the first Pace, and again after a speed change
+	Clock::time_point paceStart; // deadlines are counted from here so rounding in one frame never adds up over many
+	uint64_t pacedFrames = 0;
+	Clock::time_point nextPresent;
+};
+
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef SPSCQUEUE_HPP
+#define SPSCQUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+
+
+// lock free ring for exactly one producer thread and one consumer thread
+// the producer only ever writes tail and the consumer only ever writes head, so neither side waits on the other. each side also
+// keeps its own copy of the others index and only reloads it when the ring looks full (or empty), so most pushes and pops touch no
+// cache line the other thread is writing
+template <typename T, size_t Capacity>
+class SpscQueue
+{
+public:
+	static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "capacity has to be a power of two");
+
+	bool Push(T const& value) // producer only, false when the ring is full
+	{
+		size_t position = tail.load(std::memory_order_relaxed);
+
+		if (position - headSeen == Capacity)
+		{
+			headSeen = head.load(std::memory_order_acquire);
+			if (position - headSeen == Capacity)
+			{
+				return false;
+			}
+		}
+
+		slots[position & (Capacity - 1)] = value;
+		tail.store(position + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool Pop(T& value) // consumer only, false when the ring is empty
+	{
+		size_t position = head.load(std::memory_order_relaxed);
+
+		if (position == tailSeen)
+		{
+			tailSeen = tail.load(std::memory_order_acquire);
+			if (position == tailSeen)
+			{
+				return false;
+			}
+		}
+
+		value = slots[position & (Capacity - 1)];
+		head.store(position + 1, std::memory_order_release);
+		return true;
+	}
+
+private:
+	alignas(64) std::atomic<size_t> head{0}; // next slot to pop, written by the consumer
+	size_t tailSeen = 0;                      // the consumers last look at tail
+
+	alignas(64) std::atomic<size_t> tail{0}; // next slot to push, written by the producer
+	size_t headSeen = 0;                      // the producers last look at head
+
+	alignas(64) T slots[Capacity];
+};
+
+
+#endif
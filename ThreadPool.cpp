@@ -0,0 +1,138 @@
+#include "ThreadPool.hpp"
+
+
+ThreadPool::ThreadPool(unsigned threadCount)
+{
+    if (threadCount == 0)
+    {
+        threadCount = std::thread::hardware_concurrency();
+    }
+
+    if (threadCount == 0) // hardware_concurrency is allowed to return 0 if it cant tell
+    {
+        threadCount = 1;
+    }
+
+    for (unsigned i = 0; i < threadCount; ++i)
+    {
+        queues.push_back(std::make_unique<WorkQueue>());
+    }
+
+    // start the threads only after every queue exists, a worker may try to steal as soon as it starts
+    for (unsigned i = 0; i < threadCount; ++i)
+    {
+        threads.emplace_back(&ThreadPool::WorkerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+// hand out tasks round robin so the queues start out balanced, stealing fixes whatever imbalance is left
+void ThreadPool::Submit(Task task)
+{
+    unsigned id = nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+
+    pending.fetch_add(1);
+    {
+        // count the task before it is visible in a queue so queued never dips below zero when a worker grabs it right away
+        // taking the sleep lock here also means a worker cant miss the wakeup between checking queued and going to sleep
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        queued.fetch_add(1);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queues[id]->mutex);
+        queues[id]->tasks.push_back(std::move(task));
+    }
+    wake.notify_one();
+}
+
+void ThreadPool::Wait()
+{
+    std::unique_lock<std::mutex> lock(sleepMutex);
+    idle.wait(lock, [this] { return pending.load() == 0; });
+}
+
+unsigned ThreadPool::Size() const
+{
+    return static_cast<unsigned>(threads.size());
+}
+
+// the owner works LIFO from the back, newest task is the one most likely to still be in cache
+bool ThreadPool::PopLocal(unsigned id, Task& task)
+{
+    WorkQueue& queue = *queues[id];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+
+    if (queue.tasks.empty())
+    {
+        return false;
+    }
+
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    return true;
+}
+
+// thieves take from the front, the oldest task, so they stay out of the owners way
+bool ThreadPool::Steal(unsigned id, Task& task)
+{
+    size_t count = queues.size();
+
+    for (size_t offset = 1; offset < count; ++offset)
+    {
+        WorkQueue& victim = *queues[(id + offset) % count];
+        std::unique_lock<std::mutex> lock(victim.mutex, std::try_to_lock); // a busy queue is skipped, not waited on
+
+        if (lock.owns_lock() && !victim.tasks.empty())
+        {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ThreadPool::WorkerLoop(unsigned id)
+{
+    for (;;)
+    {
+        Task task;
+
+        if (PopLocal(id, task) || Steal(id, task))
+        {
+            queued.fetch_sub(1);
+            task();
+
+            if (pending.fetch_sub(1) == 1) // this was the last outstanding task
+            {
+                std::lock_guard<std::mutex> lock(sleepMutex);
+                idle.notify_all();
+            }
+            continue;
+        }
+
+        // nothing to run anywhere, sleep until a task is submitted or the pool shuts down
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [this] { return stopping.load() || queued.load() > 0; });
+
+        if (stopping && queued.load() == 0)
+        {
+            return;
+        }
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// work stealing thread pool, every worker owns its own queue of tasks so the workers dont fight over a single lock
+// a worker takes new work from the back of its own queue, and when it runs out it steals from the front of another workers queue
+class ThreadPool
+{
+public:
+	using Task = std::function<void()>;
+
+	explicit ThreadPool(unsigned threadCount = 0); // 0 means one thread per hardware core
+	~ThreadPool();
+
+	ThreadPool(ThreadPool const&) = delete;
+	ThreadPool& operator=(ThreadPool const&) = delete;
+
+	void Submit(Task task);
+	void Wait(); // blocks until every submitted task has finished
+	unsigned Size() const;
+
+private:
+	// each queue sits on its own cache line so two workers touching their own queues dont slow each other down
+	struct alignas(64) WorkQueue
+	{
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	void WorkerLoop(unsigned id);
+	bool PopLocal(unsigned id, Task& task);
+	bool Steal(unsigned id, Task& task);
+
+	std::vector<std::unique_ptr<WorkQueue>> queues;
+	std::vector<std::thread> threads;
+
+	std::atomic<size_t> queued{0};  // tasks sitting in a queue
+	std::atomic<size_t> pending{0}; // tasks queued or running
+	std::atomic<unsigned> nextQueue{0};
+	std::atomic<bool> stopping{false};
+
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	std::condition_variable idle;
+};
+
+
+#endif
@@ -0,0 +1,103 @@
+#include "Trace.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ostream>
+#include <unistd.h>
+
+
+Trace::Trace()
+    : records(new TraceRecord[CAPACITY]{})
+{}
+
+void Trace::SetLevel(TraceLevel value)
+{
+    level = value;
+}
+
+TraceLevel Trace::Level() const
+{
+    return level;
+}
+
+uint64_t Trace::Recorded() const
+{
+    return head.load(std::memory_order_acquire);
+}
+
+namespace
+{
+    // write everything or give up, write(2) is allowed to do less than asked
+    void WriteAll(int fd, void const* data, size_t size)
+    {
+        char const* bytes = static_cast<char const*>(data);
+
+        while (size > 0)
+        {
+            ssize_t written = write(fd, bytes, size);
+            if (written <= 0)
+            {
+                return;
+            }
+            bytes += written;
+            size -= static_cast<size_t>(written);
+        }
+    }
+}
+
+void Trace::DumpBinary(int fd) const
+{
+    uint64_t end = head.load(std::memory_order_acquire);
+    uint32_t count = static_cast<uint32_t>(std::min<uint64_t>(end, CAPACITY));
+
+    // header built by hand into a byte array, no allocation and no stdio so this works inside a crash handler
+    uint8_t header[12];
+    uint16_t version = 1;
+    uint16_t recordSize = sizeof(TraceRecord);
+    std::memcpy(header, "C8TR", 4);
+    std::memcpy(header + 4, &version, 2);
+    std::memcpy(header + 6, &recordSize, 2);
+    std::memcpy(header + 8, &count, 4);
+    WriteAll(fd, header, sizeof(header));
+
+    // oldest record first, the ring may have wrapped so this can be two pieces
+    uint64_t first = end - count;
+    unsigned int start = static_cast<unsigned int>(first & (CAPACITY - 1));
+    unsigned int firstPiece = std::min<unsigned int>(count, CAPACITY - start);
+
+    WriteAll(fd, &records[start], firstPiece * sizeof(TraceRecord));
+    WriteAll(fd, &records[0], (count - firstPiece) * sizeof(TraceRecord));
+}
+
+char const* Trace::EventName(TraceEvent event)
+{
+    switch (event)
+    {
+        case TraceEvent::Execute: return "execute";
+        case TraceEvent::Draw: return "draw";
+        case TraceEvent::Clear: return "clear";
+        case TraceEvent::MemoryWrite: return "memory-write";
+        case TraceEvent::TimerTick: return "timer-tick";
+        case TraceEvent::RomLoaded: return "rom-loaded";
+        case TraceEvent::BadOpcode: return "bad-opcode";
+    }
+    return "unknown";
+}
+
+// one line per record, cycle pc opcode event and the raw a b c fields
+void Trace::DumpText(std::ostream& out) const
+{
+    uint64_t end = head.load(std::memory_order_acquire);
+    uint64_t count = std::min<uint64_t>(end, CAPACITY);
+
+    for (uint64_t i = end - count; i < end; ++i)
+    {
+        TraceRecord const& record = records[i & (CAPACITY - 1)];
+        char line[96];
+
+        std::snprintf(line, sizeof(line), "%llu pc=%03X op=%04X %s %u %u %u\n",
+            static_cast<unsigned long long>(record.cycle), record.pc, record.opcode,
+            EventName(static_cast<TraceEvent>(record.event)), record.a, record.b, record.c);
+        out << line;
+    }
+}
@@ -0,0 +1,94 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+
+
+// how much gets recorded, every level includes the ones above it
+enum class TraceLevel : uint8_t
+{
+	Off = 0,
+	Error,   // bad opcodes
+	Info,    // draws, screen clears, rom loads
+	Debug,   // timer ticks, memory writes
+	Verbose  // every instruction executed by the interpreter
+};
+
+enum class TraceEvent : uint8_t
+{
+	Execute = 0, // a, b, c unused
+	Draw,        // a = x, b = y, c = height
+	Clear,
+	MemoryWrite, // a b = address high and low byte, c = length
+	TimerTick,   // a = delay timer, b = sound timer
+	RomLoaded,   // a b = size high and low byte
+	BadOpcode
+};
+
+// fixed size binary record, 16 bytes so a dump is just the ring buffer written out
+struct TraceRecord
+{
+	uint64_t cycle;
+	uint16_t pc;
+	uint16_t opcode;
+	uint8_t event;
+	uint8_t a;
+	uint8_t b;
+	uint8_t c;
+};
+static_assert(sizeof(TraceRecord) == 16, "TraceRecord is part of the dump format");
+
+// per instance ring buffer of trace records
+// there is one writer, the thread running the chip8, and it never blocks or allocates. anyone can read the ring at any time,
+// including from a signal handler after a crash, which is what DumpBinary is for
+//
+// dump format: "C8TR", uint16 version, uint16 record size, uint32 record count, then the records oldest first
+class Trace
+{
+public:
+	static const unsigned int CAPACITY = 4096; // records kept, a power of two so the index wraps with a mask
+
+	Trace();
+
+	void SetLevel(TraceLevel level);
+	TraceLevel Level() const;
+	bool Enabled(TraceLevel wanted) const
+	{
+		return wanted <= level;
+	}
+
+	void Record(uint64_t cycle, uint16_t pc, uint16_t opcode, TraceEvent event, uint8_t a = 0, uint8_t b = 0, uint8_t c = 0)
+	{
+		uint64_t position = head.load(std::memory_order_relaxed);
+		records[position & (CAPACITY - 1)] = TraceRecord{cycle, pc, opcode, static_cast<uint8_t>(event), a, b, c};
+		head.store(position + 1, std::memory_order_release); // a reader that sees the new head also sees the record
+	}
+
+	uint64_t Recorded() const; // total records ever written, the ring holds the last CAPACITY of them
+
+	void DumpBinary(int fd) const; // only uses write(2), safe to call from a signal handler
+	void DumpText(std::ostream& out) const;
+
+	static char const* EventName(TraceEvent event);
+
+private:
+	TraceLevel level = TraceLevel::Off;
+	std::atomic<uint64_t> head{0}; // total records written, the next one goes at head & (CAPACITY - 1)
+	std::unique_ptr<TraceRecord[]> records;
+};
+
+
+// trace points compile to nothing unless the build turns on CHIP8_TRACE
+// when it is on, a trace point costs one pointer check and one compare while the level is below it
+#ifdef CHIP8_TRACE
+#define CHIP8_TRACE_RECORD(tracePtr, level, cycle, pc, opcode, ...) \
+	do { if ((tracePtr) && (tracePtr)->Enabled(level)) (tracePtr)->Record((cycle), (pc), (opcode), __VA_ARGS__); } while (0)
+#else
+#define CHIP8_TRACE_RECORD(tracePtr, level, cycle, pc, opcode, ...) do {} while (0)
+#endif
+
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef TRIPLEBUFFER_HPP
+#define TRIPLEBUFFER_HPP
+
+#include <atomic>
+#include <cstdint>
+
+
+// lock free handoff of whole values from one writer thread to one reader thread, where only the newest value matters
+// three slots: the writer fills the back one, the reader reads the front one, and the middle one holds the newest finished value.
+// Publish swaps back and middle and Update swaps front and middle, each with one atomic exchange. neither side ever waits, the writer
+// can publish as often as it likes (values the reader never got to are simply overwritten) and the reader always gets the newest one
+template <typename T>
+class TripleBuffer
+{
+public:
+	T& Back() // writer only, the slot to fill before Publish
+	{
+		return slots[back].value;
+	}
+
+	void Publish() // writer only
+	{
+		back = middle.exchange(static_cast<uint8_t>(back | FRESH), std::memory_order_acq_rel) & INDEX;
+	}
+
+	bool Update() // reader only, true if a value newer than Front was published since the last Update
+	{
+		if (!(middle.load(std::memory_order_relaxed) & FRESH))
+		{
+			return false;
+		}
+
+		front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+		return true;
+	}
+
+	T const& Front() const // reader only
+	{
+		return slots[front].value;
+	}
+
+private:
+	static const uint8_t INDEX = 3; // low bits of middle, which slot is in the middle
+	static const uint8_t FRESH = 4; // set by Publish, cleared by Update
+
+	struct alignas(64) Slot
+	{
+		T value{};
+	};
+	Slot slots[3];
+
+	alignas(64) std::atomic<uint8_t> middle{1};
+	alignas(64) uint8_t back = 0;  // only the writer touches this
+	alignas(64) uint8_t front = 2; // only the reader touches this
+};
+
+
+#endif
@@ -0,0 +1,67 @@
+#include <iostream>
+#include <fstream>
+#include <cstdint>
+#include "AotCompiler.hpp"
+#include "Quirks.hpp"
+#include "RomLibrary.hpp"
+
+
+// compiles one rom ahead of time to C++, for a chip8_native build of it (see Aot.hpp and AotCompiler.hpp)
+// what the command line could look like
+    // ./chip8_aot roms/PONG.ch8 pong_aot.cpp
+        // the blocks are compiled for the rom's quirks, CHIP8_QUIRKS or CHIP8_QUIRK_PROFILES pick them like for chip8_headless
+        // a run with other quirks never uses them, the interpreter runs the rom then
+        // or let cmake do all of it: cmake -DCHIP8_AOT_ROM=roms/PONG.ch8 builds chip8_native with PONG compiled in
+int main(int argc, char** argv)
+{
+    if (argc != 3)
+    {
+        std::cerr << "Usage:" << argv[0] << " <ROM> <Output.cpp>\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    char const* romFilename = argv[1];
+    char const* outputFilename = argv[2];
+
+    RomLibrary library;
+    if (!library.Open(romFilename) || library.Count() != 1)
+    {
+        std::cerr << "Could not read rom " << romFilename << "\n";
+        std::exit(EXIT_FAILURE);
+    }
+    RomImage const& rom = library.Rom(0);
+
+    QuirkProfiles profiles;
+    if (!profiles.LoadEnvironment())
+    {
+        std::exit(EXIT_FAILURE);
+    }
+
+    QuirkProfile profile = profiles.For(rom);
+    if (profile.machine != Machine::Chip8)
+    {
+        std::cerr << rom.name << " is a " << ProfileName(profile) << " rom, only chip8 roms can be compiled\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    AotCompiler compiler(rom.data, rom.size, profile.quirks);
+
+    std::ofstream output(outputFilename);
+    compiler.Write(output, rom.name, rom.hash);
+    output.close();
+    if (!output)
+    {
+        std::cerr << "Could not write " << outputFilename << "\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    std::cout << "Rom: " << rom.name << "\n";
+    std::cout << "Quirks: " << QuirksName(profile.quirks) << "\n";
+    std::cout << "Blocks: " << compiler.BlockCount() << "\n";
+    std::cout << "Code: " << compiler.CodeBytes() << " bytes\n";
+    std::cout << "Data: " << compiler.DataBytes() << " bytes\n";
+    std::cout << "Computed jumps: " << compiler.ComputedJumps() << "\n";
+    std::cout << "Self-modified blocks: " << compiler.SelfModified() << "\n";
+
+    return 0;
+}
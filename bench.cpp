@@ -0,0 +1,488 @@
+#include <iostream>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "Chip8.hpp"
+#include "ChipVariant.hpp"
+#include "Scaler.hpp"
+#include "Scheduler.hpp"
+
+
+// benchmark suite, micro benchmarks of single opcodes and whole frame throughput on synthetic roms, results go to stdout as json
+// what the command line could look like
+    // ./chip8_bench
+    // ./chip8_bench --quick             runs a tenth of the work, for a fast check rather than numbers worth comparing
+    // ./chip8_bench --write-roms roms   also writes the bundled roms to roms/bench_*.ch8 so chip8_headless can run them
+// each benchmark is repeated and the fastest run is reported, the slower ones are mostly the os getting in the way
+
+namespace
+{
+    const unsigned int ROM_START = 0x200;
+    const unsigned int ROM_SPACE = MEMORY_SIZE - ROM_START;
+    const unsigned int REPEATS = 5;
+
+    typedef std::vector<uint16_t> Program;
+
+    std::vector<uint8_t> Assemble(Program const& program)
+    {
+        std::vector<uint8_t> bytes;
+        for (uint16_t op : program)
+        {
+            bytes.push_back(static_cast<uint8_t>(op >> 8));
+            bytes.push_back(static_cast<uint8_t>(op));
+        }
+        return bytes;
+    }
+
+    // the setup instructions once, then op repeated until memory is full and a jump back to the first op
+    // the jump is one instruction in every ~1800 so the time is almost all op
+    std::vector<uint8_t> FillRom(Program const& setup, uint16_t op)
+    {
+        Program program = setup;
+        uint16_t loop = static_cast<uint16_t>(ROM_START + program.size() * 2);
+
+        while ((program.size() + 1) * 2 < ROM_SPACE)
+        {
+            program.push_back(op);
+        }
+        program.push_back(static_cast<uint16_t>(0x1000 | loop));
+
+        return Assemble(program);
+    }
+
+    // the workload roms loop forever, never grow the stack and never write over their own code
+    std::vector<uint8_t> AluRom()
+    {
+        return Assemble({
+            0x6001, 0x6102, 0x6203, 0x6304, 0x6405, 0x6506,
+            // 0x20C
+            0x8014, 0x8125, 0x8231, 0x8342, 0x8403, 0x8450,
+            0x8016, 0x810E, 0x8237, 0x8345, 0x7005, 0x71FB,
+            0x8504, 0x8512, 0x8526, 0x853E, 0xF01E, 0xF11E,
+            0x120C,
+        });
+    }
+
+    std::vector<uint8_t> BranchRom()
+    {
+        std::vector<uint8_t> rom = Assemble({
+            0x6000, 0x6100,
+            // 0x204
+            0x7001,         // V0 += 1
+            0x3000,         // skip the call when V0 wraps to 0
+            0x2300,         // call 0x300
+            0x4080,         // skip unless V0 == 0x80
+            0x7101,
+            0x5010,         // skip if V0 == V1
+            0x7201,
+            0x9010,         // skip if V0 != V1
+            0x7301,
+            0x1204,
+        });
+
+        // subroutine at 0x300
+        rom.resize(0x300 - ROM_START, 0);
+        std::vector<uint8_t> subroutine = Assemble({
+            0x7401,
+            0x3400,         // skip if V4 == 0
+            0x7501,
+            0x00EE,
+        });
+        rom.insert(rom.end(), subroutine.begin(), subroutine.end());
+        return rom;
+    }
+
+    std::vector<uint8_t> DrawRom()
+    {
+        return Assemble({
+            0xA050, 0x6000, 0x6100, 0x630F,
+            // 0x208
+            0xD015,         // font digit at V0, V1
+            0x7008,
+            0x7103,
+            0x8200,         // V2 = V0 & 0xF, then point I at that digit
+            0x8232,
+            0xF229,
+            0xD127,
+            0x7401,
+            0x4400,         // clear the screen once every 256 loops
+            0x00E0,
+            0x1208,
+        });
+    }
+
+    std::vector<uint8_t> MemoryRom()
+    {
+        return Assemble({
+            0x6000, 0x6111, 0x6222, 0x6333, 0x6444, 0x6555, 0x6666, 0x6777,
+            // 0x210
+            0xA400,         // data lives at 0x400, well clear of the code
+            0xF755,         // store V0..V7
+            0xF033,         // bcd of V0
+            0xF01E,
+            0xF765,         // load V0..V7
+            0x7013,
+            0xA480,
+            0xF355,
+            0xF265,
+            0x1210,
+        });
+    }
+
+    struct BundledRom
+    {
+        char const* name;
+        std::vector<uint8_t> (*build)();
+    };
+
+    const BundledRom bundledRoms[] =
+    {
+        { "alu", AluRom },
+        { "branch", BranchRom },
+        { "draw", DrawRom },
+        { "memory", MemoryRom },
+    };
+
+    bool WriteRom(std::string const& path, std::vector<uint8_t> const& rom)
+    {
+        FILE* file = std::fopen(path.c_str(), "wb");
+        if (!file)
+        {
+            return false;
+        }
+        bool written = std::fwrite(rom.data(), 1, rom.size(), file) == rom.size();
+        return (std::fclose(file) == 0) && written;
+    }
+
+    // LoadROM only takes a filename, so every rom goes through one scratch file
+    class ScratchRom
+    {
+    public:
+        ScratchRom()
+        {
+            char name[] = "/tmp/chip8_bench_XXXXXX";
+            int fd = mkstemp(name);
+            if (fd < 0)
+            {
+                std::cerr << "Could not create a scratch file for the roms\n";
+                std::exit(EXIT_FAILURE);
+            }
+            close(fd);
+            path = name;
+        }
+
+        ~ScratchRom()
+        {
+            unlink(path.c_str());
+        }
+
+        char const* Write(std::vector<uint8_t> const& rom)
+        {
+            if (!WriteRom(path, rom))
+            {
+                std::cerr << "Could not write " << path << "\n";
+                std::exit(EXIT_FAILURE);
+            }
+            return path.c_str();
+        }
+
+    private:
+        std::string path;
+    };
+
+    struct Result
+    {
+        std::string name;
+        std::string mode;
+        char const* unit;   // what ops counts, "instruction" or "load"
+        uint64_t ops;
+        double seconds;
+        uint64_t frames;    // only for the frame benchmarks
+    };
+
+    char const* ModeName(ExecMode mode)
+    {
+        switch (mode)
+        {
+            case ExecMode::Interpreter: return "interp";
+            case ExecMode::BlockCache: return "block";
+            case ExecMode::Jit: return "jit";
+            case ExecMode::Native: return "native";
+        }
+        return "unknown";
+    }
+
+    template <typename Body>
+    double Fastest(Body body)
+    {
+        double best = 0.0;
+        for (unsigned int i = 0; i < REPEATS; ++i)
+        {
+            auto start = std::chrono::steady_clock::now();
+            body();
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (i == 0 || seconds < best)
+            {
+                best = seconds;
+            }
+        }
+        return best;
+    }
+
+    // one opcode over and over through Cycle, so this is fetch plus decode plus whichever dispatch CHIP8_DISPATCH built plus the handler.
+    // Run never goes this way, the interpreter decodes each instruction once and calls its handler straight from then on
+    Result CycleMicro(ScratchRom& scratch, char const* name, std::vector<uint8_t> const& rom, unsigned int instructions)
+    {
+        Chip8 chip8;
+        chip8.LoadROM(scratch.Write(rom));
+        for (unsigned int i = 0; i < instructions / 10; ++i) // warm up
+        {
+            chip8.Cycle();
+        }
+
+        double seconds = Fastest([&]
+        {
+            for (unsigned int i = 0; i < instructions; ++i)
+            {
+                chip8.Cycle();
+            }
+        });
+        return Result{ name, "cycle", "instruction", instructions, seconds, 0 };
+    }
+
+    // one opcode over and over through the predecoded interpreter, so this is the handler plus the loop around it, no decode or dispatch
+    Result Micro(ScratchRom& scratch, char const* name, std::vector<uint8_t> const& rom, unsigned int instructions)
+    {
+        Chip8 chip8;
+        chip8.LoadROM(scratch.Write(rom));
+        chip8.Run(instructions / 10); // warm up
+
+        double seconds = Fastest([&]{ chip8.Run(instructions); });
+        return Result{ name, ModeName(ExecMode::Interpreter), "instruction", instructions, seconds, 0 };
+    }
+
+    // the same for a SUPER-CHIP or XO-CHIP machine, which is always interpreted
+    template <typename Variant>
+    Result VariantMicro(char const* name, std::vector<uint8_t> const& rom, unsigned int instructions)
+    {
+        Variant machine;
+        machine.LoadROM(rom.data(), rom.size());
+        machine.Run(instructions / 10); // warm up
+
+        double seconds = Fastest([&]{ machine.Run(instructions); });
+        return Result{ name, ModeName(ExecMode::Interpreter), "instruction", instructions, seconds, 0 };
+    }
+
+    Result LoadRom(ScratchRom& scratch, unsigned int loads)
+    {
+        char const* path = scratch.Write(FillRom({}, 0x6000)); // the biggest rom that fits
+        Chip8 chip8;
+
+        double seconds = Fastest([&]
+        {
+            for (unsigned int i = 0; i < loads; ++i)
+            {
+                chip8.LoadROM(path);
+            }
+        });
+        return Result{ "LoadROM", ModeName(ExecMode::Interpreter), "load", loads, seconds, 0 };
+    }
+
+    // the same rom from an image already in memory, what every instance after the first costs with a RomLibrary
+    Result LoadImage(unsigned int loads)
+    {
+        std::vector<uint8_t> rom = FillRom({}, 0x6000);
+        Chip8 chip8;
+
+        double seconds = Fastest([&]
+        {
+            for (unsigned int i = 0; i < loads; ++i)
+            {
+                chip8.LoadROM(rom.data(), rom.size());
+            }
+        });
+        return Result{ "LoadROM/image", ModeName(ExecMode::Interpreter), "load", loads, seconds, 0 };
+    }
+
+    // one whole screen of random pixels scaled to RGBA, the mode is the ExpandBits kernel this machine picked
+    Result Scale(ScaleFilter filter, unsigned int factor, unsigned int frames)
+    {
+        uint64_t video[VIDEO_HEIGHT]{};
+        uint32_t state = 0x2545F491;
+        for (uint64_t& row : video)
+        {
+            for (int byte = 0; byte < 8; ++byte)
+            {
+                row = (row << 8) | Chip8::RandomByte(state);
+            }
+        }
+
+        std::vector<uint32_t> pixels(VIDEO_WIDTH * factor * VIDEO_HEIGHT * factor);
+
+        double seconds = Fastest([&]
+        {
+            for (unsigned int i = 0; i < frames; ++i)
+            {
+                ScaleVideo(video, pixels.data(), VIDEO_WIDTH * factor, factor, filter);
+            }
+        });
+
+        std::string name = std::string("scale/") + ((filter == ScaleFilter::Scale2x) ? "scale2x/" : "nearest/") + std::to_string(factor);
+        return Result{ name, ScalerKernel(), "frame", frames, seconds, 0 };
+    }
+
+    // whole frames through the Scheduler, a fresh machine each run so every mode starts from the same cold caches
+    Result Frames(ScratchRom& scratch, BundledRom const& bundled, ExecMode mode, unsigned int frames, unsigned int cyclesPerFrame)
+    {
+        char const* path = scratch.Write(bundled.build());
+        uint64_t instructions = 0;
+
+        double seconds = Fastest([&]
+        {
+            Chip8 chip8;
+            chip8.SetExecMode(mode);
+            chip8.LoadROM(path);
+
+            Scheduler scheduler(chip8, cyclesPerFrame * Scheduler::TIMER_HZ);
+            scheduler.RunFrames(frames);
+            instructions = scheduler.Instructions();
+        });
+        return Result{ std::string("frame/") + bundled.name, ModeName(mode), "instruction", instructions, seconds, frames };
+    }
+
+    // which interpreter dispatch this build has, see CHIP8_DISPATCH in CMakeLists.txt
+    char const* DispatchName()
+    {
+#if defined(CHIP8_DISPATCH_GOTO)
+        return "goto";
+#elif defined(CHIP8_DISPATCH_SWITCH)
+        return "switch";
+#else
+        return "table";
+#endif
+    }
+
+    void PrintJson(std::vector<Result> const& results)
+    {
+        std::printf("{\n  \"version\": 1,\n  \"dispatch\": \"%s\",\n  \"repeats\": %u,\n  \"benchmarks\": [\n", DispatchName(), REPEATS);
+
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            Result const& result = results[i];
+            double perSecond = result.seconds > 0 ? result.ops / result.seconds : 0.0;
+            double nsPerOp = result.ops > 0 ? result.seconds * 1e9 / result.ops : 0.0;
+
+            std::printf("    {\"name\": \"%s\", \"mode\": \"%s\", \"unit\": \"%s\", \"ops\": %llu, \"seconds\": %.6f, \"ns_per_op\": %.3f",
+                result.name.c_str(), result.mode.c_str(), result.unit, static_cast<unsigned long long>(result.ops), result.seconds, nsPerOp);
+
+            if (std::strcmp(result.unit, "instruction") == 0)
+            {
+                std::printf(", \"instructions_per_sec\": %.0f", perSecond);
+            }
+            else
+            {
+                std::printf(", \"%ss_per_sec\": %.0f", result.unit, perSecond);
+            }
+
+            if (result.frames > 0)
+            {
+                std::printf(", \"frames_per_sec\": %.1f", result.seconds > 0 ? result.frames / result.seconds : 0.0);
+            }
+
+            std::printf("}%s\n", (i + 1 < results.size()) ? "," : "");
+        }
+
+        std::printf("  ]\n}\n");
+    }
+}
+
+
+int main(int argc, char** argv)
+{
+    unsigned int scale = 10;
+    std::string romDirectory;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument = argv[i];
+        if (argument == "--quick")
+        {
+            scale = 1;
+        }
+        else if (argument == "--write-roms" && i + 1 < argc)
+        {
+            romDirectory = argv[++i];
+        }
+        else
+        {
+            std::cerr << "Usage:" << argv[0] << " [--quick] [--write-roms <Directory>]\n";
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    if (!romDirectory.empty())
+    {
+        for (BundledRom const& bundled : bundledRoms)
+        {
+            std::string path = romDirectory + "/bench_" + bundled.name + ".ch8";
+            if (!WriteRom(path, bundled.build()))
+            {
+                std::cerr << "Could not write " << path << "\n";
+                std::exit(EXIT_FAILURE);
+            }
+        }
+    }
+
+    ScratchRom scratch;
+    std::vector<Result> results;
+
+    // dispatch, one opcode from each level of the tables, through Cycle since that is the only thing still dispatching per instruction
+    results.push_back(CycleMicro(scratch, "dispatch/table", FillRom({}, 0x6123), scale * 2000000));     // 6xkk, straight from table
+    results.push_back(CycleMicro(scratch, "dispatch/table8", FillRom({}, 0x8124), scale * 2000000));    // 8xy4, through Table8
+    results.push_back(CycleMicro(scratch, "dispatch/tableF", FillRom({}, 0xF11E), scale * 2000000));    // Fx1E, through TableF
+    results.push_back(Micro(scratch, "OP_00E0", FillRom({}, 0x00E0), scale * 1000000));
+
+    // the same sprite drawn over and over at 60,24, so it clips at the right edge and the taller ones clip at the bottom too
+    for (unsigned int height : { 1u, 4u, 8u, 15u })
+    {
+        std::string name = "OP_Dxyn/" + std::to_string(height);
+        uint16_t op = static_cast<uint16_t>(0xD010 | height);
+        results.push_back(Micro(scratch, name.c_str(), FillRom({ 0xA050, 0x603C, 0x6118 }, op), scale * 1000000));
+    }
+
+    // the hires scroll and sprite kernels, on a screen the setup fills with 16x16 sprites of whatever code is at 0x300
+    Program hires = { 0x00FF, 0xA300, 0x6000, 0x6100, 0xD010, 0x7010, 0x3080, 0x1208, 0x6000, 0x7110, 0x3140, 0x1208, 0x6278, 0x633C };
+    results.push_back(VariantMicro<SuperChip8>("schip/00FB", FillRom(hires, 0x00FB), scale * 1000000));
+    results.push_back(VariantMicro<SuperChip8>("schip/00C1", FillRom(hires, 0x00C1), scale * 1000000));
+    results.push_back(VariantMicro<SuperChip8>("schip/Dxy0", FillRom(hires, 0xD230), scale * 1000000)); // at 120,60, clips at the edges
+    results.push_back(VariantMicro<XoChip8>("xochip/00FB", FillRom(hires, 0x00FB), scale * 1000000));
+    results.push_back(VariantMicro<XoChip8>("xochip/Dxy0", FillRom(hires, 0xD230), scale * 1000000));     // wraps round them
+
+    results.push_back(LoadRom(scratch, scale * 1000));
+    results.push_back(LoadImage(scale * 1000));
+
+    for (unsigned int factor : { 1u, 4u, 10u })
+    {
+        results.push_back(Scale(ScaleFilter::Nearest, factor, scale * 100));
+    }
+    for (unsigned int factor : { 2u, 4u, 10u })
+    {
+        results.push_back(Scale(ScaleFilter::Scale2x, factor, scale * 100));
+    }
+
+    for (BundledRom const& bundled : bundledRoms)
+    {
+        for (ExecMode mode : { ExecMode::Interpreter, ExecMode::BlockCache, ExecMode::Jit })
+        {
+            results.push_back(Frames(scratch, bundled, mode, scale * 60, 1000));
+        }
+    }
+
+    PrintJson(results);
+    return 0;
+}
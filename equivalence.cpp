@@ -0,0 +1,480 @@
+#include <iostream>
+#include <fstream>
+#include <cstdint>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+#include "Chip8.hpp"
+#include "Quirks.hpp"
+#include "SaveState.hpp"
+#ifdef CHIP8_LOCKSTEP
+#include "Lockstep.hpp"
+#endif
+#ifdef CHIP8_EQUIVALENCE_AOT
+#include "Aot.hpp"
+#endif
+
+
+// checks that every way of running a rom ends in exactly the same machine as calling Cycle once per instruction
+// random roms, half of them writing over their own code while they run, are run frame by frame with keys changing between frames
+// under several quirk sets, through Cycle, the Interpreter, the BlockCache and the Jit, and with the default quirks through Lockstep
+// too. every run has to end with the same state digest as the Cycle run. the chip8_equivalence_native build also links the blocks
+// chip8_aot compiled for one of these roms, and checks ExecMode::Native on it and on every other rom
+// what the command line could look like
+    // ./chip8_equivalence 200 1
+        // 200 roms from seed 1, prints the first mismatch and fails if there is one. ctest runs it like this
+    // ./chip8_equivalence --write-rom bad.ch8 100007
+        // writes the rom a mismatch was reported for, to look at or to run with chip8_replay or chip8_headless
+namespace
+{
+    const unsigned int FRAMES = 60;
+    const unsigned int CYCLES_PER_FRAME = 300;
+    const unsigned int START_ADDRESS = 0x200;
+    const unsigned int SCRATCH_ADDRESS = 0xC00; // where the roms store to, well past any code they have
+
+    struct QuirkSet
+    {
+        char const* name;
+        Quirks quirks;
+    };
+
+    const QuirkSet quirkSets[] =
+    {
+        { "chip8", Quirks{} },
+        { "vip", Quirks{ true, true, false, false } },
+        { "jump", Quirks{ false, false, true, false } },
+        { "all", Quirks{ true, true, true, true } },
+    };
+
+    // a rom that only ever does things Chip8 defines: I is always set right before anything that reads or writes through it, calls
+    // are one deep, a skip only ever skips one plain instruction, and a rom that writes over its code only writes 7xkk instructions
+    // over other single instructions, or writes back what was already there
+    class RomWriter
+    {
+    public:
+        explicit RomWriter(uint32_t seed)
+            : rng(seed)
+            , selfModifying((seed & 1u) != 0)
+        {}
+
+        std::vector<uint8_t> Write()
+        {
+            unsigned int groups = 20 + Random(40);
+            for (unsigned int i = 0; i < groups; ++i)
+            {
+                Group();
+            }
+            Emit(0x6000);
+            Emit(0x1000 | START_ADDRESS);
+
+            // the subroutines, after the main loop so only calls reach them
+            for (size_t call : calls)
+            {
+                Patch(call, 0x2000 | Here());
+                unsigned int length = 1 + Random(6);
+                for (unsigned int i = 0; i < length; ++i)
+                {
+                    (Random(4) == 0) ? Memory() : Single();
+                }
+                Emit(0x00EE);
+            }
+
+            std::vector<uint8_t> rom;
+            for (uint16_t op : ops)
+            {
+                rom.push_back(static_cast<uint8_t>(op >> 8u));
+                rom.push_back(static_cast<uint8_t>(op));
+            }
+            return rom;
+        }
+
+    private:
+        unsigned int Random(unsigned int n)
+        {
+            return static_cast<unsigned int>(rng() % n);
+        }
+
+        uint16_t Here() const
+        {
+            return static_cast<uint16_t>(START_ADDRESS + 2 * ops.size());
+        }
+
+        size_t Emit(unsigned int op)
+        {
+            ops.push_back(static_cast<uint16_t>(op));
+            return ops.size() - 1;
+        }
+
+        void Patch(size_t at, unsigned int op)
+        {
+            ops[at] = static_cast<uint16_t>(op);
+        }
+
+        // one instruction that only touches registers, the ones a self modifying rom may write over
+        void Single()
+        {
+            static const unsigned int ALU[] = { 0x0, 0x1, 0x2, 0x3, 0x4, 0x5, 0x6, 0x7, 0xE };
+            unsigned int x = Random(16) << 8u;
+            unsigned int y = Random(16) << 4u;
+
+            slots.push_back(Here());
+            switch (Random(4))
+            {
+                case 0: Emit(0x6000 | x | Random(256)); break;
+                case 1: Emit(0x7000 | x | Random(256)); break;
+                case 2: Emit(0xC000 | x | Random(256)); break;
+                default: Emit(0x8000 | x | y | ALU[Random(9)]); break;
+            }
+        }
+
+        void Memory()
+        {
+            unsigned int x = Random(16) << 8u;
+            Emit(0xA000 | (SCRATCH_ADDRESS + Random(256)));
+            if (Random(2))
+            {
+                Emit(0xF01E | (Random(16) << 8u));
+            }
+
+            static const unsigned int OPS[] = { 0xF033, 0xF055, 0xF065 };
+            Emit(OPS[Random(3)] | x);
+        }
+
+        void Group()
+        {
+            unsigned int x = Random(16) << 8u;
+            unsigned int y = Random(16) << 4u;
+
+            switch (Random(selfModifying ? 13 : 11))
+            {
+                case 0:
+                case 1:
+                    Single();
+                    break;
+                case 2:
+                {
+                    static const unsigned int SKIPS[] = { 0x3000, 0x4000, 0x5000, 0x9000 };
+                    unsigned int skip = SKIPS[Random(4)];
+                    Emit(skip | x | ((skip == 0x3000 || skip == 0x4000) ? Random(256) : y));
+                    Single();
+                    break;
+                }
+                case 3:
+                    Emit(0x6000 | x | Random(16)); // a key number, Ex9E and ExA1 index the keypad with it
+                    Emit((Random(2) ? 0xE09E : 0xE0A1) | x);
+                    Single();
+                    break;
+                case 4:
+                    Emit(0xA000 | Random(0xF00));
+                    Emit(0xD000 | x | y | Random(16));
+                    break;
+                case 5:
+                    Random(4) == 0 ? Emit(0x00E0) : Emit(0xF029 | x);
+                    break;
+                case 6:
+                {
+                    static const unsigned int TIMERS[] = { 0xF007, 0xF015, 0xF018 };
+                    Emit(TIMERS[Random(3)] | x);
+                    break;
+                }
+                case 7:
+                    Emit(0xF00A | x);
+                    break;
+                case 8:
+                    Memory();
+                    break;
+                case 9:
+                    calls.push_back(Emit(0x2000)); // pointed at its subroutine once the main loop is written
+                    break;
+                case 10:
+                    Random(2) ? JumpTable() : JumpOver();
+                    break;
+                default:
+                    WriteCode();
+                    break;
+            }
+        }
+
+        // Bnnn into a table of jumps that all land after it
+        void JumpTable()
+        {
+            uint16_t table = static_cast<uint16_t>(Here() + 6);
+            unsigned int x = (table >> 8u) & 0xFu;
+
+            Emit(0xC006); // V0 = 0, 2, 4 or 6
+            Emit(0x8000 | (x << 8u)); // Vx = V0, what the jump quirk adds instead
+            Emit(0xB000 | table);
+            uint16_t after = static_cast<uint16_t>(table + 8);
+            for (unsigned int i = 0; i < 4; ++i)
+            {
+                Emit(0x1000 | after);
+            }
+        }
+
+        // a jump over a word that is never run, data in the middle of the code
+        void JumpOver()
+        {
+            Emit(0x1000 | (Here() + 4));
+            Emit(Random(0x10000));
+        }
+
+        void WriteCode()
+        {
+            if (slots.empty())
+            {
+                Single();
+                return;
+            }
+
+            uint16_t slot = slots[Random(static_cast<unsigned int>(slots.size()))];
+            if (Random(2))
+            {
+                Emit(0x6070 | Random(16)); // V0 = 7r, so V0 V1 is 7rkk
+                Emit(0xC1FF);
+            }
+            else
+            {
+                // the same bytes back, which should bring back anything that was thrown away when they were first written
+                Emit(0xA000 | slot);
+                Emit(0xF165);
+            }
+
+            // half the time I is added up with Fx1E, so the write cant be seen before the rom runs and only Invalidate catches it
+            if (Random(2))
+            {
+                unsigned int offset = 1 + Random(255);
+                Emit(0xA000 | (slot - offset));
+                Emit(0x6200 | offset);
+                Emit(0xF21E);
+            }
+            else
+            {
+                Emit(0xA000 | slot);
+            }
+            Emit(0xF155);
+        }
+
+        std::mt19937 rng;
+        bool selfModifying;
+        std::vector<uint16_t> ops;
+        std::vector<uint16_t> slots; // addresses of Single instructions
+        std::vector<size_t> calls;
+    };
+
+    bool KeyDown(uint32_t seed, unsigned int frame, unsigned int key)
+    {
+        uint32_t h = seed * 2654435761u ^ (frame * 40503u + key) * 2246822519u;
+        h ^= h >> 15u;
+        return (h & 7u) == 0;
+    }
+
+    bool WriteRom(char const* filename, std::vector<uint8_t> const& rom)
+    {
+        std::ofstream file(filename, std::ios::binary);
+        file.write(reinterpret_cast<char const*>(rom.data()), static_cast<std::streamsize>(rom.size()));
+        return static_cast<bool>(file);
+    }
+
+    void Start(Chip8& chip8, std::vector<uint8_t> const& rom, Quirks quirks, uint32_t seed)
+    {
+        chip8.LoadROM(rom.data(), rom.size());
+        chip8.SetQuirks(quirks);
+        chip8.Seed(seed);
+    }
+
+    // one instruction at a time, what everything else is checked against
+    uint64_t RunCycle(std::vector<uint8_t> const& rom, Quirks quirks, uint32_t seed)
+    {
+        Chip8 chip8;
+        Start(chip8, rom, quirks, seed);
+
+        for (unsigned int frame = 0; frame < FRAMES; ++frame)
+        {
+            for (unsigned int key = 0; key < KEY_COUNT; ++key)
+            {
+                chip8.keypad[key] = KeyDown(seed, frame, key);
+            }
+            for (unsigned int i = 0; i < CYCLES_PER_FRAME; ++i)
+            {
+                chip8.Cycle();
+            }
+            chip8.TickTimers();
+        }
+
+        SaveState state{};
+        chip8.Save(state);
+        return StateDigest(state);
+    }
+
+    uint64_t RunMode(std::vector<uint8_t> const& rom, Quirks quirks, uint32_t seed, ExecMode mode)
+    {
+        Chip8 chip8;
+        chip8.SetExecMode(mode);
+        Start(chip8, rom, quirks, seed);
+#ifdef CHIP8_EQUIVALENCE_AOT
+        chip8.SetAotProgram(&aotProgram);
+#endif
+
+        for (unsigned int frame = 0; frame < FRAMES; ++frame)
+        {
+            for (unsigned int key = 0; key < KEY_COUNT; ++key)
+            {
+                chip8.keypad[key] = KeyDown(seed, frame, key);
+            }
+            chip8.Run(CYCLES_PER_FRAME);
+            chip8.TickTimers();
+        }
+
+        SaveState state{};
+        chip8.Save(state);
+        return StateDigest(state);
+    }
+
+#ifdef CHIP8_LOCKSTEP
+    const unsigned int LANES = 4;
+
+    // lane l runs with seed + l, each lane has to match its own Cycle run
+    bool RunLockstep(std::vector<uint8_t> const& rom, uint32_t seed, uint32_t& badSeed, uint64_t& expected, uint64_t& got)
+    {
+        Lockstep engine(LANES);
+        engine.LoadROM(rom.data(), rom.size());
+
+        for (unsigned int lane = 0; lane < LANES; ++lane)
+        {
+            Chip8 chip8;
+            Start(chip8, rom, Quirks{}, seed + lane);
+            SaveState state{};
+            chip8.Save(state);
+            engine.Inject(lane, state);
+        }
+
+        for (unsigned int frame = 0; frame < FRAMES; ++frame)
+        {
+            for (unsigned int lane = 0; lane < LANES; ++lane)
+            {
+                for (unsigned int key = 0; key < KEY_COUNT; ++key)
+                {
+                    engine.SetKey(lane, key, KeyDown(seed + lane, frame, key));
+                }
+            }
+            engine.Run(CYCLES_PER_FRAME);
+            engine.TickTimers();
+        }
+
+        for (unsigned int lane = 0; lane < LANES; ++lane)
+        {
+            SaveState state{};
+            engine.Extract(lane, state);
+            expected = RunCycle(rom, Quirks{}, seed + lane);
+            got = StateDigest(state);
+            if (got != expected)
+            {
+                badSeed = seed + lane;
+                return false;
+            }
+        }
+        return true;
+    }
+#endif
+
+    struct Mode
+    {
+        char const* name;
+        ExecMode mode;
+    };
+
+    const Mode modes[] =
+    {
+        { "interp", ExecMode::Interpreter },
+        { "block", ExecMode::BlockCache },
+        { "jit", ExecMode::Jit },
+#ifdef CHIP8_EQUIVALENCE_AOT
+        { "native", ExecMode::Native },
+#endif
+    };
+
+    void Mismatch(uint32_t romSeed, char const* quirks, char const* mode, uint32_t seed, uint64_t expected, uint64_t got)
+    {
+        std::cerr << "Mismatch: rom " << romSeed << ", quirks " << quirks << ", mode " << mode << ", seed " << seed
+                  << ": cycle " << std::hex << expected << ", " << mode << " " << got << std::dec << "\n";
+    }
+}
+
+
+int main(int argc, char** argv)
+{
+    if (argc == 4 && std::string(argv[1]) == "--write-rom")
+    {
+        if (!WriteRom(argv[2], RomWriter(static_cast<uint32_t>(std::strtoul(argv[3], nullptr, 10))).Write()))
+        {
+            std::cerr << "Could not write " << argv[2] << "\n";
+            std::exit(EXIT_FAILURE);
+        }
+        return 0;
+    }
+
+    if (argc != 3)
+    {
+        std::cerr << "Usage:" << argv[0] << " <Roms> <Seed>\n";
+        std::cerr << "       " << argv[0] << " --write-rom <Output.ch8> <RomSeed>\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    unsigned int romCount = static_cast<unsigned int>(std::strtoul(argv[1], nullptr, 10));
+    uint32_t seed = static_cast<uint32_t>(std::strtoul(argv[2], nullptr, 10));
+
+    std::vector<std::pair<uint32_t, std::vector<uint8_t>>> roms;
+    for (unsigned int i = 0; i < romCount; ++i)
+    {
+        uint32_t romSeed = seed * 100000u + i;
+        roms.emplace_back(romSeed, RomWriter(romSeed).Write());
+    }
+#ifdef CHIP8_EQUIVALENCE_AOT
+    roms.emplace_back(0, std::vector<uint8_t>(aotProgram.rom, aotProgram.rom + aotProgram.romSize)); // the one with compiled blocks
+#endif
+
+    unsigned int runs = 0;
+    for (auto const& entry : roms)
+    {
+        uint32_t romSeed = entry.first;
+        std::vector<uint8_t> const& rom = entry.second;
+        uint32_t runSeed = romSeed * 7u + 1u;
+
+        for (QuirkSet const& set : quirkSets)
+        {
+            uint64_t expected = RunCycle(rom, set.quirks, runSeed);
+
+            for (Mode const& mode : modes)
+            {
+                uint64_t got = RunMode(rom, set.quirks, runSeed, mode.mode);
+                ++runs;
+                if (got != expected)
+                {
+                    Mismatch(romSeed, set.name, mode.name, runSeed, expected, got);
+                    std::exit(EXIT_FAILURE);
+                }
+            }
+        }
+
+#ifdef CHIP8_LOCKSTEP
+        uint32_t badSeed = 0;
+        uint64_t expected = 0;
+        uint64_t got = 0;
+        ++runs;
+        if (!RunLockstep(rom, runSeed, badSeed, expected, got))
+        {
+            Mismatch(romSeed, "chip8", "lockstep", badSeed, expected, got);
+            std::exit(EXIT_FAILURE);
+        }
+#endif
+    }
+
+    std::cout << "Roms: " << roms.size() << "\n";
+    std::cout << "Runs: " << runs << ", all matching Cycle\n";
+#ifdef CHIP8_EQUIVALENCE_AOT
+    std::cout << "Native blocks: " << aotProgram.blockCount << "\n";
+#endif
+
+    return 0;
+}
@@ -0,0 +1,271 @@
+#include <algorithm>
+#include <iostream>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Capture.hpp"
+#include "Chip8.hpp"
+#include "ChipVariant.hpp"
+#ifdef CHIP8_LOCKSTEP
+#include "Lockstep.hpp"
+#endif
+#include "Quirks.hpp"
+#include "RomLibrary.hpp"
+#include "SaveState.hpp"
+#include "Scheduler.hpp"
+#include "ThreadPool.hpp"
+
+
+namespace
+{
+    // a SUPER-CHIP or XO-CHIP rom runs on its ChipVariant, which only interprets, with the same emulated time as Scheduler gives Chip8
+    template <typename Variant>
+    uint64_t RunVariant(RomImage const& rom, long frameCount, int cyclesPerFrame)
+    {
+        Variant machine;
+        machine.LoadROM(rom.data, rom.size);
+
+        for (long frame = 0; frame < frameCount && !machine.Exited(); ++frame)
+        {
+            machine.Run(cyclesPerFrame);
+            machine.TickTimers();
+        }
+        return machine.CycleCount();
+    }
+}
+
+
+// headless batch runner, runs many independent chip8 machines across every core with no window and no SDL at all
+// what the command line could look like
+    // ./chip8_headless roms/PONG.ch8 1000 600 10
+        // 1000 is the number of instances, 600 is the number of 60hz frames each one runs, 10 is the cycles per frame
+        // an optional 5th argument sets the thread count and an optional 6th picks the execution mode (interp, block, jit or lockstep)
+        // the rom can also be a directory of roms, the instances then take turns through them in file name order (in lockstep each
+        // engine of up to 256 lanes gets one rom)
+        // CHIP8_QUIRKS and CHIP8_QUIRK_PROFILES pick each roms quirks as in chip8, lockstep only runs roms with the default quirks.
+        // schip and xochip roms run on the SUPER-CHIP and XO-CHIP machines, always interpreted whatever the mode
+        // CHIP8_CAPTURE=run.gif (or .y4m, or anything else for raw RGBA) records what instance 0 shows, for attaching to a QA report
+int main(int argc, char** argv)
+{
+    if (argc < 5 || argc > 7)
+    {
+        std::cerr << "Usage:" << argv[0] << " <ROM|RomDirectory> <Instances> <Frames> <CyclesPerFrame> [Threads] [interp|block|jit|lockstep]\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    char const* romPath = argv[1];
+    int instanceCount = std::stoi(argv[2]);
+    long frameCount = std::stol(argv[3]);
+    int cyclesPerFrame = std::stoi(argv[4]);
+    int threadCount = (argc >= 6) ? std::stoi(argv[5]) : 0; // 0 lets the pool use one thread per core
+    std::string modeName = (argc >= 7) ? argv[6] : "interp";
+
+    ExecMode mode = ExecMode::Interpreter;
+    bool lockstep = false;
+    if (modeName == "block")
+    {
+        mode = ExecMode::BlockCache;
+    }
+    else if (modeName == "jit")
+    {
+        mode = ExecMode::Jit;
+    }
+#ifdef CHIP8_LOCKSTEP
+    else if (modeName == "lockstep")
+    {
+        lockstep = true;
+    }
+#endif
+    else if (modeName != "interp")
+    {
+        std::cerr << "Unknown mode " << modeName << ", expected interp, block, jit or lockstep\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    if (instanceCount <= 0 || frameCount <= 0 || cyclesPerFrame <= 0 || threadCount < 0)
+    {
+        std::cerr << "Instances, Frames and CyclesPerFrame must be positive\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    // every rom is mapped once here, the instances all copy from the same read only images instead of each opening the file
+    RomLibrary library;
+    bool opened = library.Open(romPath);
+
+    for (std::string const& skipped : library.Skipped())
+    {
+        std::cerr << "Skipped " << skipped << "\n";
+    }
+    if (!opened)
+    {
+        std::cerr << "No usable rom in " << romPath << "\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    // each rom gets its machine and quirks once here, every instance of it then decodes straight to the matching handler instantiations
+    QuirkProfiles profiles;
+    if (!profiles.LoadEnvironment())
+    {
+        std::exit(EXIT_FAILURE);
+    }
+
+    std::vector<QuirkProfile> romProfiles(library.Count());
+    for (size_t r = 0; r < library.Count(); ++r)
+    {
+        romProfiles[r] = profiles.For(library.Rom(r));
+
+        if (lockstep && (romProfiles[r].machine != Machine::Chip8 || romProfiles[r].quirks.Bits() != 0))
+        {
+            std::cerr << "Lockstep runs chip8 roms with the default quirks only, " << library.Rom(r).name << " needs " << ProfileName(romProfiles[r]) << "\n";
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    // every instance writes its count into its own slot, padded to a cache line so the threads never share one
+    struct alignas(64) InstanceResult
+    {
+        uint64_t instructions{};
+    };
+    std::vector<InstanceResult> results(instanceCount);
+
+    // only instance 0 is recorded, a lockstep engine has no per lane display to record and Capture only takes the 64x32 chip8 screen
+    std::unique_ptr<Capture> capture = Capture::FromEnvironment();
+    if (capture && lockstep)
+    {
+        std::cerr << "Capture isnt supported in lockstep mode, nothing will be recorded\n";
+        capture.reset();
+    }
+    if (capture && romProfiles[0].machine != Machine::Chip8)
+    {
+        std::cerr << "Capture only records chip8 roms, nothing will be recorded\n";
+        capture.reset();
+    }
+    Capture* captureFirst = capture.get();
+
+    ThreadPool pool(threadCount);
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    uint64_t laneSteps = 0; // steps times the lanes in that engine, the instructions the engines could have run
+
+#ifdef CHIP8_LOCKSTEP
+    // lockstep packs the instances into engines of up to LOCKSTEP_LANES lanes and runs one task per engine
+    const int LOCKSTEP_LANES = 256;
+    std::vector<uint64_t> engineSteps((instanceCount + LOCKSTEP_LANES - 1) / LOCKSTEP_LANES);
+    uint32_t baseSeed = static_cast<uint32_t>(std::chrono::system_clock::now().time_since_epoch().count());
+
+    for (int first = 0; lockstep && first < instanceCount; first += LOCKSTEP_LANES)
+    {
+        int lanes = std::min(LOCKSTEP_LANES, instanceCount - first);
+
+        RomImage const& rom = library.Rom((first / LOCKSTEP_LANES) % library.Count());
+
+        pool.Submit([&results, &engineSteps, &rom, first, lanes, baseSeed, frameCount, cyclesPerFrame]
+        {
+            Lockstep engine(lanes);
+            engine.LoadROM(rom.data, rom.size);
+
+            // every lane gets its own random numbers, the way each instance does outside lockstep, so lanes split apart wherever the rom
+            // branches on Cxkk and the utilization below is what a real batch gets instead of 100%
+            Chip8 loader;
+            loader.LoadROM(rom.data, rom.size);
+            SaveState state;
+            for (int lane = 0; lane < lanes; ++lane)
+            {
+                loader.Seed(baseSeed + static_cast<uint32_t>(first + lane));
+                loader.Save(state);
+                engine.Inject(lane, state);
+            }
+
+            engine.RunFrames(frameCount, cyclesPerFrame);
+
+            for (int lane = 0; lane < lanes; ++lane)
+            {
+                results[first + lane].instructions = uint64_t(frameCount) * cyclesPerFrame;
+            }
+            engineSteps[first / LOCKSTEP_LANES] = engine.Steps() * lanes;
+        });
+    }
+#endif
+
+    // one task per instance, the machine lives on the stack of whichever worker ends up running it
+    for (int i = 0; i < instanceCount && !lockstep; ++i)
+    {
+        RomImage const& rom = library.Rom(i % library.Count());
+        QuirkProfile profile = romProfiles[i % library.Count()];
+
+        pool.Submit([&results, &rom, profile, i, frameCount, cyclesPerFrame, mode, captureFirst]
+        {
+            if (profile.machine == Machine::SuperChip)
+            {
+                results[i].instructions = RunVariant<SuperChip8>(rom, frameCount, cyclesPerFrame);
+                return;
+            }
+            if (profile.machine == Machine::XoChip)
+            {
+                results[i].instructions = RunVariant<XoChip8>(rom, frameCount, cyclesPerFrame);
+                return;
+            }
+
+            Chip8 chip8;
+            chip8.SetExecMode(mode);
+            chip8.LoadROM(rom.data, rom.size);
+            chip8.SetQuirks(profile.quirks);
+
+            // emulated time only, cyclesPerFrame instructions between each 60hz timer tick
+            Scheduler scheduler(chip8, cyclesPerFrame * Scheduler::TIMER_HZ);
+            if (i == 0)
+            {
+                scheduler.SetCapture(captureFirst);
+            }
+            scheduler.RunFrames(frameCount);
+
+            results[i].instructions = scheduler.Instructions();
+        });
+    }
+
+    pool.Wait();
+
+    if (capture && !capture->Close())
+    {
+        std::cerr << "Could not write all of the capture\n";
+    }
+
+#ifdef CHIP8_LOCKSTEP
+    for (uint64_t steps : engineSteps)
+    {
+        laneSteps += steps;
+    }
+#endif
+
+    auto endTime = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(endTime - startTime).count();
+
+    uint64_t totalInstructions = 0;
+    for (InstanceResult const& result : results)
+    {
+        totalInstructions += result.instructions;
+    }
+
+    std::cout << "Roms: " << library.Count() << "\n";
+    std::cout << "Instances: " << instanceCount << "\n";
+    std::cout << "Threads: " << pool.Size() << "\n";
+    std::cout << "Mode: " << modeName << "\n";
+    std::cout << "Instructions: " << totalInstructions << "\n";
+    std::cout << "Elapsed: " << seconds << " s\n";
+    std::cout << "Instructions/sec: " << (seconds > 0 ? totalInstructions / seconds : 0.0) << "\n";
+
+    // how many of the lanes each step could have run actually ran it, 100% means the instances never branched apart
+    if (lockstep && laneSteps > 0)
+    {
+        std::cout << "Lane utilization: " << 100.0 * totalInstructions / laneSteps << " %\n";
+    }
+
+    if (capture)
+    {
+        std::cout << "Captured: " << capture->Frames() << " frames, " << capture->DistinctFrames() << " distinct\n";
+    }
+
+    return 0;
+}
@@ -1,17 +1,59 @@
 #include <iostream>
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdlib>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
 #include "Platform.hpp"
+#include "Audio.hpp"
 #include "Chip8.hpp"
+#include "Scheduler.hpp"
+#include "Rewind.hpp"
+#include "Movie.hpp"
+#include "Quirks.hpp"
+#include "RomLibrary.hpp"
+#include "Scaler.hpp"
+#include "TripleBuffer.hpp"
+
+
+#ifdef CHIP8_TRACE
+// if the emulator crashes, write the last trace records to chip8_trace.bin before dying, only signal safe calls in here
+static Trace const* crashTrace = nullptr;
+
+static void DumpTraceOnCrash(int signal)
+{
+    if (crashTrace)
+    {
+        int fd = open("chip8_trace.bin", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd >= 0)
+        {
+            crashTrace->DumpBinary(fd);
+            close(fd);
+        }
+    }
+
+    std::signal(signal, SIG_DFL); // put the default handler back and crash for real
+    std::raise(signal);
+}
+#endif
 
 
 int main(int argc, char** argv) // argc is the nubmer of command line arguments passed to the program, char** argv is an array of c style strings containing the command line arguments 
 // what will be inputted into this function is a command line once the program is compiled, which could look like this
     // ./chip8 roms/PONG.ch8 10 5
-        // chip8 is the program.exe name, roms/PONG.ch8 id the rom file, 10 is the video scale factor, 5 is the delay in milliseconds 
+        // chip8 is the program.exe name, roms/PONG.ch8 id the rom file, 10 is the video scale factor, 5 is the delay in milliseconds per instruction (so 200 instructions per second), 0 runs as fast as possible 
+        // an optional 4th argument records every key press to an input movie that chip8_replay can play back exactly
+        // CHIP8_QUIRKS=vip (or schip, xochip, or single quirks, see Quirks.hpp) and CHIP8_QUIRK_PROFILES=file pick the quirks the rom runs with (schip and xochip roms run in chip8_headless only)
 {
-    if (argc != 4) // check to see that there are the correct number of arguments 
+    if (argc != 4 && argc != 5) // check to see that there are the correct number of arguments 
     {
-        std::cerr << "Usage:" << argv[0] << " <Scale> <Delay> <ROM>\n"; // error message if the number of arguments is not 4
+        std::cerr << "Usage:" << argv[0] << " <Scale> <Delay> <ROM> [Movie]\n"; // error message if the number of arguments is not 4 or 5
         std::exit(EXIT_FAILURE);
     }
 
@@ -20,37 +62,271 @@ int main(int argc, char** argv) // argc is the nubmer of command line arguments
     int videoScale = std::stoi(argv[1]); // gets the scale factor from the command line
     int cycleDelay = std::stoi(argv[2]); // gets the delay in milliseconds from the command line argument
     char const* romFilename = argv[3]; // creates a pointer to the rom filename in memory
+    char const* movieFilename = (argc == 5) ? argv[4] : nullptr;
+
+    // CHIP8_PALETTE=RRGGBBAA,RRGGBBAA in the environment sets the colours of off and on pixels
+    Palette palette;
+    if (char const* colours = std::getenv("CHIP8_PALETTE"))
+    {
+        palette = ParsePalette(colours);
+    }
+
+    // CHIP8_SCALER=nearest or scale2x scales on the cpu into a texture as big as the window and draws it with the software renderer,
+    // for machines with no gpu. without it the gpu stretches a 64x32 texture
+    char const* scalerName = std::getenv("CHIP8_SCALER");
+    ScaleFilter filter = ScaleFilter::Nearest;
+    int textureScale = 1;
+    if (scalerName)
+    {
+        filter = (std::string(scalerName) == "scale2x") ? ScaleFilter::Scale2x : ScaleFilter::Nearest;
+        textureScale = videoScale;
+
+        if (videoScale < 1 || videoScale > static_cast<int>(MAX_SCALE) || (filter == ScaleFilter::Scale2x && videoScale % 2 != 0))
+        {
+            std::cerr << "CHIP8_SCALER needs a scale of 1 to " << MAX_SCALE << ", and an even one for scale2x\n";
+            std::exit(EXIT_FAILURE);
+        }
+    }
 
     // initializes an object called platform from the platform class calling its constructor, we do this to initialize SDL which is in the platform.cpp file in the platform constructor which
-    Platform platform("CHIP-8 Emulator", VIDEO_WIDTH * videoScale, VIDEO_HEIGHT * videoScale, VIDEO_WIDTH, VIDEO_HEIGHT); 
+    Platform platform("CHIP-8 Emulator", VIDEO_WIDTH * videoScale, VIDEO_HEIGHT * videoScale, VIDEO_WIDTH * textureScale, VIDEO_HEIGHT * textureScale,
+        scalerName != nullptr);
+
+    // CHIP8_AUDIO_BUFFER=n sets the audio buffer in sample frames (256 by default, about 5 ms), 0 turns sound off. CHIP8_AUDIO_TONE=hz sets the pitch
+    // after the platform so it closes before SDL_Quit
+    unsigned int audioBuffer = Audio::DEFAULT_BUFFER;
+    unsigned int audioTone = Audio::DEFAULT_TONE;
+    if (char const* bufferText = std::getenv("CHIP8_AUDIO_BUFFER"))
+    {
+        audioBuffer = static_cast<unsigned int>(std::strtoul(bufferText, nullptr, 10));
+    }
+    if (char const* toneText = std::getenv("CHIP8_AUDIO_TONE"))
+    {
+        audioTone = static_cast<unsigned int>(std::strtoul(toneText, nullptr, 10));
+    }
+    std::unique_ptr<Audio> audio;
+    if (audioBuffer > 0)
+    {
+        audio.reset(new Audio(audioBuffer, audioTone));
+    }
 
     Chip8 chip8; // creates an object chip8 of the chip8 class
-    chip8.LoadROM(romFilename); // loads rom file
 
-    int videoPitch = sizeof(chip8.video[0]) * VIDEO_WIDTH; // variable to store pitch of video buffer
+#ifdef CHIP8_TRACE
+    // CHIP8_TRACE_LEVEL=0..4 in the environment picks off, error, info, debug or verbose
+    if (char const* level = std::getenv("CHIP8_TRACE_LEVEL"))
+    {
+        chip8.SetTraceLevel(static_cast<TraceLevel>(std::atoi(level)));
+        crashTrace = chip8.GetTrace();
+        std::signal(SIGSEGV, DumpTraceOnCrash);
+        std::signal(SIGABRT, DumpTraceOnCrash);
+        std::signal(SIGFPE, DumpTraceOnCrash);
+    }
+#endif
+
+    // CHIP8_PROFILE=name in the environment writes name.json and name.folded on exit, when built with the profiler
+    char const* profileName = std::getenv("CHIP8_PROFILE");
+    if (profileName)
+    {
+        chip8.SetProfiling(true);
+    }
+
+    // the rom is mapped through a RomLibrary so its name and hash can be looked up in the quirk profiles
+    QuirkProfiles profiles;
+    RomLibrary romFile;
+    if (!profiles.LoadEnvironment())
+    {
+        std::exit(EXIT_FAILURE);
+    }
+    if (!romFile.Open(romFilename))
+    {
+        for (std::string const& skipped : romFile.Skipped())
+        {
+            std::cerr << "Could not load " << skipped << "\n";
+        }
+        std::exit(EXIT_FAILURE);
+    }
+
+    RomImage const& rom = romFile.Rom(0);
+    QuirkProfile profile = profiles.For(rom);
+    if (profile.machine != Machine::Chip8)
+    {
+        std::cerr << rom.name << " is a " << ProfileName(profile) << " rom, only chip8_headless runs those for now\n";
+        std::exit(EXIT_FAILURE);
+    }
+    chip8.LoadROM(rom.data, rom.size); // loads rom file
+    chip8.SetQuirks(profile.quirks);
+
+    // CHIP8_SEED in the environment replays the random numbers of an earlier run, otherwise every run is different
+    uint32_t seed = static_cast<uint32_t>(std::chrono::system_clock::now().time_since_epoch().count());
+    if (char const* seedText = std::getenv("CHIP8_SEED"))
+    {
+        seed = static_cast<uint32_t>(std::strtoul(seedText, nullptr, 0));
+    }
+    chip8.Seed(seed);
+
+    std::vector<uint32_t> pixels(VIDEO_WIDTH * textureScale * VIDEO_HEIGHT * textureScale); // RGBA copy of the display, chip8.video is only 1 bit per pixel
+    int videoPitch = sizeof(pixels[0]) * VIDEO_WIDTH * textureScale; // variable to store pitch of video buffer
+
+    // the delay used to be the time between single instructions, now it sets the cpu speed and the scheduler keeps the timers at 60hz on their own
+    // a delay of 0 runs unthrottled, CHIP8_SPEED in the environment runs at a multiple of real time instead, 100 for a hundred times
+    Scheduler scheduler(chip8, cycleDelay > 0 ? 1000 / cycleDelay : 1000);
+    scheduler.SetSpeed(cycleDelay > 0 ? 1.0 : 0.0);
+    if (char const* speedText = std::getenv("CHIP8_SPEED"))
+    {
+        scheduler.SetSpeed(std::strtod(speedText, nullptr));
+    }
+
+    Movie movie;
+    if (movieFilename)
+    {
+        movie.Start(chip8, seed, scheduler.InstructionsPerSecond());
+    }
+
+    // the emulation runs on its own thread, this one owns the window so it collects the input and is the render thread
+    // key changes go over through a lock free queue and are applied between frames, so every change lands on the cycle a frame starts on
+    InputQueue input;
+    std::atomic<bool> running{true};
+
+    // finished frames go to this thread through a triple buffer, the emulation only copies the 256 bytes of chip8.video into it and never
+    // waits on the display, however long a present or a vsync takes. when frames come faster than they can be shown the older ones are skipped
+    struct Frame
+    {
+        uint64_t video[VIDEO_HEIGHT];
+    };
+    TripleBuffer<Frame> frames;
+
+    std::thread emulation([&]()
+    {
+        // the loop runs one 60hz frame at a time, a frames worth of instructions, then the scheduler sleeps until the frame is due and
+        // says whether it goes to the screen
+
+        // only hand a frame over when something was drawn
+        auto present = [&]()
+        {
+            if (!chip8.IsDirty())
+            {
+                return;
+            }
+
+            std::copy(chip8.video, chip8.video + VIDEO_HEIGHT, frames.Back().video);
+            frames.Publish();
+            chip8.ClearDirty();
+            platform.NotifyFrame();
+        };
+
+        // a snapshot every frame, deltas keep most of them to a few hundred bytes so this holds minutes of play
+        RewindBuffer rewind(8 * 1024 * 1024);
+        bool rewindHeld = false;
+
+        while (running.load(std::memory_order_relaxed))
+        {
+            // every key change since the last frame, the frame about to run is the first to see them
+            InputEvent event;
+            while (input.Pop(event))
+            {
+                if (event.kind == InputEvent::KEY)
+                {
+                    chip8.keypad[event.key & (KEY_COUNT - 1)] = event.down;
+                }
+                else if (event.kind == InputEvent::REWIND)
+                {
+                    rewindHeld = event.down != 0;
+                }
+            }
+
+            if (movieFilename)
+            {
+                movie.Record(chip8); // the keypad changes land between frames, so they are stamped with the cycle the next frame starts on
+            }
+
+            // a movie is one unbroken run from power on, so rewinding is off while recording
+            bool rewinding = rewindHeld && !movieFilename;
+            if (rewinding)
+            {
+                rewind.StepBack(chip8); // one frame back per frame, so rewinding plays at the same speed as the game did
+            }
+            else
+            {
+                scheduler.RunFrames(1); // one frame of instructions and one timer tick
+                rewind.Record(chip8);
+            }
+
+            // the buzzer follows the sound timer a frame at a time, the same rate the timer counts at, and stays quiet while rewinding
+            if (audio)
+            {
+                audio->SetTone(chip8.SoundActive() && !rewinding);
+            }
+
+            if (scheduler.Pace())
+            {
+                present();
+            }
+        }
+    });
+
+    uint64_t shown[VIDEO_HEIGHT]{}; // the rows the texture has now
+    bool uploaded = false;          // nothing is in the texture before the first frame
 
-    auto lastCycleTime = std::chrono::high_resolution_clock::now(); // decalres a varaible so store a timepoint, this records the starting time with high precision
     bool quit = false; // loop continues as long as the quit is false
 
     while (!quit) // this continues as long as quit is flase
     {
-        quit = platform.ProcessInput(chip8.keypad); // calls the processinput member function of the platform object, passes a pointer to the chip8 keyboard array allowing processinput to
-        // update the state of the chip8 keys based on keyboad input, return true if the user wants to quit
-        // it basically handles user input and updates the quit variable if nessesary
+        bool frameReady = false;
+        quit = platform.PumpInput(input, frameReady); // sleeps until there is a key change or a new frame, return true if the user wants to quit
 
-        // measures the time elapsed since the last cycleOP_Dxyn
-        auto currentTime = std::chrono::high_resolution_clock::now();
-        float dt = std::chrono::duration<float, std::chrono::milliseconds::period>(currentTime - lastCycleTime).count();
+        if (!frameReady || !frames.Update())
+        {
+            continue;
+        }
 
-        // controlls the speed of the emulation, only executes a new cycle if enough time has passed based on the cycleDay
-        if (dt > cycleDelay)
+        // only the rows that differ from what is on screen are expanded and uploaded
+        uint64_t const* video = frames.Front().video;
+        unsigned int firstRow = 0;
+        unsigned int endRow = VIDEO_HEIGHT;
+        if (uploaded)
         {
-            lastCycleTime = currentTime;
-            std::cout << "Running cycle \n";
+            while (firstRow < VIDEO_HEIGHT && video[firstRow] == shown[firstRow])
+            {
+                ++firstRow;
+            }
+            while (endRow > firstRow && video[endRow - 1] == shown[endRow - 1])
+            {
+                --endRow;
+            }
+        }
 
-            chip8.Cycle();
+        if (firstRow < endRow)
+        {
+            std::copy(video + firstRow, video + endRow, shown + firstRow);
+            uploaded = true;
 
-            platform.Update(chip8.video, videoPitch);
+            // scale2x output depends on the rows above and below too
+            if (filter == ScaleFilter::Scale2x)
+            {
+                firstRow = (firstRow > 0) ? firstRow - 1 : 0;
+                endRow = std::min(endRow + 1, VIDEO_HEIGHT);
+            }
+
+            ScaleVideo(video, pixels.data(), VIDEO_WIDTH * textureScale, textureScale, filter, palette, firstRow, endRow - firstRow);
+            platform.UpdateRows(pixels.data(), videoPitch, firstRow * textureScale, (endRow - firstRow) * textureScale);
+        }
+    }
+
+    running.store(false, std::memory_order_relaxed);
+    emulation.join(); // chip8 belongs to this thread again from here
+
+    if (profileName && !chip8.WriteProfile(profileName))
+    {
+        std::cerr << "Could not write profile " << profileName << "\n";
+    }
+
+    if (movieFilename)
+    {
+        movie.Stop(chip8);
+        if (!movie.Save(movieFilename))
+        {
+            std::cerr << "Could not write movie " << movieFilename << "\n";
         }
     }
 
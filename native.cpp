@@ -0,0 +1,89 @@
+#include <iostream>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include "Aot.hpp"
+#include "Chip8.hpp"
+#include "Quirks.hpp"
+#include "SaveState.hpp"
+#include "Scheduler.hpp"
+
+
+// the rom chip8_aot compiled into this binary, run with no window as fast as the host can go
+// what the command line could look like
+    // ./chip8_native 600 1000
+        // runs 600 frames of 1000 instructions each, an optional 3rd argument (native, interp, block or jit) picks the execution mode
+        // so the compiled code can be timed against the others on the same rom. CHIP8_SEED=n fixes the random numbers, the state
+        // digest printed at the end is then the same in every mode
+int main(int argc, char** argv)
+{
+    if (argc < 3 || argc > 4)
+    {
+        std::cerr << "Usage:" << argv[0] << " <Frames> <CyclesPerFrame> [native|interp|block|jit]\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    uint64_t frames = std::strtoull(argv[1], nullptr, 10);
+    unsigned int cyclesPerFrame = static_cast<unsigned int>(std::strtoul(argv[2], nullptr, 10));
+    std::string modeName = (argc >= 4) ? argv[3] : "native";
+
+    ExecMode mode = ExecMode::Native;
+    if (modeName == "interp")
+    {
+        mode = ExecMode::Interpreter;
+    }
+    else if (modeName == "block")
+    {
+        mode = ExecMode::BlockCache;
+    }
+    else if (modeName == "jit")
+    {
+        mode = ExecMode::Jit;
+    }
+    else if (modeName != "native")
+    {
+        std::cerr << "Unknown mode " << modeName << ", expected native, interp, block or jit\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    Chip8 chip8;
+    if (!chip8.LoadROM(aotProgram.rom, aotProgram.romSize))
+    {
+        std::exit(EXIT_FAILURE);
+    }
+
+    chip8.SetQuirks(Quirks::FromBits(aotProgram.quirks));
+    chip8.SetExecMode(mode);
+    chip8.SetAotProgram(&aotProgram);
+
+    char const* seed = std::getenv("CHIP8_SEED");
+    if (seed)
+    {
+        chip8.Seed(static_cast<uint32_t>(std::strtoul(seed, nullptr, 10)));
+    }
+
+    Scheduler scheduler(chip8, cyclesPerFrame * 60);
+
+    auto startTime = std::chrono::steady_clock::now();
+    scheduler.RunFrames(frames);
+    auto endTime = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(endTime - startTime).count();
+
+    // the same digest chip8_replay prints
+    SaveState state;
+    chip8.Save(state);
+    uint64_t digest = StateDigest(state);
+
+    std::cout << "Rom: " << aotProgram.name << "\n";
+    std::cout << "Mode: " << modeName << "\n";
+    std::cout << "Quirks: " << QuirksName(Quirks::FromBits(aotProgram.quirks)) << "\n";
+    std::cout << "Blocks: " << aotProgram.blockCount << "\n";
+    std::cout << "Instructions: " << chip8.CycleCount() << "\n";
+    std::cout << "Frames: " << scheduler.Frames() << "\n";
+    std::cout << "Elapsed: " << seconds << " s\n";
+    std::cout << "Instructions/sec: " << (seconds > 0 ? chip8.CycleCount() / seconds : 0.0) << "\n";
+    std::cout << "State digest: " << std::hex << digest << std::dec << "\n";
+
+    return 0;
+}
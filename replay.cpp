@@ -0,0 +1,123 @@
+#include <iostream>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include "Capture.hpp"
+#include "Chip8.hpp"
+#include "Movie.hpp"
+#include "Quirks.hpp"
+#include "SaveState.hpp"
+#include "Scheduler.hpp"
+
+
+// plays an input movie recorded by chip8 back with no window, as fast as the host can go
+// what the command line could look like
+    // ./chip8_replay roms/PONG.ch8 bug.c8m
+        // an optional 3rd argument picks the execution mode (interp, block or jit) and an optional 4th writes the final state to a file
+        // the state digest printed at the end is the same for every replay of the same movie, whatever the mode or the machine
+        // CHIP8_PROFILE=name in the environment profiles the replay into name.json and name.folded, when built with the profiler
+        // CHIP8_CAPTURE=bug.gif records the replay as video, see Capture.hpp for the formats
+int main(int argc, char** argv)
+{
+    if (argc < 3 || argc > 5)
+    {
+        std::cerr << "Usage:" << argv[0] << " <ROM> <Movie> [interp|block|jit] [StateOut]\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    char const* romFilename = argv[1];
+    char const* movieFilename = argv[2];
+    std::string modeName = (argc >= 4) ? argv[3] : "interp";
+    char const* stateFilename = (argc >= 5) ? argv[4] : nullptr;
+
+    ExecMode mode = ExecMode::Interpreter;
+    if (modeName == "block")
+    {
+        mode = ExecMode::BlockCache;
+    }
+    else if (modeName == "jit")
+    {
+        mode = ExecMode::Jit;
+    }
+    else if (modeName != "interp")
+    {
+        std::cerr << "Unknown mode " << modeName << ", expected interp, block or jit\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    Movie movie;
+    if (!movie.Load(movieFilename))
+    {
+        std::cerr << "Could not read movie " << movieFilename << "\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    Chip8 chip8;
+    chip8.SetExecMode(mode);
+    if (!chip8.LoadROM(romFilename))
+    {
+        std::exit(EXIT_FAILURE);
+    }
+
+    if (!movie.Matches(chip8))
+    {
+        std::cerr << "Movie " << movieFilename << " was not recorded on " << romFilename << "\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    chip8.SetQuirks(movie.GetQuirks()); // whatever the recording ran with, a movie is only the same run under the same quirks
+    chip8.Seed(movie.Seed());
+
+    char const* profileName = std::getenv("CHIP8_PROFILE");
+    if (profileName)
+    {
+        chip8.SetProfiling(true);
+    }
+
+    Scheduler scheduler(chip8, movie.InstructionsPerSecond());
+
+    std::unique_ptr<Capture> capture = Capture::FromEnvironment();
+    scheduler.SetCapture(capture.get());
+
+    auto startTime = std::chrono::steady_clock::now();
+    movie.Replay(chip8, scheduler);
+    auto endTime = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(endTime - startTime).count();
+
+    if (capture && !capture->Close())
+    {
+        std::cerr << "Could not write all of the capture\n";
+    }
+
+    // FNV-1a of the whole final state, two replays agree on this exactly when they agree on every register, pixel and byte of memory
+    SaveState state;
+    chip8.Save(state);
+    uint64_t digest = StateDigest(state);
+
+    if (stateFilename && !SaveStateToFile(chip8, stateFilename))
+    {
+        std::cerr << "Could not write state " << stateFilename << "\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    if (profileName && !chip8.WriteProfile(profileName))
+    {
+        std::cerr << "Could not write profile " << profileName << "\n";
+    }
+
+    std::cout << "Mode: " << modeName << "\n";
+    std::cout << "Seed: " << movie.Seed() << "\n";
+    std::cout << "Quirks: " << QuirksName(movie.GetQuirks()) << "\n";
+    std::cout << "Events: " << movie.EventCount() << "\n";
+    std::cout << "Instructions: " << chip8.CycleCount() << "\n";
+    std::cout << "Frames: " << scheduler.Frames() << "\n";
+    std::cout << "Elapsed: " << seconds << " s\n";
+    std::cout << "Instructions/sec: " << (seconds > 0 ? chip8.CycleCount() / seconds : 0.0) << "\n";
+    if (capture)
+    {
+        std::cout << "Captured: " << capture->Frames() << " frames, " << capture->DistinctFrames() << " distinct\n";
+    }
+    std::cout << "State digest: " << std::hex << digest << std::dec << "\n";
+
+    return 0;
+}